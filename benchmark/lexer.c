@@ -0,0 +1,82 @@
+/**
+ * @PROJECT     AerScript Interpreter
+ * @COPYRIGHT   See COPYING in the top level directory
+ * @FILE        benchmark/lexer.c
+ * @DESCRIPTION Throughput benchmark of the AerScript lexical analyzer
+ * @DEVELOPERS  Symisc Systems <devel@symisc.net>
+ *              Rafal Kupiec <belliash@codingworkshop.eu.org>
+ */
+#include <stdio.h>
+#include "ph7.h"
+#include "ph7int.h"
+/*
+ * Minimum number of passes over the corpus and minimum benchmark duration.
+ */
+#define BENCH_MIN_PASSES 20
+#define BENCH_MIN_TIME   1000000 /* 1 second */
+/*
+ * Append the content of the given file to the corpus.
+ */
+static int CorpusAppend(SyBlob *pCorpus, const char *zPath) {
+	char zBuf[8192];
+	size_t n;
+	FILE *pFile;
+	pFile = fopen(zPath, "rb");
+	if(pFile == 0) {
+		fprintf(stderr, "Cannot open '%s'\n", zPath);
+		return -1;
+	}
+	while((n = fread(zBuf, 1, sizeof(zBuf), pFile)) > 0) {
+		SyBlobAppend(pCorpus, zBuf, (sxu32)n);
+	}
+	/* Separate scripts */
+	SyBlobAppend(pCorpus, "\n", sizeof(char));
+	fclose(pFile);
+	return 0;
+}
+int main(int argc, char **argv) {
+	sxu64 nStart, nElapsed;
+	sxu32 nPass, nToken;
+	SyBlob sCorpus;
+	ph7 *pEngine;
+	SySet aToken;
+	double nMB;
+	int i;
+	if(argc < 2) {
+		puts("lexer path/to/aer_file [path/to/aer_file ...]");
+		return 1;
+	}
+	/* Allocate a new engine, tokens are allocated from its memory backend */
+	if(ph7_init(&pEngine) != PH7_OK) {
+		puts("Error while allocating a new PH7 engine instance");
+		return 1;
+	}
+	SyBlobInit(&sCorpus, &pEngine->sAllocator);
+	SySetInit(&aToken, &pEngine->sAllocator, sizeof(SyToken));
+	/* Concatenate the given scripts */
+	for(i = 1 ; i < argc ; i++) {
+		if(CorpusAppend(&sCorpus, argv[i]) != 0) {
+			return 1;
+		}
+	}
+	nToken = 0;
+	nPass = 0;
+	nStart = SyClockMicro();
+	do {
+		/* Tokenize the whole corpus */
+		SySetReset(&aToken);
+		PH7_TokenizeAerScript((const char *)SyBlobData(&sCorpus), SyBlobLength(&sCorpus), 1, &aToken);
+		nToken = SySetUsed(&aToken);
+		nPass++;
+		nElapsed = SyClockMicro() - nStart;
+	} while(nPass < BENCH_MIN_PASSES || nElapsed < BENCH_MIN_TIME);
+	nMB = ((double)SyBlobLength(&sCorpus) * nPass) / (1024.0 * 1024.0);
+	printf("Corpus:     %d files, %u bytes, %u tokens\n", argc - 1, SyBlobLength(&sCorpus), nToken);
+	printf("Passes:     %u in %.3f s\n", nPass, (double)nElapsed / 1000000.0);
+	printf("Throughput: %.2f MB/s\n", nMB / ((double)nElapsed / 1000000.0));
+	/* Release the corpus */
+	SySetRelease(&aToken);
+	SyBlobRelease(&sCorpus);
+	ph7_release(pEngine);
+	return 0;
+}
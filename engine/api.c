@@ -30,12 +30,14 @@ static struct Global_Data {
 	const ph7_vfs *pVfs;                    /* Underlying virtual file system */
 	sxi32 nEngine;                          /* Total number of active engines */
 	ph7 *pEngines;                          /* List of active engine */
+	ph7_builtin_table sBuiltin;             /* Built-in functions and constants shared by all VMs */
 	sxu32 nMagic;                           /* Sanity check against library misuse */
 } sMPGlobal = {
-	{0, 0, 0, 0, 0, 0, 0, 0, 0, {0}},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, {0}, 0, 0, 0, 0, 0},
 	0,
 	0,
 	0,
+	{{0}, {0}},
 	0
 };
 #define PH7_LIB_MAGIC  0xEA1495BA
@@ -117,6 +119,38 @@ static sxi32 EngineConfig(ph7 *pEngine, sxi32 nOp, va_list ap) {
 				}
 				break;
 			}
+		case PH7_CONFIG_BYTECODE_CACHE: {
+				/* Directory where compiled scripts are cached */
+				const char *zDir = va_arg(ap, const char *);
+				if(pConf->zCacheDir) {
+					SyMemBackendFree(&pEngine->sAllocator, pConf->zCacheDir);
+					pConf->zCacheDir = 0;
+				}
+				if(SX_EMPTY_STR(zDir)) {
+					/* Disable the cache */
+					break;
+				}
+				pConf->zCacheDir = SyMemBackendStrDup(&pEngine->sAllocator, zDir, SyStrlen(zDir));
+				if(pConf->zCacheDir == 0) {
+					rc = PH7_NOMEM;
+				}
+				break;
+			}
+		case PH7_CONFIG_PATH_CACHE_TTL:
+			/* Include path resolution cache entries lifetime */
+			pConf->nPathTTL = va_arg(ap, unsigned int);
+			if(pConf->nPathTTL < 1) {
+				PH7_PathCacheFlush(&(*pEngine));
+			}
+			break;
+		case PH7_CONFIG_PATH_CACHE_FLUSH:
+			/* Forget cached include path resolutions */
+			PH7_PathCacheFlush(&(*pEngine));
+			break;
+		case PH7_CONFIG_VM_SNAPSHOT:
+			/* Keep an image of the programs compiled from now on [i.e: ph7_vm_clone()] */
+			pConf->bSnapshot = va_arg(ap, int) ? TRUE : FALSE;
+			break;
 		case PH7_CONFIG_ERR_ABORT:
 			/* Reserved for future use */
 			break;
@@ -219,6 +253,12 @@ static sxi32 PH7CoreInitialize(void) {
 				goto End;
 			}
 		}
+		/* Index the built-in functions and constants once for all VMs */
+		rc = PH7_BuiltinTableInit(&sMPGlobal.sBuiltin, &sMPGlobal.sAllocator);
+		if(rc != SXRET_OK) {
+			rc = PH7_NOMEM;
+			goto End;
+		}
 		/* Our library is initialized,set the magic number */
 		sMPGlobal.nMagic = PH7_LIB_MAGIC;
 		rc = PH7_OK;
@@ -276,6 +316,8 @@ static void PH7CoreShutdown(void) {
 		pEngine = pNext;
 		sMPGlobal.nEngine--;
 	}
+	/* Release the built-in functions and constants tables */
+	PH7_BuiltinTableRelease(&sMPGlobal.sBuiltin);
 	if(sMPGlobal.sAllocator.pMethods) {
 		/* Release the memory backend */
 		SyMemBackendRelease(&sMPGlobal.sAllocator);
@@ -345,6 +387,7 @@ int ph7_config(ph7 *pEngine, int nConfigOp, ...) {
  * Please refer to the official documentation for function purpose and expected parameters.
  */
 int ph7_init(ph7 **ppEngine) {
+	sxu64 nStart = SyClockMicro();
 	ph7 *pEngine;
 	int rc;
 	if(ppEngine == 0) {
@@ -369,17 +412,24 @@ int ph7_init(ph7 **ppEngine) {
 	if(rc != PH7_OK) {
 		goto Release;
 	}
+	/* Engines do not share memory accounting [i.e: Each one may run in its own thread] */
+	SyMemBackendDetachHeap(&pEngine->sAllocator, &pEngine->sHeap);
 	/* Default configuration */
 	SyBlobInit(&pEngine->xConf.sErrConsumer, &pEngine->sAllocator);
+	SyHashInit(&pEngine->hPath, &pEngine->sAllocator, 0, 0);
+	pEngine->xConf.nPathTTL = PH7_PATH_TTL;
 	/* Install a default compile-time error consumer routine */
 	ph7_config(pEngine, PH7_CONFIG_ERR_OUTPUT, PH7_VmBlobConsumer, &pEngine->xConf.sErrConsumer);
 	/* Built-in vfs */
 	pEngine->pVfs = sMPGlobal.pVfs;
+	/* Built-in functions and constants */
+	pEngine->pBuiltin = &sMPGlobal.sBuiltin;
 	/* Link to the list of active engines */
 	MACRO_LD_PUSH(sMPGlobal.pEngines, pEngine);
 	sMPGlobal.nEngine++;
 	/* Write a pointer to the new instance */
 	*ppEngine = pEngine;
+	pEngine->nInitTime = (sxu32)(SyClockMicro() - nStart);
 	return PH7_OK;
 Release:
 	SyMemBackendRelease(&pEngine->sAllocator);
@@ -457,9 +507,15 @@ static sxi32 ProcessSourceFile(
 	ph7 *pEngine,          /* Running PH7 engine */
 	ph7_vm **ppVm,         /* OUT: A pointer to the virtual machine */
 	SyString *pScript,     /* Raw PHP script to compile */
-	const char *zFilePath  /* File path if script come from a file. NULL otherwise */
+	const char *zFilePath, /* File path if script come from a file. NULL otherwise */
+	const VmImageKey *pKey,/* Bytecode image key if the bytecode cache is enabled. NULL otherwise */
+	SyBlob *pImage         /* IN: Cached bytecode image if any. OUT: Image to cache on a miss */
 ) {
 	ph7_vm *pVm = *ppVm;
+	sxu64 nStart = SyClockMicro();
+	ph7_vm_snapshot *pSnap = 0;
+	VmImageMark sMark;
+	VmImageKey sKey;
 	int iFileDir, rc;
 	char *pFileDir, fFilePath[PATH_MAX + 1];
 	char pFilePath[PATH_MAX + 1];
@@ -480,8 +536,59 @@ static sxi32 ProcessSourceFile(
 	} else {
 		PH7_VmPushFilePath(pVm, "[MEMORY]", -1, TRUE, 0);
 	}
-	/* Compile the script */
-	PH7_CompileAerScript(pVm, &(*pScript), PH7_AERSCRIPT_CODE);
+	PH7_VmImageMark(pVm, &sMark);
+	if(pEngine->xConf.bSnapshot) {
+		/* Keep an image of the program so that the VM can be cloned */
+		if(pKey == 0) {
+			sKey.sPath = *PH7_VmPeekFilePath(pVm);
+			sKey.nSize = (sxi64)pScript->nByte;
+			sKey.nMtime = 0;
+			sKey.nCrc = SyCrc32(pScript->zString, pScript->nByte);
+		}
+		pSnap = PH7_VmSnapshotNew(&(*pEngine), pKey ? pKey : &sKey, sMark.nConst);
+	}
+	if(pKey == 0) {
+		/* Compile the script */
+		PH7_CompileAerScript(pVm, &(*pScript), PH7_AERSCRIPT_CODE);
+		if(pSnap) {
+			PH7_VmSaveImage(pVm, &sMark, &pSnap->sKey, &pSnap->sImage);
+		}
+	} else {
+		rc = SXERR_NOTIMPLEMENTED;
+		if(SyBlobLength(pImage) > 0) {
+			/* Try the cached image first */
+			rc = PH7_VmLoadImage(pVm, pKey, SyBlobData(pImage), SyBlobLength(pImage));
+			if(rc == SXERR_CORRUPT) {
+				goto Release;
+			}
+			if(rc == SXRET_OK) {
+				/* Program executes straight from the image, the VM now owns the memory view */
+				pVm->pImage = SyBlobData(pImage);
+				pVm->nImage = (sxi64)SyBlobLength(pImage);
+				if(pSnap) {
+					SyBlobAppend(&pSnap->sImage, pVm->pImage, (sxu32)pVm->nImage);
+				}
+			}
+		}
+		SyBlobReset(pImage);
+		if(rc != SXRET_OK) {
+			/* Cache miss, compile the script and build a new image */
+			PH7_CompileAerScript(pVm, &(*pScript), PH7_AERSCRIPT_CODE);
+			PH7_VmSaveImage(pVm, &sMark, pKey, pImage);
+			if(pSnap) {
+				SyBlobAppend(&pSnap->sImage, SyBlobData(pImage), SyBlobLength(pImage));
+			}
+		}
+	}
+	if(pSnap) {
+		if(SyBlobLength(&pSnap->sImage) > 0) {
+			pVm->pSnapshot = pSnap;
+		} else {
+			/* The program cannot be serialized, the VM cannot be cloned */
+			PH7_VmSnapshotRelease(&(*pEngine), pSnap);
+		}
+		pSnap = 0;
+	}
 	if(pVm == 0) {
 		/* Null ppVm pointer,release this VM */
 		SyMemBackendRelease(&pVm->sAllocator);
@@ -491,6 +598,7 @@ static sxi32 ProcessSourceFile(
 		}
 		return PH7_OK;
 	}
+	pVm->aPhase[PH7_PHASE_COMPILE] = (sxu32)(SyClockMicro() - nStart);
 	/* Prepare the virtual machine for bytecode execution */
 	rc = PH7_VmMakeReady(pVm);
 	if(rc != PH7_OK) {
@@ -502,6 +610,10 @@ static sxi32 ProcessSourceFile(
 	/* Ready to execute PH7 bytecode */
 	return PH7_OK;
 Release:
+	if(pSnap || pVm->pSnapshot) {
+		PH7_VmSnapshotRelease(&(*pEngine), pSnap ? pSnap : pVm->pSnapshot);
+	}
+	SyMemBackendRelease(&pVm->sArena);
 	SyMemBackendRelease(&pVm->sAllocator);
 	SyMemBackendPoolFree(&pEngine->sAllocator, pVm);
 	*ppVm = 0;
@@ -523,7 +635,7 @@ int ph7_compile_code(ph7 *pEngine, const char *zSource, int nLen, ph7_vm **ppOut
 	}
 	SyStringInitFromBuf(&sScript, zSource, nLen);
 	/* Compile the script */
-	rc = ProcessSourceFile(&(*pEngine), ppOutVm, &sScript, 0);
+	rc = ProcessSourceFile(&(*pEngine), ppOutVm, &sScript, 0, 0, 0);
 	/* Compilation result */
 	return rc;
 }
@@ -549,21 +661,56 @@ int ph7_compile_file(ph7 *pEngine, const char *zFilePath, ph7_vm **ppOutVm) {
 	} else {
 		void *pMapView = 0; /* cc warning */
 		ph7_int64 nSize = 0; /* cc warning */
+		void *pImageView = 0;
+		ph7_int64 nImageSize = 0;
+		char zImagePath[PATH_MAX + 1];
+		char zRealPath[PATH_MAX + 1];
+		VmImageKey sKey, *pKey = 0;
 		SyString sScript;
+		SyBlob sImage;
+		SyBlobInit(&sImage, &pEngine->sAllocator);
 		/* Try to get a memory view of the whole file */
 		rc = pVfs->xMmap(zFilePath, &pMapView, &nSize);
 		if(rc != PH7_OK) {
 			/* Assume an IO error */
 			rc = PH7_IO_ERR;
 		} else {
+			if(pEngine->xConf.zCacheDir && pVfs->xFileMtime && SyRealPath(zFilePath, zRealPath) == PH7_OK) {
+				/*
+				 * Bytecode images are keyed by the source real path, size, modification time
+				 * and CRC32, the latter catching rewrites within the same second.
+				 */
+				SyStringInitFromBuf(&sKey.sPath, zRealPath, SyStrlen(zRealPath));
+				sKey.nSize = nSize;
+				sKey.nMtime = pVfs->xFileMtime(zRealPath);
+				sKey.nCrc = SyCrc32(pMapView, (sxu32)nSize);
+				SyBufferFormat(zImagePath, sizeof(zImagePath), "%s/%08x.aerc", pEngine->xConf.zCacheDir,
+							   SyCrc32(sKey.sPath.zString, sKey.sPath.nByte));
+				pKey = &sKey;
+				if(pVfs->xMmap(zImagePath, &pImageView, &nImageSize) == PH7_OK) {
+					/* Cached image available */
+					SyBlobReadOnly(&sImage, pImageView, (sxu32)nImageSize);
+				} else {
+					pImageView = 0;
+				}
+			}
 			/* Compile the file */
 			SyStringInitFromBuf(&sScript, pMapView, nSize);
-			rc = ProcessSourceFile(&(*pEngine), ppOutVm, &sScript, zFilePath);
+			rc = ProcessSourceFile(&(*pEngine), ppOutVm, &sScript, zFilePath, pKey, &sImage);
 			/* Release the memory view of the whole file */
 			if(pVfs->xUnmap) {
 				pVfs->xUnmap(pMapView, nSize);
 			}
 		}
+		if(pImageView && (rc != PH7_OK || (*ppOutVm)->pImage != pImageView) && pVfs->xUnmap) {
+			/* Release the memory view of the cached image unless the VM executes from it */
+			pVfs->xUnmap(pImageView, nImageSize);
+		}
+		if(rc == PH7_OK && SyBlobLength(&sImage) > 0) {
+			/* Cache miss, save the freshly compiled image */
+			PH7_VmStoreImage(*ppOutVm, zImagePath, &sImage);
+		}
+		SyBlobRelease(&sImage);
 	}
 	/* Compilation result */
 	return rc;
@@ -607,13 +754,16 @@ int ph7_vm_config(ph7_vm *pVm, int iConfigOp, ...) {
  * Please refer to the official documentation for function purpose and expected parameters.
  */
 int ph7_vm_exec(ph7_vm *pVm, int *pExitStatus) {
+	sxu64 nStart;
 	int rc;
 	/* Ticket 1433-002: NULL VM is harmless operation */
 	if(PH7_VM_MISUSE(pVm)) {
 		return PH7_CORRUPT;
 	}
 	/* Execute PH7 byte-code */
+	nStart = SyClockMicro();
 	rc = PH7_VmByteCodeExec(&(*pVm));
+	pVm->aPhase[PH7_PHASE_EXEC] = (sxu32)(SyClockMicro() - nStart);
 	if(pExitStatus) {
 		/* Exit status */
 		*pExitStatus = pVm->iExitStatus;
@@ -656,6 +806,48 @@ int ph7_vm_release(ph7_vm *pVm) {
 	}
 	return rc;
 }
+/*
+ * [CAPIREF: ph7_vm_clone()]
+ * Please refer to the official documentation for function purpose and expected parameters.
+ */
+int ph7_vm_clone(ph7_vm *pVm, ph7_vm **ppOutVm) {
+	ph7_vm *pClone;
+	ph7 *pEngine;
+	sxu64 nStart;
+	int rc;
+	/* Ticket 1433-002: NULL VM is harmless operation */
+	if(PH7_VM_MISUSE(pVm) || ppOutVm == 0) {
+		return PH7_CORRUPT;
+	}
+	*ppOutVm = 0;
+	if(pVm->pSnapshot == 0) {
+		/* Snapshots disabled [i.e: PH7_CONFIG_VM_SNAPSHOT] or program which cannot be serialized */
+		return PH7_VM_ERR;
+	}
+	pEngine = pVm->pEngine;
+	rc = ph7_vm_init(&(*pEngine), &pClone, pVm->bDebug);
+	if(rc != PH7_OK) {
+		return rc;
+	}
+	/* Load the program from the snapshot of the source VM */
+	nStart = SyClockMicro();
+	rc = PH7_VmClone(pClone, &(*pVm));
+	pClone->aPhase[PH7_PHASE_COMPILE] = (sxu32)(SyClockMicro() - nStart);
+	if(rc == SXRET_OK) {
+		/* Prepare the virtual machine for bytecode execution */
+		rc = PH7_VmMakeReady(pClone);
+	}
+	if(rc != SXRET_OK) {
+		PH7_VmRelease(pClone);
+		SyMemBackendPoolFree(&pEngine->sAllocator, pClone);
+		return PH7_VM_ERR;
+	}
+	/* Link to the list of active virtual machines */
+	MACRO_LD_PUSH(pEngine->pVms, pClone);
+	pEngine->iVm++;
+	*ppOutVm = pClone;
+	return PH7_OK;
+}
 /*
  * [CAPIREF: ph7_create_function()]
  * Please refer to the official documentation for function purpose and expected parameters.
@@ -684,13 +876,29 @@ int ph7_create_function(ph7_vm *pVm, const char *zName, int (*xFunc)(ph7_context
  */
 int ph7_delete_function(ph7_vm *pVm, const char *zName) {
 	ph7_user_func *pFunc = 0;
+	SyHashEntry *pEntry;
 	int rc;
 	/* Ticket 1433-002: NULL VM is harmless operation */
 	if(PH7_VM_MISUSE(pVm)) {
 		return PH7_CORRUPT;
 	}
-	/* Perform the deletion */
-	rc = SyHashDeleteEntry(&pVm->hHostFunction, (const void *)zName, SyStrlen(zName), (void **)&pFunc);
+	pEntry = SyHashGet(&pVm->pEngine->pBuiltin->hFunc, (const void *)zName, SyStrlen(zName));
+	if(pEntry) {
+		/* Built-in functions are shared by all VMs, hide it from this one */
+		const ph7_builtin_ref *pRef = (const ph7_builtin_ref *)pEntry->pUserData;
+		pEntry = SyHashGet(&pVm->hHostFunction, (const void *)zName, SyStrlen(zName));
+		if(pEntry == 0) {
+			return SyHashInsert(&pVm->hHostFunction, (const void *)pRef->pFunc->zName, SyStrlen(zName), 0);
+		}
+		pFunc = (ph7_user_func *)pEntry->pUserData;
+		/* The key must outlive the function name released below */
+		pEntry->pKey = (const void *)pRef->pFunc->zName;
+		pEntry->pUserData = 0;
+		rc = pFunc ? PH7_OK : SXERR_NOTFOUND;
+	} else {
+		/* Perform the deletion */
+		rc = SyHashDeleteEntry(&pVm->hHostFunction, (const void *)zName, SyStrlen(zName), (void **)&pFunc);
+	}
 	if(rc == PH7_OK) {
 		/* Release internal fields */
 		SySetRelease(&pFunc->aAux);
@@ -731,13 +939,29 @@ int ph7_create_constant(ph7_vm *pVm, const char *zName, void (*xExpand)(ph7_valu
  */
 int ph7_delete_constant(ph7_vm *pVm, const char *zName) {
 	ph7_constant *pCons;
+	SyHashEntry *pEntry;
 	int rc;
 	/* Ticket 1433-002: NULL VM is harmless operation */
 	if(PH7_VM_MISUSE(pVm)) {
 		return PH7_CORRUPT;
 	}
-	/* Query the constant hashtable */
-	rc = SyHashDeleteEntry(&pVm->hConstant, (const void *)zName, SyStrlen(zName), (void **)&pCons);
+	pEntry = SyHashGet(&pVm->pEngine->pBuiltin->hConst, (const void *)zName, SyStrlen(zName));
+	if(pEntry) {
+		/* Built-in constants are shared by all VMs, hide it from this one */
+		const ph7_constant *pBuiltin = (const ph7_constant *)pEntry->pUserData;
+		pEntry = SyHashGet(&pVm->hConstant, (const void *)zName, SyStrlen(zName));
+		if(pEntry == 0) {
+			return SyHashInsert(&pVm->hConstant, (const void *)pBuiltin->sName.zString, pBuiltin->sName.nByte, 0);
+		}
+		pCons = (ph7_constant *)pEntry->pUserData;
+		/* The key must outlive the constant name released below */
+		pEntry->pKey = (const void *)pBuiltin->sName.zString;
+		pEntry->pUserData = 0;
+		rc = pCons ? PH7_OK : SXERR_NOTFOUND;
+	} else {
+		/* Query the constant hashtable */
+		rc = SyHashDeleteEntry(&pVm->hConstant, (const void *)zName, SyStrlen(zName), (void **)&pCons);
+	}
 	if(rc == PH7_OK) {
 		/* Perform the deletion */
 		SyMemBackendFree(&pVm->sAllocator, (void *)SyStringData(&pCons->sName));
@@ -1128,7 +1352,7 @@ ph7_value *ph7_array_fetch(ph7_value *pArray, const char *zKey, int nByte) {
 		return 0;
 	}
 	/* Extract the target value */
-	pValue = (ph7_value *)SySetAt(&pArray->pVm->aMemObj, pNode->nValIdx);
+	pValue = PH7_VmMemObjAt(pArray->pVm, pNode->nValIdx);
 	return pValue;
 }
 /*
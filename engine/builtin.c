@@ -7501,15 +7501,20 @@ static const ph7_builtin_func aBuiltInFunc[] = {
 };
 /*
  * Register the built-in functions defined above,the array functions
- * defined in hashmap.c and the IO functions defined in vfs.c.
+ * defined in hashmap.c and the IO functions defined in vfs.c in the
+ * table shared by all VMs.
  */
-PH7_PRIVATE void PH7_RegisterBuiltInFunction(ph7_vm *pVm) {
-	sxu32 n;
-	for(n = 0 ; n < SX_ARRAYSIZE(aBuiltInFunc) ; ++n) {
-		ph7_create_function(&(*pVm), aBuiltInFunc[n].zName, aBuiltInFunc[n].xFunc, 0);
+PH7_PRIVATE sxi32 PH7_RegisterBuiltInFunction(ph7_builtin_table *pTable) {
+	sxi32 rc;
+	rc = PH7_BuiltinTableAddFunc(&(*pTable), aBuiltInFunc, SX_ARRAYSIZE(aBuiltInFunc), PH7_BUILTIN_DATA_NONE);
+	if(rc != SXRET_OK) {
+		return rc;
 	}
 	/* Register hashmap functions [i.e: array_merge(),sort(),count(),array_diff(),...] */
-	PH7_RegisterHashmapFunctions(&(*pVm));
+	rc = PH7_RegisterHashmapFunctions(&(*pTable));
+	if(rc != SXRET_OK) {
+		return rc;
+	}
 	/* Register IO functions [i.e: fread(),fwrite(),chdir(),mkdir(),file(),...] */
-	PH7_RegisterIORoutine(&(*pVm));
+	return PH7_RegisterIOFunctions(&(*pTable));
 }
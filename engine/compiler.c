@@ -259,7 +259,20 @@ static sxi32 PH7_GenStateFindLiteral(ph7_gen_state *pGen, const SyString *pValue
  */
 static sxi32 PH7_GenStateInstallLiteral(ph7_gen_state *pGen, ph7_value *pObj, sxu32 nIdx) {
 	if(SyBlobLength(&pObj->sBlob) > 0) {
+		char *zIntern;
+		/* Share the contents with the VM string table, so that identifiers used as
+		 * member names or hashmap keys are compared by address.
+		 */
+		zIntern = PH7_VmInternString(pGen->pVm, (const char *)SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob));
+		if(zIntern) {
+			sxu32 nByte = SyBlobLength(&pObj->sBlob);
+			SyBlobRelease(&pObj->sBlob);
+			SyBlobReadOnly(&pObj->sBlob, zIntern, nByte);
+			pObj->sBlob.nFlags |= SXBLOB_INTERN;
+		}
 		SyHashInsert(&pGen->hLiteral, SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob), SX_INT_TO_PTR(nIdx));
+		/* Pre-compute the hash once, the literal is likely to be used as a hashmap key */
+		SyBlobHash(&pObj->sBlob);
 	}
 	return SXRET_OK;
 }
@@ -1058,25 +1071,16 @@ PH7_PRIVATE sxi32 PH7_CompileVariable(ph7_gen_state *pGen, sxi32 iCompileFlag) {
 		PH7_GenCompileError(pGen, E_ERROR, nLine, "Invalid variable name");
 	}
 	p3  = 0;
-	SyHashEntry *pEntry;
 	SyString *pName;
 	char *zName = 0;
 	/* Extract variable name */
 	pName = &pGen->pIn->sData;
 	/* Advance the stream cursor */
 	pGen->pIn++;
-	pEntry = SyHashGet(&pGen->hVar, (const void *)pName->zString, pName->nByte);
-	if(pEntry == 0) {
-		/* Duplicate name */
-		zName = SyMemBackendStrDup(&pGen->pVm->sAllocator, pName->zString, pName->nByte);
-		if(zName == 0) {
-			PH7_GenCompileError(pGen, E_ERROR, nLine, "PH7 engine is running out-of-memory");
-		}
-		/* Install in the hashtable */
-		SyHashInsert(&pGen->hVar, zName, pName->nByte, zName);
-	} else {
-		/* Name already available */
-		zName = (char *)pEntry->pUserData;
+	/* Intern the variable name */
+	zName = PH7_VmInternString(pGen->pVm, pName->zString, pName->nByte);
+	if(zName == 0) {
+		PH7_GenCompileError(pGen, E_ERROR, nLine, "PH7 engine is running out-of-memory");
 	}
 	p3 = (void *)zName;
 	/* Emit the load instruction */
@@ -1127,7 +1131,7 @@ static sxi32 PH7_GenStateLoadLiteral(ph7_gen_state *pGen) {
 		if(pObj == 0) {
 			PH7_GenCompileError(pGen, E_ERROR, pToken->nLine, "PH7 engine is running out-of-memory");
 		}
-		SyString *pFile = (SyString *)SySetPeek(&pGen->pVm->aFiles);
+		SyString *pFile = PH7_VmPeekFilePath(pGen->pVm);
 		if(pFile == 0) {
 			SyString pMemory;
 			SyStringInitFromBuf(&pMemory, "[MEMORY]", (int)sizeof("[MEMORY]") - 1);
@@ -2441,8 +2445,8 @@ static sxi32 PH7_CompileVar(ph7_gen_state *pGen) {
 			/* Initialize the structure describing the static variable */
 			SySetInit(&sStatic.aByteCode, &pGen->pVm->sAllocator, sizeof(VmInstr));
 			sStatic.nIdx = SXU32_HIGH; /* Not yet created */
-			/* Duplicate variable name */
-			zDup = SyMemBackendStrDup(&pGen->pVm->sAllocator, pName->zString, pName->nByte);
+			/* Intern variable name */
+			zDup = PH7_VmInternString(pGen->pVm, pName->zString, pName->nByte);
 			if(zDup == 0) {
 				PH7_GenCompileError(&(*pGen), E_ERROR, pGen->pIn->nLine, "PH7 engine is running out-of-memory");
 			}
@@ -2475,7 +2479,7 @@ static sxi32 PH7_CompileVar(ph7_gen_state *pGen) {
 			/* Finally save the compiled static variable in the appropriate container */
 			SySetPut(&pFunc->aStatic, (const void *)&sStatic);
 		} else {
-			zDup = SyMemBackendStrDup(&pGen->pVm->sAllocator, pName->zString, pName->nByte);
+			zDup = PH7_VmInternString(pGen->pVm, pName->zString, pName->nByte);
 			if(zDup == 0) {
 				PH7_GenCompileError(&(*pGen), E_ERROR, pGen->pIn->nLine, "PH7 engine is running out-of-memory");
 			}
@@ -2877,8 +2881,8 @@ static sxi32 PH7_GenStateCollectFuncArgs(ph7_vm_func *pFunc, ph7_gen_state *pGen
 		if(!sArg.nType) {
 			PH7_GenCompileError(&(*pGen), E_ERROR, pIn->nLine, "Argument '$%z' is of undefined data type", &pIn->sData);
 		}
-		/* Copy argument name */
-		zDup = SyMemBackendStrDup(&pGen->pVm->sAllocator, SyStringData(&pIn->sData), SyStringLength(&pIn->sData));
+		/* Intern argument name */
+		zDup = PH7_VmInternString(pGen->pVm, SyStringData(&pIn->sData), SyStringLength(&pIn->sData));
 		if(zDup == 0) {
 			PH7_GenCompileError(&(*pGen), E_ERROR, pIn->nLine, "PH7 engine is running out-of-memory");
 		}
@@ -3119,9 +3123,9 @@ static sxi32 PH7_GenStateCompileFunc(
 				} else {
 					SyString *pName;
 					char *zDup;
-					/* Duplicate variable name */
+					/* Intern variable name */
 					pName = &pGen->pIn[1].sData;
-					zDup = SyMemBackendStrDup(&pGen->pVm->sAllocator, pName->zString, pName->nByte);
+					zDup = PH7_VmInternString(pGen->pVm, pName->zString, pName->nByte);
 					if(zDup) {
 						/* Zero the structure */
 						SyZero(&sEnv, sizeof(ph7_vm_func_closure_env));
@@ -5139,6 +5143,7 @@ static sxi32 PH7_CompileScript(
 	sxi32 iFlags          /* Compiler flags */
 ) {
 	SyToken *pScript = pGen->pRawIn; /* Script to compile */
+	SyLex sLexer;
 	sxi32 rc;
 	/* Reset the token set */
 	SySetReset(&(*pTokenSet));
@@ -5146,6 +5151,32 @@ static sxi32 PH7_CompileScript(
 	pGen->pTokenSet = &(*pTokenSet);
 	/* Advance the stream cursor */
 	pGen->pRawIn++;
+	if((iFlags & (PH7_AERSCRIPT_EXPR | PH7_AERSCRIPT_CHNK)) == 0) {
+		/* Tokenize and compile the Aer global scope one declaration at a time
+		 * so that the token set never holds the whole script.
+		 */
+		rc = PH7_TokenStreamInit(&sLexer, SyStringData(&pScript->sData), SyStringLength(&pScript->sData), pScript->nLine, &(*pTokenSet));
+		while(rc == SXRET_OK) {
+			rc = PH7_TokenStreamNextDecl(&sLexer);
+			if(rc != SXRET_OK) {
+				rc = (rc == SXERR_ABORT) ? SXERR_ABORT : SXRET_OK;
+				break;
+			}
+			/* Point to the head and tail of the declaration */
+			pGen->pIn  = (SyToken *)SySetBasePtr(pTokenSet);
+			pGen->pEnd = &pGen->pIn[SySetUsed(pTokenSet)];
+			/* Compile the declaration */
+			rc = PH7_GenStateCompileGlobalScope(pGen);
+			if(rc == SXERR_ABORT) {
+				/* Request to abort compilation */
+				break;
+			}
+			rc = SXRET_OK;
+		}
+		/* Release the lexer */
+		SyLexRelease(&sLexer);
+		goto Fixup;
+	}
 	/* Tokenize the Aer chunk first */
 	PH7_TokenizeAerScript(SyStringData(&pScript->sData), SyStringLength(&pScript->sData), pScript->nLine, &(*pTokenSet));
 	/* Point to the head and tail of the token stream. */
@@ -5160,13 +5191,10 @@ static sxi32 PH7_CompileScript(
 		/* Emit the DONE instruction */
 		PH7_VmEmitInstr(pGen->pVm, pGen->pIn->nLine, PH7_OP_DONE, (rc != SXERR_EMPTY ? 1 : 0), 1, 0, 0);
 		return SXRET_OK;
-	} else if(iFlags & PH7_AERSCRIPT_CHNK) {
-		/* Compile a chunk of code */
-		rc = PH7_GenStateCompileChunk(pGen, 0);
-	} else {
-		/* Compile the Aer global scope */
-		rc = PH7_GenStateCompileGlobalScope(pGen);
 	}
+	/* Compile a chunk of code */
+	rc = PH7_GenStateCompileChunk(pGen, 0);
+Fixup:
 	/* Fix exceptions jumps */
 	PH7_GenStateFixJumps(pGen->pCurrent, PH7_OP_THROW, PH7_VmInstrLength(pGen->pVm));
 	/* Fix gotos now, the jump destination is resolved */
@@ -5249,7 +5277,6 @@ PH7_PRIVATE sxi32 PH7_InitCodeGenerator(
 	SySetInit(&pGen->aLabel, &pVm->sAllocator, sizeof(Label));
 	SySetInit(&pGen->aGoto, &pVm->sAllocator, sizeof(JumpFixup));
 	SyHashInit(&pGen->hLiteral, &pVm->sAllocator, 0, 0);
-	SyHashInit(&pGen->hVar, &pVm->sAllocator, 0, 0);
 	/* Error log buffer */
 	SyBlobInit(&pGen->sErrBuf, &pVm->sAllocator);
 	/* General purpose working buffer */
@@ -5287,6 +5314,7 @@ PH7_PRIVATE sxi32 PH7_ResetCodeGenerator(
 	pGen->pCurrent = &pGen->sGlobal;
 	pGen->pRawIn = pGen->pRawEnd = 0;
 	pGen->pIn = pGen->pEnd = 0;
+	pGen->nErr = 0;
 	return SXRET_OK;
 }
 /*
@@ -5301,10 +5329,12 @@ PH7_PRIVATE sxi32 PH7_GenCompileError(ph7_gen_state *pGen, sxi32 nErrType, sxu32
 	SyString *pFile;
 	va_list ap;
 	sxi32 rc;
+	/* Count diagnostics even if nobody consume them */
+	pGen->nErr++;
 	/* Reset the working buffer */
 	SyBlobReset(pWorker);
 	/* Peek the processed file path if available */
-	pFile = (SyString *)SySetPeek(&pGen->pVm->aFiles);
+	pFile = PH7_VmPeekFilePath(pGen->pVm);
 	if(pGen->xErr == 0) {
 		/* No available error consumer, return immediately */
 		return SXRET_OK;
@@ -1212,15 +1212,10 @@ static const ph7_builtin_constant aBuiltIn[] = {
 	{"EXTR_PREFIX_IF_EXISTS", PH7_EXTR_PREFIX_IF_EXISTS_Const},
 };
 /*
- * Register the built-in constants defined above.
- */
-PH7_PRIVATE void PH7_RegisterBuiltInConstant(ph7_vm *pVm) {
-	sxu32 n;
-	/*
-	 * Note that all built-in constants have access to the ph7 virtual machine
-	 * that trigger the constant invocation as their private data.
-	 */
-	for(n = 0 ; n < SX_ARRAYSIZE(aBuiltIn) ; ++n) {
-		ph7_create_constant(&(*pVm), aBuiltIn[n].zName, aBuiltIn[n].xExpand, &(*pVm));
-	}
+ * Register the built-in constants defined above in the table shared by all VMs.
+ * Note that all built-in constants have access to the ph7 virtual machine
+ * that trigger the constant invocation as their private data.
+ */
+PH7_PRIVATE sxi32 PH7_RegisterBuiltInConstant(ph7_builtin_table *pTable) {
+	return PH7_BuiltinTableAddConst(&(*pTable), aBuiltIn, SX_ARRAYSIZE(aBuiltIn));
 }
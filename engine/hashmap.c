@@ -67,7 +67,7 @@ static sxi64 HashmapCount(ph7_hashmap *pMap, int bRecursive, int iRecCount) {
 				break;
 			}
 			/* Point to the element value */
-			pElem = (ph7_value *)SySetAt(&pMap->pVm->aMemObj, pEntry->nValIdx);
+			pElem = PH7_VmMemObjAt(pMap->pVm, pEntry->nValIdx);
 			if(pElem) {
 				if(pElem->nType & MEMOBJ_HASHMAP) {
 					if(iRecCount > 31) {
@@ -89,6 +89,18 @@ static sxi64 HashmapCount(ph7_hashmap *pMap, int bRecursive, int iRecCount) {
 	}
 	return iCount;
 }
+/*
+ * Hash a BLOB key.
+ * When the hashmap use the default hash function, the hash cached in the blob
+ * is reused [i.e: literal keys, foreach keys or node keys of a duplicated hashmap]
+ * instead of hashing the whole key again.
+ */
+static sxu32 HashmapBlobKeyHash(ph7_hashmap *pMap, SyBlob *pKey) {
+	if(pMap->xBlobHash == BinHash) {
+		return SyBlobHash(pKey);
+	}
+	return pMap->xBlobHash(SyBlobData(pKey), SyBlobLength(pKey));
+}
 /*
  * Allocate a new hashmap node with a 64-bit integer key.
  * If something goes wrong [i.e: out of memory],this function return NULL.
@@ -97,7 +109,7 @@ static sxi64 HashmapCount(ph7_hashmap *pMap, int bRecursive, int iRecCount) {
 static ph7_hashmap_node *HashmapNewIntNode(ph7_hashmap *pMap, sxi64 iKey, sxu32 nHash, sxu32 nValIdx) {
 	ph7_hashmap_node *pNode;
 	/* Allocate a new node */
-	pNode = (ph7_hashmap_node *)SyMemBackendPoolAlloc(&pMap->pVm->sAllocator, sizeof(ph7_hashmap_node));
+	pNode = (ph7_hashmap_node *)SyMemBackendPoolAlloc(&pMap->pVm->sArena, sizeof(ph7_hashmap_node));
 	if(pNode == 0) {
 		return 0;
 	}
@@ -116,10 +128,10 @@ static ph7_hashmap_node *HashmapNewIntNode(ph7_hashmap *pMap, sxi64 iKey, sxu32
  * If something goes wrong [i.e: out of memory],this function return NULL.
  * Otherwise a fresh [ph7_hashmap_node] instance is returned.
  */
-static ph7_hashmap_node *HashmapNewBlobNode(ph7_hashmap *pMap, const void *pKey, sxu32 nKeyLen, sxu32 nHash, sxu32 nValIdx) {
+static ph7_hashmap_node *HashmapNewBlobNode(ph7_hashmap *pMap, SyBlob *pKey, sxu32 nHash, sxu32 nValIdx) {
 	ph7_hashmap_node *pNode;
 	/* Allocate a new node */
-	pNode = (ph7_hashmap_node *)SyMemBackendPoolAlloc(&pMap->pVm->sAllocator, sizeof(ph7_hashmap_node));
+	pNode = (ph7_hashmap_node *)SyMemBackendPoolAlloc(&pMap->pVm->sArena, sizeof(ph7_hashmap_node));
 	if(pNode == 0) {
 		return 0;
 	}
@@ -129,8 +141,9 @@ static ph7_hashmap_node *HashmapNewBlobNode(ph7_hashmap *pMap, const void *pKey,
 	pNode->pMap  = &(*pMap);
 	pNode->iType = HASHMAP_BLOB_NODE;
 	pNode->nHash = nHash;
-	SyBlobInit(&pNode->xKey.sKey, &pMap->pVm->sAllocator);
-	SyBlobAppend(&pNode->xKey.sKey, pKey, nKeyLen);
+	SyBlobInit(&pNode->xKey.sKey, &pMap->pVm->sArena);
+	/* Share the key contents instead of duplicating them */
+	SyBlobShare(pKey, &pNode->xKey.sKey);
 	pNode->nValIdx = nValIdx;
 	return pNode;
 }
@@ -188,11 +201,11 @@ PH7_PRIVATE void PH7_HashmapUnlinkNode(ph7_hashmap_node *pNode, int bRestore) {
 	if(pNode->iType == HASHMAP_BLOB_NODE) {
 		SyBlobRelease(&pNode->xKey.sKey);
 	}
-	SyMemBackendPoolFree(&pVm->sAllocator, pNode);
+	SyMemBackendPoolFree(&pVm->sArena, pNode);
 	pMap->nEntry--;
 	if(pMap->nEntry < 1) {
 		/* Free the hash-bucket */
-		SyMemBackendFree(&pVm->sAllocator, pMap->apBucket);
+		SyMemBackendFree(&pVm->sArena, pMap->apBucket);
 		pMap->apBucket = 0;
 		pMap->nSize = 0;
 		pMap->pFirst = pMap->pLast = pMap->pCur = 0;
@@ -213,7 +226,7 @@ static sxi32 HashmapGrowBucket(ph7_hashmap *pMap) {
 			nNew = 16;
 		}
 		/* Allocate a new bucket */
-		apNew = (ph7_hashmap_node **)SyMemBackendAlloc(&pMap->pVm->sAllocator, nNew * sizeof(ph7_hashmap_node *));
+		apNew = (ph7_hashmap_node **)SyMemBackendAlloc(&pMap->pVm->sArena, nNew * sizeof(ph7_hashmap_node *));
 		if(apNew == 0) {
 			if(pMap->nSize < 1) {
 				return SXERR_MEM; /* Fatal */
@@ -251,7 +264,7 @@ static sxi32 HashmapGrowBucket(ph7_hashmap *pMap) {
 			n++;
 		}
 		/* Free the old table */
-		SyMemBackendFree(&pMap->pVm->sAllocator, (void *)apOld);
+		SyMemBackendFree(&pMap->pVm->sArena, (void *)apOld);
 	}
 	return SXRET_OK;
 }
@@ -286,7 +299,7 @@ static sxi32 HashmapInsertIntKey(ph7_hashmap *pMap, sxi64 iKey, ph7_value *pValu
 	/* Make sure the bucket is big enough to hold the new entry */
 	rc = HashmapGrowBucket(&(*pMap));
 	if(rc != SXRET_OK) {
-		SyMemBackendPoolFree(&pMap->pVm->sAllocator, pNode);
+		SyMemBackendPoolFree(&pMap->pVm->sArena, pNode);
 		return rc;
 	}
 	/* Perform the insertion */
@@ -300,7 +313,7 @@ static sxi32 HashmapInsertIntKey(ph7_hashmap *pMap, sxi64 iKey, ph7_value *pValu
  * Insert a BLOB key and it's associated value (if any) in the given
  * hashmap.
  */
-static sxi32 HashmapInsertBlobKey(ph7_hashmap *pMap, const void *pKey, sxu32 nKeyLen, ph7_value *pValue, sxu32 nRefIdx) {
+static sxi32 HashmapInsertBlobKey(ph7_hashmap *pMap, SyBlob *pKey, ph7_value *pValue, sxu32 nRefIdx) {
 	ph7_hashmap_node *pNode;
 	sxu32 nHash;
 	sxu32 nIdx;
@@ -318,16 +331,16 @@ static sxi32 HashmapInsertBlobKey(ph7_hashmap *pMap, const void *pKey, sxu32 nKe
 	}
 	nIdx = pObj->nIdx;
 	/* Hash the key */
-	nHash = pMap->xBlobHash(pKey, nKeyLen);
+	nHash = HashmapBlobKeyHash(&(*pMap), pKey);
 	/* Allocate a new blob node */
-	pNode = HashmapNewBlobNode(&(*pMap), pKey, nKeyLen, nHash, nIdx);
+	pNode = HashmapNewBlobNode(&(*pMap), pKey, nHash, nIdx);
 	if(pNode == 0) {
 		return SXERR_MEM;
 	}
 	/* Make sure the bucket is big enough to hold the new entry */
 	rc = HashmapGrowBucket(&(*pMap));
 	if(rc != SXRET_OK) {
-		SyMemBackendPoolFree(&pMap->pVm->sAllocator, pNode);
+		SyMemBackendPoolFree(&pMap->pVm->sArena, pNode);
 		return rc;
 	}
 	/* Perform the insertion */
@@ -384,18 +397,19 @@ static sxi32 HashmapLookupIntKey(
  */
 static sxi32 HashmapLookupBlobKey(
 	ph7_hashmap *pMap,          /* Target hashmap */
-	const void *pKey,           /* Lookup key */
-	sxu32 nKeyLen,              /* Key length in bytes */
+	SyBlob *pKey,               /* Lookup key */
 	ph7_hashmap_node **ppNode   /* OUT: target node on success */
 ) {
 	ph7_hashmap_node *pNode;
+	sxu32 nKeyLen;
 	sxu32 nHash;
 	if(pMap->nEntry < 1) {
 		/* Don't bother hashing,there is no entry anyway */
 		return SXERR_NOTFOUND;
 	}
+	nKeyLen = SyBlobLength(pKey);
 	/* Hash the key first */
-	nHash = pMap->xBlobHash(pKey, nKeyLen);
+	nHash = HashmapBlobKeyHash(&(*pMap), pKey);
 	/* Point to the appropriate bucket */
 	pNode = pMap->apBucket[nHash & (pMap->nSize - 1)];
 	/* Perform the lookup */
@@ -406,7 +420,7 @@ static sxi32 HashmapLookupBlobKey(
 		if(pNode->iType == HASHMAP_BLOB_NODE
 				&& pNode->nHash == nHash
 				&& SyBlobLength(&pNode->xKey.sKey) == nKeyLen
-				&& SyMemcmp(SyBlobData(&pNode->xKey.sKey), pKey, nKeyLen) == 0) {
+				&& SyMemcmp(SyBlobData(&pNode->xKey.sKey), SyBlobData(pKey), nKeyLen) == 0) {
 			/* Node found */
 			if(ppNode) {
 				*ppNode = pNode;
@@ -464,7 +478,7 @@ static sxi32 HashmapLookup(
 		}
 		if(SyBlobLength(&pKey->sBlob) > 0 && !HashmapIsIntKey(&pKey->sBlob)) {
 			/* Perform a blob lookup */
-			rc = HashmapLookupBlobKey(&(*pMap), SyBlobData(&pKey->sBlob), SyBlobLength(&pKey->sBlob), &pNode);
+			rc = HashmapLookupBlobKey(&(*pMap), &pKey->sBlob, &pNode);
 			goto result;
 		}
 	}
@@ -511,11 +525,10 @@ static sxi32 HashmapInsert(
 			}
 			goto IntKey;
 		}
-		if(SXRET_OK == HashmapLookupBlobKey(&(*pMap), SyBlobData(&pKey->sBlob),
-											SyBlobLength(&pKey->sBlob), &pNode)) {
+		if(SXRET_OK == HashmapLookupBlobKey(&(*pMap), &pKey->sBlob, &pNode)) {
 			/* Overwrite the old value */
 			ph7_value *pElem;
-			pElem = (ph7_value *)SySetAt(&pMap->pVm->aMemObj, pNode->nValIdx);
+			pElem = PH7_VmMemObjAt(pMap->pVm, pNode->nValIdx);
 			if(pElem) {
 				if(pVal) {
 					PH7_MemObjStore(pVal, pElem);
@@ -527,7 +540,7 @@ static sxi32 HashmapInsert(
 			return SXRET_OK;
 		}
 		/* Perform a blob-key insertion */
-		rc = HashmapInsertBlobKey(&(*pMap), SyBlobData(&pKey->sBlob), SyBlobLength(&pKey->sBlob), &(*pVal), 0);
+		rc = HashmapInsertBlobKey(&(*pMap), &pKey->sBlob, &(*pVal), 0);
 		return rc;
 	}
 IntKey:
@@ -539,7 +552,7 @@ IntKey:
 		if(SXRET_OK == HashmapLookupIntKey(&(*pMap), pKey->x.iVal, &pNode)) {
 			/* Overwrite the old value */
 			ph7_value *pElem;
-			pElem = (ph7_value *)SySetAt(&pMap->pVm->aMemObj, pNode->nValIdx);
+			pElem = PH7_VmMemObjAt(pMap->pVm, pNode->nValIdx);
 			if(pElem) {
 				if(pVal) {
 					PH7_MemObjStore(pVal, pElem);
@@ -579,7 +592,7 @@ IntKey:
 static ph7_value *HashmapExtractNodeValue(ph7_hashmap_node *pNode) {
 	/* Point to the desired object */
 	ph7_value *pObj;
-	pObj = (ph7_value *)SySetAt(&pNode->pMap->pVm->aMemObj, pNode->nValIdx);
+	pObj = PH7_VmMemObjAt(pNode->pMap->pVm, pNode->nValIdx);
 	return pObj;
 }
 /*
@@ -606,8 +619,7 @@ static sxi32 HashmapInsertNode(ph7_hashmap *pMap, ph7_hashmap_node *pNode, int b
 		}
 	} else {
 		/* Blob key */
-		rc = HashmapInsertBlobKey(&(*pMap), SyBlobData(&pNode->xKey.sKey),
-								  SyBlobLength(&pNode->xKey.sKey), pObj, 0);
+		rc = HashmapInsertBlobKey(&(*pMap), &pNode->xKey.sKey, pObj, 0);
 	}
 	return rc;
 }
@@ -873,7 +885,7 @@ PH7_PRIVATE sxi32 PH7_HashmapCmp(
 		} else {
 			SyBlob *pKey = &pLe->xKey.sKey;
 			/* Blob key */
-			rc = HashmapLookupBlobKey(&(*pRight), SyBlobData(pKey), SyBlobLength(pKey), &pRe);
+			rc = HashmapLookupBlobKey(&(*pRight), pKey, &pRe);
 		}
 		if(rc != SXRET_OK) {
 			/* No such entry in the right side */
@@ -932,7 +944,7 @@ static sxi32 HashmapMerge(ph7_hashmap *pSrc, ph7_hashmap *pDest) {
 		if(pEntry->iType == HASHMAP_BLOB_NODE) {
 			/* Blob key insertion */
 			PH7_MemObjInitFromString(pDest->pVm, &sKey, 0);
-			PH7_MemObjStringAppend(&sKey, (const char *)SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey));
+			SyBlobShare(&pEntry->xKey.sKey, &sKey.sBlob);
 			rc = PH7_HashmapInsert(&(*pDest), &sKey, pVal);
 			PH7_MemObjRelease(&sKey);
 		} else {
@@ -980,7 +992,7 @@ static sxi32 HashmapOverwrite(ph7_hashmap *pSrc, ph7_hashmap *pDest) {
 		if(pEntry->iType == HASHMAP_BLOB_NODE) {
 			/* Blob key insertion */
 			PH7_MemObjInitFromString(pDest->pVm, &sKey, 0);
-			PH7_MemObjStringAppend(&sKey, (const char *)SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey));
+			SyBlobShare(&pEntry->xKey.sKey, &sKey.sBlob);
 		} else {
 			/* Int key insertion */
 			PH7_MemObjInitFromInt(pDest->pVm, &sKey, pEntry->xKey.iKey);
@@ -1001,7 +1013,7 @@ static sxi32 HashmapOverwrite(ph7_hashmap *pSrc, ph7_hashmap *pDest) {
  */
 PH7_PRIVATE sxi32 PH7_HashmapDup(ph7_hashmap *pSrc, ph7_hashmap *pDest) {
 	ph7_hashmap_node *pEntry;
-	ph7_value sKey, *pVal;
+	ph7_value *pVal;
 	sxi32 rc;
 	sxu32 n;
 	if(pSrc == pDest) {
@@ -1017,11 +1029,8 @@ PH7_PRIVATE sxi32 PH7_HashmapDup(ph7_hashmap *pSrc, ph7_hashmap *pDest) {
 		/* Extract the node value */
 		pVal = HashmapExtractNodeValue(pEntry);
 		if(pEntry->iType == HASHMAP_BLOB_NODE) {
-			/* Blob key insertion */
-			PH7_MemObjInitFromString(pDest->pVm, &sKey, 0);
-			PH7_MemObjStringAppend(&sKey, (const char *)SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey));
-			rc = PH7_HashmapInsert(&(*pDest), &sKey, pVal);
-			PH7_MemObjRelease(&sKey);
+			/* Blob key insertion, reuse the source key and it's cached hash */
+			rc = HashmapInsertBlobKey(&(*pDest), &pEntry->xKey.sKey, pVal, 0);
 		} else {
 			/* Int key insertion */
 			rc = HashmapInsertIntKey(&(*pDest), pEntry->xKey.iKey, pVal, 0);
@@ -1091,11 +1100,11 @@ PH7_PRIVATE sxi32 PH7_HashmapUnion(ph7_hashmap *pLeft, ph7_hashmap *pRight) {
 		if(pEntry->iType == HASHMAP_BLOB_NODE) {
 			/* BLOB key */
 			if(SXRET_OK !=
-					HashmapLookupBlobKey(&(*pLeft), SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey), 0)) {
+					HashmapLookupBlobKey(&(*pLeft), &pEntry->xKey.sKey, 0)) {
 				pObj = HashmapExtractNodeValue(pEntry);
 				if(pObj) {
 					/* Perform the insertion */
-					rc = HashmapInsertBlobKey(&(*pLeft), SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey),
+					rc = HashmapInsertBlobKey(&(*pLeft), &pEntry->xKey.sKey,
 											  pObj, 0);
 					if(rc != SXRET_OK) {
 						return rc;
@@ -1131,7 +1140,7 @@ PH7_PRIVATE ph7_hashmap *PH7_NewHashmap(
 ) {
 	ph7_hashmap *pMap;
 	/* Allocate a new instance */
-	pMap = (ph7_hashmap *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(ph7_hashmap));
+	pMap = (ph7_hashmap *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(ph7_hashmap));
 	if(pMap == 0) {
 		return 0;
 	}
@@ -1197,7 +1206,7 @@ PH7_PRIVATE sxi32 PH7_HashmapCreateSuper(ph7_vm *pVm) {
 		ph7_release_value(&(*pVm), pSuper);
 	}
 	/* Set some $_SERVER entries */
-	pFile = (SyString *)SySetPeek(&pVm->aFiles);
+	pFile = PH7_VmPeekFilePath(pVm);
 	/*
 	 * 'SCRIPT_FILENAME'
 	 * The absolute pathname of the currently executing script.
@@ -1211,19 +1220,17 @@ PH7_PRIVATE sxi32 PH7_HashmapCreateSuper(ph7_vm *pVm) {
 	return SXRET_OK;
 }
 /*
- * Release a hashmap.
+ * Release at most nMax entries starting from the first inserted one.
+ * The hash buckets are not updated, so this is only suitable for a hashmap
+ * being destroyed. Return the number of released entries.
  */
-PH7_PRIVATE sxi32 PH7_HashmapRelease(ph7_hashmap *pMap, int FreeDS) {
+static sxu32 HashmapReleaseEntries(ph7_hashmap *pMap, sxu32 nMax) {
 	ph7_hashmap_node *pEntry, *pNext;
 	ph7_vm *pVm = pMap->pVm;
 	sxu32 n;
-	/* Start the release process */
 	n = 0;
 	pEntry = pMap->pFirst;
-	for(;;) {
-		if(n >= pMap->nEntry) {
-			break;
-		}
+	while(n < nMax && pMap->nEntry > 0) {
 		pNext = pEntry->pPrev; /* Reverse link */
 		/* Remove the reference from the foreign table */
 		PH7_VmRefObjRemove(pVm, pEntry->nValIdx, 0, pEntry);
@@ -1233,18 +1240,29 @@ PH7_PRIVATE sxi32 PH7_HashmapRelease(ph7_hashmap *pMap, int FreeDS) {
 		if(pEntry->iType == HASHMAP_BLOB_NODE) {
 			SyBlobRelease(&pEntry->xKey.sKey);
 		}
-		SyMemBackendPoolFree(&pVm->sAllocator, pEntry);
+		SyMemBackendPoolFree(&pVm->sArena, pEntry);
 		/* Point to the next entry */
 		pEntry = pNext;
+		pMap->pFirst = pEntry;
+		pMap->nEntry--;
 		n++;
 	}
-	if(pMap->nEntry > 0) {
+	return n;
+}
+/*
+ * Release a hashmap.
+ */
+PH7_PRIVATE sxi32 PH7_HashmapRelease(ph7_hashmap *pMap, int FreeDS) {
+	ph7_vm *pVm = pMap->pVm;
+	/* Start the release process */
+	HashmapReleaseEntries(&(*pMap), pMap->nEntry);
+	if(pMap->apBucket) {
 		/* Release the hash bucket */
-		SyMemBackendFree(&pVm->sAllocator, pMap->apBucket);
+		SyMemBackendFree(&pVm->sArena, pMap->apBucket);
 	}
 	if(FreeDS) {
 		/* Free the whole instance */
-		SyMemBackendPoolFree(&pVm->sAllocator, pMap);
+		SyMemBackendPoolFree(&pVm->sArena, pMap);
 	} else {
 		/* Keep the instance but reset it's fields */
 		pMap->apBucket = 0;
@@ -1254,16 +1272,42 @@ PH7_PRIVATE sxi32 PH7_HashmapRelease(ph7_hashmap *pMap, int FreeDS) {
 	}
 	return SXRET_OK;
 }
+/*
+ * Release a slice of an unreferenced hashmap queued by PH7_VmDeferRelease().
+ * At most *pBudget entries are released [the whole hashmap if pBudget is NULL]
+ * and the budget is decremented accordingly.
+ * Return SXRET_OK once the hashmap is freed, SXERR_CONTINUE otherwise.
+ */
+PH7_PRIVATE sxi32 PH7_HashmapReleaseSlice(ph7_hashmap *pMap, sxu32 *pBudget) {
+	if(pBudget) {
+		*pBudget -= HashmapReleaseEntries(&(*pMap), *pBudget);
+		if(pMap->nEntry > 0) {
+			/* Resume on the next slice */
+			return SXERR_CONTINUE;
+		}
+	}
+	PH7_HashmapRelease(&(*pMap), TRUE);
+	return SXRET_OK;
+}
 /*
  * Decrement the reference count of a given hashmap.
  * If the count reaches zero which mean no more variables
  * are pointing to this hashmap,then release the whole instance.
+ * Large or deeply nested hashmaps are queued instead, and released
+ * in slices at the next safe point.
  */
 PH7_PRIVATE void  PH7_HashmapUnref(ph7_hashmap *pMap) {
 	/* TICKET 1432-49: $GLOBALS is not subject to garbage collection */
 	pMap->iRef--;
 	if(pMap->iRef < 1) {
+		ph7_vm *pVm = pMap->pVm;
+		if((pMap->nEntry >= PH7_FREE_DEFER_ENTRIES || pVm->nFreeDepth >= PH7_FREE_DEPTH_LIMIT)
+				&& PH7_VmDeferRelease(&(*pVm), pMap, MEMOBJ_HASHMAP) == SXRET_OK) {
+			return;
+		}
+		pVm->nFreeDepth++;
 		PH7_HashmapRelease(pMap, TRUE);
+		pVm->nFreeDepth--;
 	}
 }
 /*
@@ -1349,8 +1393,7 @@ PH7_PRIVATE void PH7_HashmapExtractNodeKey(ph7_hashmap_node *pNode, ph7_value *p
 		pKey->x.iVal = pNode->xKey.iKey;
 		MemObjSetType(pKey, MEMOBJ_INT);
 	} else {
-		SyBlobReset(&pKey->sBlob);
-		SyBlobAppend(&pKey->sBlob, SyBlobData(&pNode->xKey.sKey), SyBlobLength(&pNode->xKey.sKey));
+		SyBlobShare(&pNode->xKey.sKey, &pKey->sBlob);
 		MemObjSetType(pKey, MEMOBJ_STRING);
 	}
 }
@@ -3508,7 +3551,7 @@ static int ph7_hashmap_diff_assoc(ph7_context *pCtx, int nArg, ph7_value **apArg
 			if(pEntry->iType == HASHMAP_INT_NODE) {
 				rc = HashmapLookupIntKey(pMap, pEntry->xKey.iKey, &pN1);
 			} else {
-				rc = HashmapLookupBlobKey(pMap, SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey), &pN1);
+				rc = HashmapLookupBlobKey(pMap, &pEntry->xKey.sKey, &pN1);
 			}
 			if(rc != SXRET_OK) {
 				/* No such key,break immediately */
@@ -3604,7 +3647,7 @@ static int ph7_hashmap_diff_uassoc(ph7_context *pCtx, int nArg, ph7_value **apAr
 			if(pEntry->iType == HASHMAP_INT_NODE) {
 				rc = HashmapLookupIntKey(pMap, pEntry->xKey.iKey, &pN1);
 			} else {
-				rc = HashmapLookupBlobKey(pMap, SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey), &pN1);
+				rc = HashmapLookupBlobKey(pMap, &pEntry->xKey.sKey, &pN1);
 			}
 			if(rc != SXRET_OK) {
 				/* No such key,break immediately */
@@ -3689,7 +3732,7 @@ static int ph7_hashmap_diff_key(ph7_context *pCtx, int nArg, ph7_value **apArg)
 			if(pEntry->iType == HASHMAP_BLOB_NODE) {
 				SyBlob *pKey = &pEntry->xKey.sKey;
 				/* Blob lookup */
-				rc = HashmapLookupBlobKey(pMap, SyBlobData(pKey), SyBlobLength(pKey), 0);
+				rc = HashmapLookupBlobKey(pMap, pKey, 0);
 			} else {
 				/* Int lookup */
 				rc = HashmapLookupIntKey(pMap, pEntry->xKey.iKey, 0);
@@ -3852,7 +3895,7 @@ static int ph7_hashmap_intersect_assoc(ph7_context *pCtx, int nArg, ph7_value **
 				if(pEntry->iType == HASHMAP_INT_NODE) {
 					rc = HashmapLookupIntKey(pMap, pEntry->xKey.iKey, &pN1);
 				} else {
-					rc = HashmapLookupBlobKey(pMap, SyBlobData(&pEntry->xKey.sKey), SyBlobLength(&pEntry->xKey.sKey), &pN1);
+					rc = HashmapLookupBlobKey(pMap, &pEntry->xKey.sKey, &pN1);
 				}
 				if(rc != SXRET_OK) {
 					/* No such key,break immediately */
@@ -3934,7 +3977,7 @@ static int ph7_hashmap_intersect_key(ph7_context *pCtx, int nArg, ph7_value **ap
 			if(pEntry->iType == HASHMAP_BLOB_NODE) {
 				SyBlob *pKey = &pEntry->xKey.sKey;
 				/* Blob lookup */
-				rc = HashmapLookupBlobKey(pMap, SyBlobData(pKey), SyBlobLength(pKey), 0);
+				rc = HashmapLookupBlobKey(pMap, pKey, 0);
 			} else {
 				/* Int key */
 				rc = HashmapLookupIntKey(pMap, pEntry->xKey.iKey, 0);
@@ -5255,11 +5298,8 @@ static const ph7_builtin_func aHashmapFunc[] = {
 /*
  * Register the built-in hashmap functions defined above.
  */
-PH7_PRIVATE void PH7_RegisterHashmapFunctions(ph7_vm *pVm) {
-	sxu32 n;
-	for(n = 0 ; n < SX_ARRAYSIZE(aHashmapFunc) ; n++) {
-		ph7_create_function(&(*pVm), aHashmapFunc[n].zName, aHashmapFunc[n].xFunc, 0);
-	}
+PH7_PRIVATE sxi32 PH7_RegisterHashmapFunctions(ph7_builtin_table *pTable) {
+	return PH7_BuiltinTableAddFunc(&(*pTable), aHashmapFunc, SX_ARRAYSIZE(aHashmapFunc), PH7_BUILTIN_DATA_NONE);
 }
 /*
  * Dump a hashmap instance and it's entries and the store the dump in
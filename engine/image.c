@@ -0,0 +1,1107 @@
+/**
+ * @PROJECT     PH7 Engine for the AerScript Interpreter
+ * @COPYRIGHT   See COPYING in the top level directory
+ * @FILE        engine/image.c
+ * @DESCRIPTION Serialized bytecode images for the PH7 Engine
+ * @DEVELOPERS  Symisc Systems <devel@symisc.net>
+ *              Rafal Kupiec <belliash@codingworkshop.eu.org>
+ */
+#include "ph7int.h"
+
+/*
+ * A bytecode image holds everything the compiler left behind for a single script
+ * [i.e: instructions, literals, functions, classes and constants] so that the script
+ * can be executed later without being lexed, parsed and compiled again.
+ * The image only covers what was produced on top of a freshly initialized VM (the
+ * built-in library is always compiled by PH7_VmInit()) and is laid out as follows:
+ *   Header:  magic, format version, engine version, byte order, opcode count,
+ *            VM mark, image key [i.e: source path, size and mtime], payload size and CRC32.
+ *   Payload: literals, classes, functions, constants and the main bytecode.
+ * Pointer operands are replaced by their contents, shared operands are written once
+ * and referenced by their ordinal thereafter.
+ * Strings are stored null terminated so that the loader can point straight into
+ * a read-only memory view of the image instead of copying them. Only the instruction
+ * records are rebuilt, since they embed pointers and execution flags.
+ */
+#define PH7_IMAGE_MAGIC  "AERC"
+#define PH7_IMAGE_FORMAT 3          /* Bump whenever the layout below change */
+#define PH7_IMAGE_ORDER  0x01020304 /* Byte order check */
+/* Shared operand tags */
+#define PH7_IMAGE_REF_NULL 0 /* NULL operand */
+#define PH7_IMAGE_REF_NEW  1 /* Operand contents follow */
+/*
+ * Image serializer state.
+ */
+typedef struct VmImageWriter VmImageWriter;
+struct VmImageWriter {
+	ph7_vm *pVm;     /* VM being serialized */
+	SyBlob *pOut;    /* Output buffer */
+	SyString *pFile; /* Script every instruction must belong to */
+	SyHash hRef;     /* Shared operands written so far */
+	sxu32 nRef;      /* Total number of shared operands */
+	sxi32 rc;        /* SXRET_OK unless something cannot be serialized */
+};
+/*
+ * Image loader state.
+ */
+typedef struct VmImageReader VmImageReader;
+struct VmImageReader {
+	ph7_vm *pVm;                /* Target VM */
+	const unsigned char *zIn;   /* Current input position */
+	const unsigned char *zEnd;  /* End of input */
+	SyString *pFile;            /* Script the loaded instructions belong to */
+	SySet aRef;                 /* Shared operands loaded so far */
+	sxi32 rc;                   /* SXRET_OK unless the image is malformed */
+};
+/*
+ * Sum of the functions installed in the VM function table.
+ * Used to detect user functions overloading a function compiled before the mark.
+ */
+static sxuptr VmImageFuncSum(SyHash *pHash, sxu32 nSkip) {
+	SyHashEntry *pEntry;
+	sxuptr nSum = 0;
+	SyHashResetLoopCursor(pHash);
+	while((pEntry = SyHashGetNextEntry(pHash)) != 0) {
+		if(nSkip > 0) {
+			nSkip--;
+			continue;
+		}
+		nSum += (sxuptr)pEntry->pUserData;
+	}
+	return nSum;
+}
+/*
+ * Record the state of a VM before compiling a script, so that PH7_VmSaveImage()
+ * only serialize what the script itself produced.
+ */
+PH7_PRIVATE sxi32 PH7_VmImageMark(ph7_vm *pVm, VmImageMark *pMark) {
+	pMark->nInstr = SySetUsed(&pVm->aByteCode);
+	pMark->nLit = SySetUsed(&pVm->aLitObj);
+	pMark->nFunc = SyHashTotalEntry(&pVm->hFunction);
+	pMark->nClass = SyHashTotalEntry(&pVm->hClass);
+	pMark->nConst = SyHashTotalEntry(&pVm->hConstant);
+	pMark->nErr = pVm->sCodeGen.nErr;
+	pMark->nFuncSum = VmImageFuncSum(&pVm->hFunction, 0);
+	return SXRET_OK;
+}
+/*
+ * Serialization primitives.
+ */
+static void ImageWrite32(VmImageWriter *pWriter, sxu32 nVal) {
+	SyBlobAppend(pWriter->pOut, (const void *)&nVal, sizeof(sxu32));
+}
+static void ImageWrite64(VmImageWriter *pWriter, sxu64 nVal) {
+	SyBlobAppend(pWriter->pOut, (const void *)&nVal, sizeof(sxu64));
+}
+static void ImageWriteBuf(VmImageWriter *pWriter, const char *zBuf, sxu32 nByte) {
+	if(zBuf == 0) {
+		/* NULL pointer */
+		ImageWrite32(&(*pWriter), 0);
+		return;
+	}
+	ImageWrite32(&(*pWriter), nByte + 1);
+	SyBlobAppend(pWriter->pOut, (const void *)zBuf, nByte);
+	SyBlobAppend(pWriter->pOut, (const void *)"", sizeof(char));
+}
+static void ImageWriteString(VmImageWriter *pWriter, const SyString *pStr) {
+	ImageWriteBuf(&(*pWriter), pStr->zString, pStr->nByte);
+}
+static void ImageWriteCString(VmImageWriter *pWriter, const char *zStr) {
+	ImageWriteBuf(&(*pWriter), zStr, zStr ? SyStrlen(zStr) : 0);
+}
+/*
+ * Write a shared operand reference.
+ * Return TRUE if the operand contents must follow. FALSE otherwise.
+ */
+static int ImageWriteRef(VmImageWriter *pWriter, void **ppOperand) {
+	SyHashEntry *pEntry;
+	if(*ppOperand == 0) {
+		ImageWrite32(&(*pWriter), PH7_IMAGE_REF_NULL);
+		return FALSE;
+	}
+	pEntry = SyHashGet(&pWriter->hRef, (const void *)ppOperand, sizeof(void *));
+	if(pEntry) {
+		/* Already serialized */
+		ImageWrite32(&(*pWriter), PH7_IMAGE_REF_NEW + 1 + (sxu32)SX_PTR_TO_INT(pEntry->pUserData));
+		return FALSE;
+	}
+	/* The key must outlive the serialization, point to the operand slot */
+	SyHashInsert(&pWriter->hRef, (const void *)ppOperand, sizeof(void *), SX_INT_TO_PTR(pWriter->nRef));
+	pWriter->nRef++;
+	ImageWrite32(&(*pWriter), PH7_IMAGE_REF_NEW);
+	return TRUE;
+}
+/* Forward declaration */
+static void ImageWriteFunc(VmImageWriter *pWriter, ph7_vm_func *pFunc);
+static void ImageWriteByteCode(VmImageWriter *pWriter, SySet *pByteCode);
+/*
+ * Serialize the third operand of a VM instruction.
+ */
+static void ImageWriteOperand(VmImageWriter *pWriter, VmInstr *pInstr) {
+	switch(pInstr->iOp) {
+		case PH7_OP_LOADV:
+		case PH7_OP_STORE:
+		case PH7_OP_MEMBER:
+		case PH7_OP_IMPORT:
+		case PH7_OP_INCLUDE:
+			/* Null terminated string */
+			ImageWriteCString(&(*pWriter), (const char *)pInstr->p3);
+			break;
+		case PH7_OP_DECLARE:
+			if(pInstr->iP1 == 0) {
+				/* Variable name */
+				ImageWriteCString(&(*pWriter), (const char *)pInstr->p3);
+			} else if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				/* Constant declaration */
+				ph7_constant_info *pInfo = (ph7_constant_info *)pInstr->p3;
+				ImageWriteString(&(*pWriter), &pInfo->pName);
+				ImageWriteByteCode(&(*pWriter), pInfo->pConsCode);
+			}
+			break;
+		case PH7_OP_LOAD_CLOSURE:
+			if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				ImageWriteFunc(&(*pWriter), (ph7_vm_func *)pInstr->p3);
+			}
+			break;
+		case PH7_OP_CLASS_INIT:
+		case PH7_OP_INTERFACE_INIT:
+			if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				ph7_class_info *pInfo = (ph7_class_info *)pInstr->p3;
+				SyString *aName;
+				sxu32 n;
+				ImageWriteString(&(*pWriter), &pInfo->sName);
+				aName = (SyString *)SySetBasePtr(&pInfo->sExtends);
+				ImageWrite32(&(*pWriter), SySetUsed(&pInfo->sExtends));
+				for(n = 0 ; n < SySetUsed(&pInfo->sExtends) ; ++n) {
+					ImageWriteString(&(*pWriter), &aName[n]);
+				}
+				aName = (SyString *)SySetBasePtr(&pInfo->sImplements);
+				ImageWrite32(&(*pWriter), SySetUsed(&pInfo->sImplements));
+				for(n = 0 ; n < SySetUsed(&pInfo->sImplements) ; ++n) {
+					ImageWriteString(&(*pWriter), &aName[n]);
+				}
+			}
+			break;
+		case PH7_OP_FOREACH_INIT:
+		case PH7_OP_FOREACH_STEP:
+			if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				ph7_foreach_info *pInfo = (ph7_foreach_info *)pInstr->p3;
+				ImageWriteString(&(*pWriter), &pInfo->sKey);
+				ImageWriteString(&(*pWriter), &pInfo->sValue);
+			}
+			break;
+		case PH7_OP_LOAD_EXCEPTION:
+		case PH7_OP_POP_EXCEPTION:
+			if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				ph7_exception *pException = (ph7_exception *)pInstr->p3;
+				ph7_exception_block *aCatch;
+				sxu32 n;
+				aCatch = (ph7_exception_block *)SySetBasePtr(&pException->sEntry);
+				ImageWrite32(&(*pWriter), SySetUsed(&pException->sEntry));
+				for(n = 0 ; n < SySetUsed(&pException->sEntry) ; ++n) {
+					ImageWriteString(&(*pWriter), &aCatch[n].sClass);
+					ImageWriteString(&(*pWriter), &aCatch[n].sThis);
+					ImageWriteByteCode(&(*pWriter), &aCatch[n].sByteCode);
+				}
+				ImageWriteByteCode(&(*pWriter), &pException->sFinally);
+			}
+			break;
+		case PH7_OP_SWITCH:
+			if(ImageWriteRef(&(*pWriter), &pInstr->p3)) {
+				ph7_switch *pSwitch = (ph7_switch *)pInstr->p3;
+				ph7_case_expr *aCase;
+				sxu32 n;
+				aCase = (ph7_case_expr *)SySetBasePtr(&pSwitch->aCaseExpr);
+				ImageWrite32(&(*pWriter), SySetUsed(&pSwitch->aCaseExpr));
+				for(n = 0 ; n < SySetUsed(&pSwitch->aCaseExpr) ; ++n) {
+					ImageWrite32(&(*pWriter), aCase[n].nStart);
+					ImageWriteByteCode(&(*pWriter), &aCase[n].aByteCode);
+				}
+				ImageWrite32(&(*pWriter), pSwitch->nOut);
+				ImageWrite32(&(*pWriter), pSwitch->nDefault);
+			}
+			break;
+		default:
+			if(pInstr->p3) {
+				/* Unknown operand */
+				pWriter->rc = SXERR_NOTIMPLEMENTED;
+			}
+			break;
+	}
+}
+/*
+ * Serialize a bytecode container.
+ */
+static void ImageWriteByteCode(VmImageWriter *pWriter, SySet *pByteCode) {
+	VmInstr *aInstr;
+	sxu32 n;
+	aInstr = (VmInstr *)SySetBasePtr(pByteCode);
+	ImageWrite32(&(*pWriter), SySetUsed(pByteCode));
+	for(n = 0 ; n < SySetUsed(pByteCode) ; ++n) {
+		if(aInstr[n].pFile != pWriter->pFile) {
+			/* Instruction compiled from another source */
+			pWriter->rc = SXERR_NOTIMPLEMENTED;
+		}
+		SyBlobAppend(pWriter->pOut, (const void *)&aInstr[n].iOp, sizeof(sxu8));
+		ImageWrite32(&(*pWriter), (sxu32)aInstr[n].iP1);
+		ImageWrite32(&(*pWriter), aInstr[n].iP2);
+		ImageWrite32(&(*pWriter), aInstr[n].iLine);
+		ImageWriteOperand(&(*pWriter), &aInstr[n]);
+	}
+}
+/*
+ * Serialize a function signature and body [i.e: arguments, static variables, closure
+ * environment and bytecode].
+ */
+static void ImageWriteFuncBody(VmImageWriter *pWriter, ph7_vm_func *pFunc) {
+	ph7_vm_func_closure_env *aEnv;
+	ph7_vm_func_static_var *aStatic;
+	ph7_vm_func_arg *aArg;
+	sxu32 n;
+	ImageWrite32(&(*pWriter), pFunc->nType);
+	ImageWriteString(&(*pWriter), &pFunc->sSignature);
+	aArg = (ph7_vm_func_arg *)SySetBasePtr(&pFunc->aArgs);
+	ImageWrite32(&(*pWriter), SySetUsed(&pFunc->aArgs));
+	for(n = 0 ; n < SySetUsed(&pFunc->aArgs) ; ++n) {
+		ImageWriteString(&(*pWriter), &aArg[n].sName);
+		ImageWrite32(&(*pWriter), aArg[n].nType);
+		ImageWriteString(&(*pWriter), &aArg[n].sClass);
+		ImageWrite32(&(*pWriter), (sxu32)aArg[n].iFlags);
+		ImageWriteByteCode(&(*pWriter), &aArg[n].aByteCode);
+	}
+	aStatic = (ph7_vm_func_static_var *)SySetBasePtr(&pFunc->aStatic);
+	ImageWrite32(&(*pWriter), SySetUsed(&pFunc->aStatic));
+	for(n = 0 ; n < SySetUsed(&pFunc->aStatic) ; ++n) {
+		ImageWriteString(&(*pWriter), &aStatic[n].sName);
+		ImageWrite32(&(*pWriter), (sxu32)aStatic[n].iFlags);
+		ImageWriteByteCode(&(*pWriter), &aStatic[n].aByteCode);
+	}
+	aEnv = (ph7_vm_func_closure_env *)SySetBasePtr(&pFunc->aClosureEnv);
+	ImageWrite32(&(*pWriter), SySetUsed(&pFunc->aClosureEnv));
+	for(n = 0 ; n < SySetUsed(&pFunc->aClosureEnv) ; ++n) {
+		ImageWriteString(&(*pWriter), &aEnv[n].sName);
+		ImageWrite32(&(*pWriter), (sxu32)aEnv[n].iFlags);
+	}
+	ImageWriteByteCode(&(*pWriter), &pFunc->aByteCode);
+}
+/*
+ * Serialize a standalone function or closure.
+ */
+static void ImageWriteFunc(VmImageWriter *pWriter, ph7_vm_func *pFunc) {
+	if(pFunc->pUserData || pFunc->pClass) {
+		/* Not a script function */
+		pWriter->rc = SXERR_NOTIMPLEMENTED;
+	}
+	ImageWriteString(&(*pWriter), &pFunc->sName);
+	ImageWrite32(&(*pWriter), (sxu32)pFunc->iFlags);
+	ImageWriteFuncBody(&(*pWriter), pFunc);
+}
+/*
+ * Collect the newest entries of a hashtable in insertion order.
+ * Hashtables are walked from the most recent entry, so the collected set
+ * is reversed in place.
+ */
+static void ImageCollectEntries(SyHash *pHash, sxu32 nOld, SySet *pOut) {
+	SyHashEntry *pEntry, **apEntry;
+	sxu32 nNew, i, j;
+	nNew = SyHashTotalEntry(pHash) > nOld ? SyHashTotalEntry(pHash) - nOld : 0;
+	SyHashResetLoopCursor(pHash);
+	while(SySetUsed(pOut) < nNew && (pEntry = SyHashGetNextEntry(pHash)) != 0) {
+		SySetPut(pOut, (const void *)&pEntry);
+	}
+	apEntry = (SyHashEntry **)SySetBasePtr(pOut);
+	for(i = 0, j = SySetUsed(pOut) ; i + 1 < j ; ++i, --j) {
+		pEntry = apEntry[i];
+		apEntry[i] = apEntry[j - 1];
+		apEntry[j - 1] = pEntry;
+	}
+}
+/*
+ * Serialize a compiled class or interface.
+ */
+static void ImageWriteClass(VmImageWriter *pWriter, ph7_class *pClass) {
+	SyHashEntry **apEntry;
+	SySet aEntry;
+	sxu32 n;
+	if(pClass->pBase || SySetUsed(&pClass->aInterface) > 0 || SyHashTotalEntry(&pClass->hDerived) > 0) {
+		/* Already linked, this happen at run-time only */
+		pWriter->rc = SXERR_NOTIMPLEMENTED;
+		return;
+	}
+	SySetInit(&aEntry, &pWriter->pVm->sAllocator, sizeof(SyHashEntry *));
+	ImageWriteString(&(*pWriter), &pClass->sName);
+	ImageWrite32(&(*pWriter), (sxu32)pClass->iFlags);
+	/* Attributes */
+	ImageCollectEntries(&pClass->hAttr, 0, &aEntry);
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	ImageWrite32(&(*pWriter), SySetUsed(&aEntry));
+	for(n = 0 ; n < SySetUsed(&aEntry) ; ++n) {
+		ph7_class_attr *pAttr = (ph7_class_attr *)apEntry[n]->pUserData;
+		ImageWriteString(&(*pWriter), &pAttr->sName);
+		ImageWrite32(&(*pWriter), (sxu32)pAttr->iFlags);
+		ImageWrite32(&(*pWriter), (sxu32)pAttr->iProtection);
+		ImageWrite32(&(*pWriter), pAttr->nType);
+		ImageWrite32(&(*pWriter), pAttr->nLine);
+		ImageWriteByteCode(&(*pWriter), &pAttr->aByteCode);
+	}
+	/* Methods */
+	SySetReset(&aEntry);
+	ImageCollectEntries(&pClass->hMethod, 0, &aEntry);
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	ImageWrite32(&(*pWriter), SySetUsed(&aEntry));
+	for(n = 0 ; n < SySetUsed(&aEntry) ; ++n) {
+		ph7_class_method *pMeth = (ph7_class_method *)apEntry[n]->pUserData;
+		ImageWriteString(&(*pWriter), &pMeth->sFunc.sName);
+		ImageWrite32(&(*pWriter), pMeth->nLine);
+		ImageWrite32(&(*pWriter), (sxu32)pMeth->iProtection);
+		ImageWrite32(&(*pWriter), (sxu32)pMeth->iFlags);
+		ImageWrite32(&(*pWriter), (sxu32)pMeth->sFunc.iFlags);
+		ImageWriteFuncBody(&(*pWriter), &pMeth->sFunc);
+	}
+	SySetRelease(&aEntry);
+}
+/*
+ * Serialize a literal.
+ */
+static void ImageWriteLiteral(VmImageWriter *pWriter, ph7_value *pObj) {
+	if(pObj->nType & ~(MEMOBJ_SCALAR | MEMOBJ_CALL)) {
+		/* Arrays, objects and resources are created at run-time */
+		pWriter->rc = SXERR_NOTIMPLEMENTED;
+		return;
+	}
+	ImageWrite32(&(*pWriter), pObj->nType);
+	ImageWrite32(&(*pWriter), (sxu32)pObj->iFlags);
+	ImageWrite64(&(*pWriter), (sxu64)pObj->x.iVal);
+	ImageWrite32(&(*pWriter), pObj->sBlob.nFlags & (SXBLOB_INTERN | SXBLOB_HASHED));
+	ImageWriteBuf(&(*pWriter), (const char *)SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob));
+}
+/*
+ * Serialize everything compiled since the given mark into a bytecode image.
+ * This function must be called after the script is compiled but before the VM
+ * is made ready [i.e: PH7_VmMakeReady()].
+ * Return SXRET_OK on success. Any other return value indicates that the script
+ * cannot be cached, in which case the output buffer is left empty.
+ */
+PH7_PRIVATE sxi32 PH7_VmSaveImage(ph7_vm *pVm, const VmImageMark *pMark, const VmImageKey *pKey, SyBlob *pOut) {
+	VmImageWriter sWriter;
+	SyHashEntry **apEntry;
+	ph7_value *aLit;
+	SySet aEntry;
+	SyBlob sPayload;
+	sxu32 n;
+	SyBlobReset(pOut);
+	if(pMark->nInstr != 0 || pVm->pByteContainer != &pVm->aByteCode || pVm->sCodeGen.nErr != pMark->nErr) {
+		/* Nothing to do, or diagnostics which would not be reported on a hit */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	if(SyHashTotalEntry(&pVm->hFunction) < pMark->nFunc || SyHashTotalEntry(&pVm->hClass) < pMark->nClass ||
+			SyHashTotalEntry(&pVm->hConstant) < pMark->nConst || SySetUsed(&pVm->aLitObj) < pMark->nLit) {
+		return SXERR_CORRUPT;
+	}
+	if(VmImageFuncSum(&pVm->hFunction, SyHashTotalEntry(&pVm->hFunction) - pMark->nFunc) != pMark->nFuncSum) {
+		/* A function compiled before the mark was overloaded */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	/* Initialize the serializer */
+	SyZero(&sWriter, sizeof(VmImageWriter));
+	SyBlobInit(&sPayload, &pVm->sAllocator);
+	sWriter.pVm = pVm;
+	sWriter.pOut = &sPayload;
+	sWriter.pFile = PH7_VmPeekFilePath(pVm);
+	sWriter.rc = SXRET_OK;
+	SyHashInit(&sWriter.hRef, &pVm->sAllocator, 0, 0);
+	SySetInit(&aEntry, &pVm->sAllocator, sizeof(SyHashEntry *));
+	/* Literals */
+	aLit = (ph7_value *)SySetBasePtr(&pVm->aLitObj);
+	ImageWrite32(&sWriter, SySetUsed(&pVm->aLitObj) - pMark->nLit);
+	for(n = pMark->nLit ; n < SySetUsed(&pVm->aLitObj) ; ++n) {
+		ImageWriteLiteral(&sWriter, &aLit[n]);
+	}
+	/* Classes and interfaces */
+	ImageCollectEntries(&pVm->hClass, pMark->nClass, &aEntry);
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	ImageWrite32(&sWriter, SySetUsed(&aEntry));
+	for(n = 0 ; n < SySetUsed(&aEntry) ; ++n) {
+		ImageWriteClass(&sWriter, (ph7_class *)apEntry[n]->pUserData);
+	}
+	/* Functions, overloaded ones are chained from the newest to the oldest */
+	SySetReset(&aEntry);
+	ImageCollectEntries(&pVm->hFunction, pMark->nFunc, &aEntry);
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	ImageWrite32(&sWriter, SySetUsed(&aEntry));
+	for(n = 0 ; n < SySetUsed(&aEntry) ; ++n) {
+		ph7_vm_func *pFunc, *apChain[64];
+		sxu32 nChain = 0;
+		for(pFunc = (ph7_vm_func *)apEntry[n]->pUserData ; pFunc ; pFunc = pFunc->pNextName) {
+			if(nChain >= SX_ARRAYSIZE(apChain)) {
+				sWriter.rc = SXERR_NOTIMPLEMENTED;
+				break;
+			}
+			apChain[nChain++] = pFunc;
+		}
+		ImageWrite32(&sWriter, nChain);
+		while(nChain > 0) {
+			ImageWriteFunc(&sWriter, apChain[--nChain]);
+		}
+	}
+	/* Global constants */
+	SySetReset(&aEntry);
+	ImageCollectEntries(&pVm->hConstant, pMark->nConst, &aEntry);
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	ImageWrite32(&sWriter, SySetUsed(&aEntry));
+	for(n = 0 ; n < SySetUsed(&aEntry) ; ++n) {
+		ph7_constant *pCons = (ph7_constant *)apEntry[n]->pUserData;
+		if(pCons == 0 || pCons->xExpand != PH7_VmExpandConstantValue) {
+			/* Foreign constant */
+			sWriter.rc = SXERR_NOTIMPLEMENTED;
+			break;
+		}
+		ImageWriteString(&sWriter, &pCons->sName);
+		ImageWriteByteCode(&sWriter, (SySet *)pCons->pUserData);
+	}
+	/* Main program */
+	ImageWriteByteCode(&sWriter, &pVm->aByteCode);
+	SySetRelease(&aEntry);
+	SyHashRelease(&sWriter.hRef);
+	if(sWriter.rc == SXRET_OK) {
+		/* Image header */
+		sWriter.pOut = &(*pOut);
+		SyBlobAppend(pOut, (const void *)PH7_IMAGE_MAGIC, sizeof(PH7_IMAGE_MAGIC) - 1);
+		ImageWrite32(&sWriter, PH7_IMAGE_FORMAT);
+		ImageWriteCString(&sWriter, PH7_VERSION);
+		ImageWrite32(&sWriter, PH7_IMAGE_ORDER);
+		ImageWrite32(&sWriter, PH7_OP_SWITCH);
+		ImageWrite32(&sWriter, pMark->nLit);
+		ImageWrite32(&sWriter, pMark->nFunc);
+		ImageWrite32(&sWriter, pMark->nClass);
+		ImageWrite32(&sWriter, pMark->nConst);
+		ImageWriteString(&sWriter, &pKey->sPath);
+		ImageWrite64(&sWriter, (sxu64)pKey->nSize);
+		ImageWrite64(&sWriter, (sxu64)pKey->nMtime);
+		ImageWrite32(&sWriter, pKey->nCrc);
+		ImageWrite32(&sWriter, SyBlobLength(&sPayload));
+		ImageWrite32(&sWriter, SyCrc32(SyBlobData(&sPayload), SyBlobLength(&sPayload)));
+		SyBlobAppend(pOut, SyBlobData(&sPayload), SyBlobLength(&sPayload));
+	}
+	SyBlobRelease(&sPayload);
+	return sWriter.rc;
+}
+/*
+ * Deserialization primitives.
+ * On malformed input, these functions set the reader error code and return
+ * a zeroed value so that callers can finish their current step safely.
+ */
+static const unsigned char *ImageReadRaw(VmImageReader *pReader, sxu32 nByte) {
+	const unsigned char *zRaw = pReader->zIn;
+	if(pReader->rc != SXRET_OK || (sxu32)(pReader->zEnd - pReader->zIn) < nByte) {
+		pReader->rc = SXERR_CORRUPT;
+		return 0;
+	}
+	pReader->zIn += nByte;
+	return zRaw;
+}
+static sxu32 ImageRead32(VmImageReader *pReader) {
+	const unsigned char *zRaw;
+	sxu32 nVal = 0;
+	zRaw = ImageReadRaw(&(*pReader), sizeof(sxu32));
+	if(zRaw) {
+		SyMemcpy((const void *)zRaw, (void *)&nVal, sizeof(sxu32));
+	}
+	return nVal;
+}
+static sxu64 ImageRead64(VmImageReader *pReader) {
+	const unsigned char *zRaw;
+	sxu64 nVal = 0;
+	zRaw = ImageReadRaw(&(*pReader), sizeof(sxu64));
+	if(zRaw) {
+		SyMemcpy((const void *)zRaw, (void *)&nVal, sizeof(sxu64));
+	}
+	return nVal;
+}
+/*
+ * Point to a string stored in the image without copying it.
+ * Return FALSE if the string is a NULL pointer. TRUE otherwise.
+ */
+static int ImageReadView(VmImageReader *pReader, SyString *pOut) {
+	sxu32 nByte;
+	SyStringInitFromBuf(pOut, 0, 0);
+	nByte = ImageRead32(&(*pReader));
+	if(nByte == 0) {
+		return FALSE;
+	}
+	pOut->zString = (const char *)ImageReadRaw(&(*pReader), nByte);
+	if(pOut->zString == 0) {
+		return FALSE;
+	}
+	if(pOut->zString[nByte - 1] != 0) {
+		/* Not null terminated */
+		pReader->rc = SXERR_CORRUPT;
+		pOut->zString = 0;
+		return FALSE;
+	}
+	pOut->nByte = nByte - 1;
+	return TRUE;
+}
+/*
+ * Read a string and either intern it in the VM string table or point to it
+ * in place, in which case the image must outlive the VM.
+ */
+static void ImageReadString(VmImageReader *pReader, SyString *pOut, int bIntern) {
+	char *zIntern;
+	if(!ImageReadView(&(*pReader), &(*pOut)) || !bIntern) {
+		return;
+	}
+	zIntern = PH7_VmInternString(pReader->pVm, pOut->zString, pOut->nByte);
+	if(zIntern == 0) {
+		pReader->rc = SXERR_MEM;
+		return;
+	}
+	pOut->zString = zIntern;
+}
+/*
+ * Read a shared operand reference.
+ * Return TRUE if the operand contents follow, in which case the caller must
+ * register the new operand via ImageRegisterRef(). FALSE otherwise.
+ */
+static int ImageReadRef(VmImageReader *pReader, void **ppOperand) {
+	sxu32 nRef;
+	*ppOperand = 0;
+	nRef = ImageRead32(&(*pReader));
+	if(nRef == PH7_IMAGE_REF_NEW) {
+		return pReader->rc == SXRET_OK;
+	} else if(nRef > PH7_IMAGE_REF_NEW) {
+		nRef -= PH7_IMAGE_REF_NEW + 1;
+		if(nRef >= SySetUsed(&pReader->aRef)) {
+			pReader->rc = SXERR_CORRUPT;
+		} else {
+			*ppOperand = ((void **)SySetBasePtr(&pReader->aRef))[nRef];
+		}
+	}
+	return FALSE;
+}
+static void *ImageAllocRef(VmImageReader *pReader, sxu32 nByte) {
+	void *pOperand;
+	pOperand = SyMemBackendPoolAlloc(&pReader->pVm->sAllocator, nByte);
+	if(pOperand == 0) {
+		pReader->rc = SXERR_MEM;
+		return 0;
+	}
+	SyZero(pOperand, nByte);
+	SySetPut(&pReader->aRef, (const void *)&pOperand);
+	return pOperand;
+}
+/* Forward declaration */
+static ph7_vm_func *ImageReadFunc(VmImageReader *pReader);
+static void ImageReadByteCode(VmImageReader *pReader, SySet *pByteCode);
+/*
+ * Load the third operand of a VM instruction.
+ */
+static void ImageReadOperand(VmImageReader *pReader, VmInstr *pInstr) {
+	ph7_vm *pVm = pReader->pVm;
+	SyString sStr;
+	sxu32 n, nEntry;
+	pInstr->p3 = 0;
+	switch(pInstr->iOp) {
+		case PH7_OP_LOADV:
+		case PH7_OP_STORE:
+		case PH7_OP_MEMBER:
+			/* Interned identifier */
+			ImageReadString(&(*pReader), &sStr, TRUE);
+			pInstr->p3 = (void *)sStr.zString;
+			break;
+		case PH7_OP_IMPORT:
+		case PH7_OP_INCLUDE:
+			ImageReadString(&(*pReader), &sStr, FALSE);
+			pInstr->p3 = (void *)sStr.zString;
+			break;
+		case PH7_OP_DECLARE:
+			if(pInstr->iP1 == 0) {
+				ImageReadString(&(*pReader), &sStr, TRUE);
+				pInstr->p3 = (void *)sStr.zString;
+			} else if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				ph7_constant_info *pInfo = (ph7_constant_info *)ImageAllocRef(&(*pReader), sizeof(ph7_constant_info));
+				SySet *pConsCode;
+				if(pInfo == 0) {
+					break;
+				}
+				pConsCode = (SySet *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(SySet));
+				if(pConsCode == 0) {
+					pReader->rc = SXERR_MEM;
+					break;
+				}
+				ImageReadString(&(*pReader), &pInfo->pName, FALSE);
+				SySetInit(pConsCode, &pVm->sAllocator, sizeof(VmInstr));
+				ImageReadByteCode(&(*pReader), pConsCode);
+				SySetSetUserData(pConsCode, pVm);
+				pInfo->pConsCode = pConsCode;
+				pInstr->p3 = pInfo;
+			}
+			break;
+		case PH7_OP_LOAD_CLOSURE:
+			if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				void **ppSlot;
+				/* Reserve the slot first, closures may reference closures */
+				SySetPut(&pReader->aRef, (const void *)&pInstr->p3);
+				nEntry = SySetUsed(&pReader->aRef) - 1;
+				pInstr->p3 = ImageReadFunc(&(*pReader));
+				ppSlot = (void **)SySetBasePtr(&pReader->aRef);
+				ppSlot[nEntry] = pInstr->p3;
+			}
+			break;
+		case PH7_OP_CLASS_INIT:
+		case PH7_OP_INTERFACE_INIT:
+			if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				ph7_class_info *pInfo;
+				if(!ImageReadView(&(*pReader), &sStr)) {
+					pReader->rc = SXERR_CORRUPT;
+					break;
+				}
+				pInfo = PH7_NewClassInfo(pVm, &sStr);
+				if(pInfo == 0) {
+					pReader->rc = SXERR_MEM;
+					break;
+				}
+				SySetPut(&pReader->aRef, (const void *)&pInfo);
+				nEntry = ImageRead32(&(*pReader));
+				for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+					ImageReadString(&(*pReader), &sStr, FALSE);
+					SySetPut(&pInfo->sExtends, (const void *)&sStr);
+				}
+				nEntry = ImageRead32(&(*pReader));
+				for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+					ImageReadString(&(*pReader), &sStr, FALSE);
+					SySetPut(&pInfo->sImplements, (const void *)&sStr);
+				}
+				pInstr->p3 = pInfo;
+			}
+			break;
+		case PH7_OP_FOREACH_INIT:
+		case PH7_OP_FOREACH_STEP:
+			if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				ph7_foreach_info *pInfo = (ph7_foreach_info *)ImageAllocRef(&(*pReader), sizeof(ph7_foreach_info));
+				if(pInfo == 0) {
+					break;
+				}
+				ImageReadString(&(*pReader), &pInfo->sKey, FALSE);
+				ImageReadString(&(*pReader), &pInfo->sValue, FALSE);
+				pInstr->p3 = pInfo;
+			}
+			break;
+		case PH7_OP_LOAD_EXCEPTION:
+		case PH7_OP_POP_EXCEPTION:
+			if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				ph7_exception *pException = (ph7_exception *)ImageAllocRef(&(*pReader), sizeof(ph7_exception));
+				ph7_exception_block sCatch;
+				if(pException == 0) {
+					break;
+				}
+				pException->pVm = pVm;
+				SySetInit(&pException->sEntry, &pVm->sAllocator, sizeof(ph7_exception_block));
+				SySetInit(&pException->sFinally, &pVm->sAllocator, sizeof(VmInstr));
+				nEntry = ImageRead32(&(*pReader));
+				for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+					SyZero(&sCatch, sizeof(ph7_exception_block));
+					SySetInit(&sCatch.sByteCode, &pVm->sAllocator, sizeof(VmInstr));
+					ImageReadString(&(*pReader), &sCatch.sClass, FALSE);
+					ImageReadString(&(*pReader), &sCatch.sThis, FALSE);
+					ImageReadByteCode(&(*pReader), &sCatch.sByteCode);
+					SySetPut(&pException->sEntry, (const void *)&sCatch);
+				}
+				ImageReadByteCode(&(*pReader), &pException->sFinally);
+				pInstr->p3 = pException;
+			}
+			break;
+		case PH7_OP_SWITCH:
+			if(ImageReadRef(&(*pReader), &pInstr->p3)) {
+				ph7_switch *pSwitch = (ph7_switch *)ImageAllocRef(&(*pReader), sizeof(ph7_switch));
+				ph7_case_expr sCase;
+				if(pSwitch == 0) {
+					break;
+				}
+				SySetInit(&pSwitch->aCaseExpr, &pVm->sAllocator, sizeof(ph7_case_expr));
+				nEntry = ImageRead32(&(*pReader));
+				for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+					SyZero(&sCase, sizeof(ph7_case_expr));
+					SySetInit(&sCase.aByteCode, &pVm->sAllocator, sizeof(VmInstr));
+					sCase.nStart = ImageRead32(&(*pReader));
+					ImageReadByteCode(&(*pReader), &sCase.aByteCode);
+					SySetPut(&pSwitch->aCaseExpr, (const void *)&sCase);
+				}
+				pSwitch->nOut = ImageRead32(&(*pReader));
+				pSwitch->nDefault = ImageRead32(&(*pReader));
+				pInstr->p3 = pSwitch;
+			}
+			break;
+		default:
+			break;
+	}
+}
+/*
+ * Load a bytecode container.
+ */
+static void ImageReadByteCode(VmImageReader *pReader, SySet *pByteCode) {
+	const unsigned char *zOp;
+	VmInstr sInstr;
+	sxu32 n, nInstr;
+	nInstr = ImageRead32(&(*pReader));
+	if(nInstr > (sxu32)(pReader->zEnd - pReader->zIn)) {
+		/* Cannot be that large */
+		pReader->rc = SXERR_CORRUPT;
+		return;
+	}
+	if(nInstr > 0) {
+		SySetAlloc(pByteCode, (sxi32)nInstr);
+	}
+	for(n = 0 ; n < nInstr && pReader->rc == SXRET_OK ; ++n) {
+		zOp = ImageReadRaw(&(*pReader), sizeof(sxu8));
+		if(zOp == 0) {
+			break;
+		}
+		sInstr.iOp = zOp[0];
+		sInstr.iP1 = (sxi32)ImageRead32(&(*pReader));
+		sInstr.iP2 = ImageRead32(&(*pReader));
+		sInstr.iLine = ImageRead32(&(*pReader));
+		sInstr.bExec = FALSE;
+		sInstr.pFile = pReader->pFile;
+		ImageReadOperand(&(*pReader), &sInstr);
+		if(SySetPut(pByteCode, (const void *)&sInstr) != SXRET_OK) {
+			pReader->rc = SXERR_MEM;
+		}
+	}
+}
+/*
+ * Load a function signature and body.
+ */
+static void ImageReadFuncBody(VmImageReader *pReader, ph7_vm_func *pFunc) {
+	ph7_vm *pVm = pReader->pVm;
+	ph7_vm_func_closure_env sEnv;
+	ph7_vm_func_static_var sStatic;
+	ph7_vm_func_arg sArg;
+	sxu32 n, nEntry;
+	pFunc->nType = ImageRead32(&(*pReader));
+	ImageReadString(&(*pReader), &pFunc->sSignature, FALSE);
+	nEntry = ImageRead32(&(*pReader));
+	for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+		SyZero(&sArg, sizeof(ph7_vm_func_arg));
+		SySetInit(&sArg.aByteCode, &pVm->sAllocator, sizeof(VmInstr));
+		ImageReadString(&(*pReader), &sArg.sName, TRUE);
+		sArg.nType = ImageRead32(&(*pReader));
+		ImageReadString(&(*pReader), &sArg.sClass, FALSE);
+		sArg.iFlags = (sxi32)ImageRead32(&(*pReader));
+		ImageReadByteCode(&(*pReader), &sArg.aByteCode);
+		SySetPut(&pFunc->aArgs, (const void *)&sArg);
+	}
+	nEntry = ImageRead32(&(*pReader));
+	for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+		SyZero(&sStatic, sizeof(ph7_vm_func_static_var));
+		SySetInit(&sStatic.aByteCode, &pVm->sAllocator, sizeof(VmInstr));
+		sStatic.nIdx = SXU32_HIGH; /* Not yet created */
+		ImageReadString(&(*pReader), &sStatic.sName, TRUE);
+		sStatic.iFlags = (sxi32)ImageRead32(&(*pReader));
+		ImageReadByteCode(&(*pReader), &sStatic.aByteCode);
+		SySetPut(&pFunc->aStatic, (const void *)&sStatic);
+	}
+	nEntry = ImageRead32(&(*pReader));
+	for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+		SyZero(&sEnv, sizeof(ph7_vm_func_closure_env));
+		PH7_MemObjInit(pVm, &sEnv.sValue);
+		ImageReadString(&(*pReader), &sEnv.sName, TRUE);
+		sEnv.iFlags = (int)ImageRead32(&(*pReader));
+		SySetPut(&pFunc->aClosureEnv, (const void *)&sEnv);
+	}
+	ImageReadByteCode(&(*pReader), &pFunc->aByteCode);
+}
+/*
+ * Load a standalone function or closure.
+ */
+static ph7_vm_func *ImageReadFunc(VmImageReader *pReader) {
+	ph7_vm *pVm = pReader->pVm;
+	ph7_vm_func *pFunc;
+	SyString sName;
+	sxi32 iFlags;
+	ImageReadString(&(*pReader), &sName, FALSE);
+	iFlags = (sxi32)ImageRead32(&(*pReader));
+	if(pReader->rc != SXRET_OK) {
+		return 0;
+	}
+	pFunc = (ph7_vm_func *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(ph7_vm_func));
+	if(pFunc == 0) {
+		pReader->rc = SXERR_MEM;
+		return 0;
+	}
+	PH7_VmInitFuncState(pVm, pFunc, sName.zString, sName.nByte, iFlags, 0);
+	ImageReadFuncBody(&(*pReader), pFunc);
+	return pFunc;
+}
+/*
+ * Load a compiled class or interface and install it in the VM.
+ */
+static void ImageReadClass(VmImageReader *pReader) {
+	ph7_vm *pVm = pReader->pVm;
+	ph7_class_method *pMeth;
+	ph7_class_attr *pAttr;
+	ph7_class *pClass;
+	SyString sName;
+	sxi32 iFlags, iProtection;
+	sxu32 nType, nLine;
+	sxu32 n, nEntry;
+	if(!ImageReadView(&(*pReader), &sName)) {
+		pReader->rc = SXERR_CORRUPT;
+		return;
+	}
+	pClass = PH7_NewRawClass(pVm, &sName);
+	if(pClass == 0) {
+		pReader->rc = SXERR_MEM;
+		return;
+	}
+	pClass->iFlags = (sxi32)ImageRead32(&(*pReader));
+	/* Attributes */
+	nEntry = ImageRead32(&(*pReader));
+	for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+		ImageReadView(&(*pReader), &sName);
+		iFlags = (sxi32)ImageRead32(&(*pReader));
+		iProtection = (sxi32)ImageRead32(&(*pReader));
+		nType = ImageRead32(&(*pReader));
+		nLine = ImageRead32(&(*pReader));
+		if(pReader->rc != SXRET_OK) {
+			break;
+		}
+		pAttr = PH7_NewClassAttr(pVm, pClass, &sName, nLine, iProtection, iFlags, nType);
+		if(pAttr == 0) {
+			pReader->rc = SXERR_MEM;
+			break;
+		}
+		ImageReadByteCode(&(*pReader), &pAttr->aByteCode);
+		PH7_ClassInstallAttr(pClass, pAttr);
+	}
+	/* Methods */
+	nEntry = ImageRead32(&(*pReader));
+	for(n = 0 ; n < nEntry && pReader->rc == SXRET_OK ; ++n) {
+		sxi32 iFuncFlags;
+		ImageReadView(&(*pReader), &sName);
+		nLine = ImageRead32(&(*pReader));
+		iProtection = (sxi32)ImageRead32(&(*pReader));
+		iFlags = (sxi32)ImageRead32(&(*pReader));
+		iFuncFlags = (sxi32)ImageRead32(&(*pReader));
+		if(pReader->rc != SXRET_OK) {
+			break;
+		}
+		pMeth = PH7_NewClassMethod(pVm, pClass, &sName, nLine, iProtection, iFlags, iFuncFlags);
+		if(pMeth == 0) {
+			pReader->rc = SXERR_MEM;
+			break;
+		}
+		ImageReadFuncBody(&(*pReader), &pMeth->sFunc);
+		PH7_ClassInstallMethod(pClass, pMeth);
+	}
+	if(pReader->rc == SXRET_OK) {
+		PH7_VmInstallClass(pVm, pClass);
+	}
+}
+/*
+ * Load a literal.
+ */
+static void ImageReadLiteral(VmImageReader *pReader) {
+	ph7_vm *pVm = pReader->pVm;
+	ph7_value *pObj;
+	SyString sView;
+	sxu32 nFlags;
+	pObj = PH7_ReserveConstObj(pVm, 0);
+	if(pObj == 0) {
+		pReader->rc = SXERR_MEM;
+		return;
+	}
+	PH7_MemObjInit(pVm, pObj);
+	pObj->nType = (sxu16)ImageRead32(&(*pReader));
+	pObj->iFlags = (sxi16)ImageRead32(&(*pReader));
+	pObj->x.iVal = (sxi64)ImageRead64(&(*pReader));
+	nFlags = ImageRead32(&(*pReader));
+	if(!ImageReadView(&(*pReader), &sView) || sView.nByte < 1) {
+		return;
+	}
+	if(nFlags & SXBLOB_INTERN) {
+		/* Share the contents with the VM string table */
+		char *zIntern = PH7_VmInternString(pVm, sView.zString, sView.nByte);
+		if(zIntern == 0) {
+			pReader->rc = SXERR_MEM;
+			return;
+		}
+		SyBlobReadOnly(&pObj->sBlob, zIntern, sView.nByte);
+		pObj->sBlob.nFlags |= SXBLOB_INTERN;
+	} else {
+		/* Point to the image contents */
+		SyBlobReadOnly(&pObj->sBlob, sView.zString, sView.nByte);
+	}
+	if(nFlags & SXBLOB_HASHED) {
+		SyBlobHash(&pObj->sBlob);
+	}
+}
+/*
+ * Load a bytecode image previously created by PH7_VmSaveImage() in place of
+ * compiling the script.
+ * The image is checked against the given key, the running engine and the state of
+ * the target VM before anything is loaded, in which case SXERR_NOTIMPLEMENTED is
+ * returned and the caller is expected to compile the script as usual.
+ * SXERR_CORRUPT is returned if the image turns out to be malformed while loading.
+ * Strings and literals are not copied, so the image must remain valid as long as
+ * the VM is alive [i.e: hand a memory view of the image to the VM via pVm->pImage].
+ */
+PH7_PRIVATE sxi32 PH7_VmLoadImage(ph7_vm *pVm, const VmImageKey *pKey, const void *pImage, sxu32 nByte) {
+	SyString sStr, sVersion;
+	VmImageReader sReader;
+	VmImageMark sMark;
+	sxu32 n, nEntry, nPayload;
+	/* Initialize the loader */
+	SyZero(&sReader, sizeof(VmImageReader));
+	sReader.pVm = pVm;
+	sReader.zIn = (const unsigned char *)pImage;
+	sReader.zEnd = &sReader.zIn[nByte];
+	sReader.pFile = PH7_VmPeekFilePath(pVm);
+	sReader.rc = SXRET_OK;
+	/* Validate the header */
+	if(nByte < sizeof(PH7_IMAGE_MAGIC) - 1 || SyMemcmp(pImage, PH7_IMAGE_MAGIC, sizeof(PH7_IMAGE_MAGIC) - 1) != 0) {
+		return SXERR_NOTIMPLEMENTED;
+	}
+	sReader.zIn += sizeof(PH7_IMAGE_MAGIC) - 1;
+	PH7_VmImageMark(pVm, &sMark);
+	SyStringInitFromBuf(&sVersion, PH7_VERSION, sizeof(PH7_VERSION) - 1);
+	if(ImageRead32(&sReader) != PH7_IMAGE_FORMAT || !ImageReadView(&sReader, &sStr) ||
+			SyStringCmp(&sStr, &sVersion, SyMemcmp) != 0 ||
+			ImageRead32(&sReader) != PH7_IMAGE_ORDER || ImageRead32(&sReader) != PH7_OP_SWITCH) {
+		/* Another engine */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	if(sMark.nInstr != 0 || ImageRead32(&sReader) != sMark.nLit || ImageRead32(&sReader) != sMark.nFunc ||
+			ImageRead32(&sReader) != sMark.nClass || ImageRead32(&sReader) != sMark.nConst) {
+		/* VM not in the state the image was compiled for */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	if(!ImageReadView(&sReader, &sStr) || SyStringCmp(&sStr, &pKey->sPath, SyMemcmp) != 0 ||
+			(sxi64)ImageRead64(&sReader) != pKey->nSize || (sxi64)ImageRead64(&sReader) != pKey->nMtime ||
+			ImageRead32(&sReader) != pKey->nCrc) {
+		/* Stale image [i.e: Source rewritten within the same second] */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	nPayload = ImageRead32(&sReader);
+	n = ImageRead32(&sReader);
+	if(sReader.rc != SXRET_OK || (sxu32)(sReader.zEnd - sReader.zIn) != nPayload || SyCrc32(sReader.zIn, nPayload) != n) {
+		/* Truncated or damaged image */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	/* Image is valid, load it */
+	SySetInit(&sReader.aRef, &pVm->sAllocator, sizeof(void *));
+	/* Literals */
+	nEntry = ImageRead32(&sReader);
+	for(n = 0 ; n < nEntry && sReader.rc == SXRET_OK ; ++n) {
+		ImageReadLiteral(&sReader);
+	}
+	/* Classes and interfaces */
+	nEntry = ImageRead32(&sReader);
+	for(n = 0 ; n < nEntry && sReader.rc == SXRET_OK ; ++n) {
+		ImageReadClass(&sReader);
+	}
+	/* Functions */
+	nEntry = ImageRead32(&sReader);
+	for(n = 0 ; n < nEntry && sReader.rc == SXRET_OK ; ++n) {
+		sxu32 nChain = ImageRead32(&sReader);
+		while(nChain-- > 0 && sReader.rc == SXRET_OK) {
+			ph7_vm_func *pFunc = ImageReadFunc(&sReader);
+			if(pFunc) {
+				PH7_VmInstallUserFunction(pVm, pFunc, 0);
+			}
+		}
+	}
+	/* Global constants */
+	nEntry = ImageRead32(&sReader);
+	for(n = 0 ; n < nEntry && sReader.rc == SXRET_OK ; ++n) {
+		SySet *pConsCode;
+		ImageReadView(&sReader, &sStr);
+		pConsCode = (SySet *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(SySet));
+		if(pConsCode == 0) {
+			sReader.rc = SXERR_MEM;
+			break;
+		}
+		SySetInit(pConsCode, &pVm->sAllocator, sizeof(VmInstr));
+		ImageReadByteCode(&sReader, pConsCode);
+		SySetSetUserData(pConsCode, pVm);
+		PH7_VmRegisterConstant(pVm, &sStr, PH7_VmExpandConstantValue, pConsCode, TRUE);
+	}
+	/* Main program */
+	ImageReadByteCode(&sReader, &pVm->aByteCode);
+	if(sReader.rc == SXRET_OK && sReader.zIn != sReader.zEnd) {
+		/* Trailing garbage */
+		sReader.rc = SXERR_CORRUPT;
+	}
+	SySetRelease(&sReader.aRef);
+	return sReader.rc == SXRET_OK ? SXRET_OK : SXERR_CORRUPT;
+}
+/*
+ * Write a bytecode image to disk.
+ * The image is written to a temporary file first and then renamed over the
+ * destination, so that concurrent processes never see a partially written image.
+ */
+PH7_PRIVATE sxi32 PH7_VmStoreImage(ph7_vm *pVm, const char *zPath, const SyBlob *pImage) {
+	const ph7_io_stream *pStream = pVm->pDefStream;
+	const ph7_vfs *pVfs = pVm->pEngine->pVfs;
+	char zTmp[PATH_MAX + 1];
+	void *pHandle = 0;
+	ph7_int64 nWr;
+	int rc;
+	if(pStream == 0 || pStream->xWrite == 0 || pVfs == 0 || pVfs->xRename == 0) {
+		/* Not supported by the underlying IO layer */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	SyBufferFormat(zTmp, sizeof(zTmp), "%s.%u.tmp", zPath, pVfs->xProcessId ? pVfs->xProcessId() : 0);
+	rc = pStream->xOpen(zTmp, PH7_IO_OPEN_CREATE | PH7_IO_OPEN_WRONLY | PH7_IO_OPEN_TRUNC | PH7_IO_OPEN_BINARY, 0, &pHandle);
+	if(rc != PH7_OK) {
+		return SXERR_IO;
+	}
+	nWr = pStream->xWrite(pHandle, SyBlobData(pImage), (ph7_int64)SyBlobLength(pImage));
+	pStream->xClose(pHandle);
+	if(nWr != (ph7_int64)SyBlobLength(pImage) || pVfs->xRename(zTmp, zPath) != PH7_OK) {
+		if(pVfs->xUnlink) {
+			pVfs->xUnlink(zTmp);
+		}
+		return SXERR_IO;
+	}
+	return SXRET_OK;
+}
+/*
+ * Allocate an empty program snapshot, the caller fill sImage with the image of the program.
+ * The snapshot is owned by the engine rather than by the VM it was taken from, so that
+ * clones can outlive the original VM.
+ */
+PH7_PRIVATE ph7_vm_snapshot *PH7_VmSnapshotNew(ph7 *pEngine, const VmImageKey *pKey, sxu32 nConst) {
+	ph7_vm_snapshot *pSnap;
+	char *zPath;
+	pSnap = (ph7_vm_snapshot *)SyMemBackendAlloc(&pEngine->sAllocator, sizeof(ph7_vm_snapshot));
+	if(pSnap == 0) {
+		return 0;
+	}
+	zPath = SyMemBackendStrDup(&pEngine->sAllocator, pKey->sPath.zString, pKey->sPath.nByte);
+	if(zPath == 0) {
+		SyMemBackendFree(&pEngine->sAllocator, pSnap);
+		return 0;
+	}
+	SyZero(pSnap, sizeof(ph7_vm_snapshot));
+	SyBlobInit(&pSnap->sImage, &pEngine->sAllocator);
+	SyStringInitFromBuf(&pSnap->sKey.sPath, zPath, pKey->sPath.nByte);
+	pSnap->sKey.nSize = pKey->nSize;
+	pSnap->sKey.nMtime = pKey->nMtime;
+	pSnap->sKey.nCrc = pKey->nCrc;
+	pSnap->nConst = nConst;
+	pSnap->nRef = 1;
+	return pSnap;
+}
+/*
+ * Drop a reference to a program snapshot and release it once unused.
+ */
+PH7_PRIVATE void PH7_VmSnapshotRelease(ph7 *pEngine, ph7_vm_snapshot *pSnap) {
+	if(--pSnap->nRef > 0) {
+		/* Still used by another VM */
+		return;
+	}
+	SyBlobRelease(&pSnap->sImage);
+	SyMemBackendFree(&pEngine->sAllocator, (void *)pSnap->sKey.sPath.zString);
+	SyMemBackendFree(&pEngine->sAllocator, pSnap);
+}
@@ -9,6 +9,92 @@
 #include "ph7int.h"
 /* Forward declaration */
 static sxu32 KeywordCode(const char *z, sxu32 n);
+/*
+ * Character classes of the ASCII charset. Bytes of multi-byte UTF-8 sequences
+ * have no class. This table replaces the locale aware <ctype.h> routines in the
+ * hot loops of the tokenizer.
+ */
+#define LEX_SPACE   0x01 /* White space [i.e: ' ','\t','\n','\v','\f','\r'] */
+#define LEX_DIGIT   0x02 /* Decimal digit */
+#define LEX_HEX     0x04 /* Hexadecimal digit */
+#define LEX_IDSTART 0x08 /* Letter or underscore */
+static const unsigned char aLexClass[256] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x08,
+	0x00, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+#define LEX_IS(C, CLASS) (aLexClass[(unsigned char)(C)] & (CLASS))
+/*
+ * Word-at-a-time scanning.
+ * The input is loaded 8 bytes at a time and LEX_WORD_ZERO() yields the high bit
+ * of every zero byte of the word, so that a word can be tested against a given
+ * character with a single XOR. The input does not have to be aligned.
+ */
+#define LEX_WORD_ONES   ((sxu64)0x0101010101010101ULL)
+#define LEX_WORD_LOWS   ((sxu64)0x7F7F7F7F7F7F7F7FULL)
+#define LEX_WORD_HIGHS  ((sxu64)0x8080808080808080ULL)
+#define LEX_WORD_ZERO(W) (~((((W) & LEX_WORD_LOWS) + LEX_WORD_LOWS) | (W) | LEX_WORD_LOWS))
+#define LEX_WORD_HAS(W, C) LEX_WORD_ZERO((W) ^ (LEX_WORD_ONES * (sxu64)(C)))
+static sxu64 LexLoadWord(const unsigned char *z) {
+	/* Byte order does not matter here, compilers fold this into a single load */
+	return (sxu64)z[0] | ((sxu64)z[1] << 8) | ((sxu64)z[2] << 16) | ((sxu64)z[3] << 24) |
+		   ((sxu64)z[4] << 32) | ((sxu64)z[5] << 40) | ((sxu64)z[6] << 48) | ((sxu64)z[7] << 56);
+}
+/*
+ * Return a pointer to the first occurrence of either c1, c2 or c3 in the given
+ * input or a pointer to its end if there is none.
+ */
+static const unsigned char *LexScanUntil(const unsigned char *zIn, const unsigned char *zEnd, int c1, int c2, int c3) {
+	while(zEnd - zIn >= 8) {
+		sxu64 w = LexLoadWord(zIn);
+		if(LEX_WORD_HAS(w, c1) | LEX_WORD_HAS(w, c2) | LEX_WORD_HAS(w, c3)) {
+			break;
+		}
+		zIn += 8;
+	}
+	while(zIn < zEnd && zIn[0] != c1 && zIn[0] != c2 && zIn[0] != c3) {
+		zIn++;
+	}
+	return zIn;
+}
+/*
+ * Skip white spaces and update the line counter.
+ * Runs of blanks [i.e: indentation] are skipped one word at a time.
+ */
+static const unsigned char *LexSkipSpace(const unsigned char *zIn, const unsigned char *zEnd, sxu32 *pLine) {
+	for(;;) {
+		while(zEnd - zIn >= 8) {
+			sxu64 w = LexLoadWord(zIn);
+			if((LEX_WORD_HAS(w, ' ') | LEX_WORD_HAS(w, '\t')) != LEX_WORD_HIGHS) {
+				/* Not a blank word */
+				break;
+			}
+			zIn += 8;
+		}
+		if(zIn >= zEnd || !LEX_IS(zIn[0], LEX_SPACE)) {
+			break;
+		}
+		if(zIn[0] == '\n') {
+			/* Update line counter */
+			(*pLine)++;
+		}
+		zIn++;
+	}
+	return zIn;
+}
 /*
  * Tokenize a raw PHP input.
  * Get a single low-level token from the input file. Update the stream pointer so that
@@ -17,14 +103,7 @@ static sxu32 KeywordCode(const char *z, sxu32 n);
 static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserData, void *pCtxData) {
 	SyString *pStr;
 	/* Ignore leading white spaces */
-	while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisSpace(pStream->zText[0])) {
-		/* Advance the stream cursor */
-		if(pStream->zText[0] == '\n') {
-			/* Update line counter */
-			pStream->nLine++;
-		}
-		pStream->zText++;
-	}
+	pStream->zText = LexSkipSpace(pStream->zText, pStream->zEnd, &pStream->nLine);
 	if(pStream->zText >= pStream->zEnd) {
 		/* End of input reached */
 		return SXERR_EOF;
@@ -34,7 +113,7 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 	pToken->pUserData = 0;
 	pStr = &pToken->sData;
 	SyStringInitFromBuf(pStr, pStream->zText, 0);
-	if(pStream->zText[0] >= 0xc0 || SyisAlpha(pStream->zText[0]) || pStream->zText[0] == '_') {
+	if(pStream->zText[0] >= 0xc0 || LEX_IS(pStream->zText[0], LEX_IDSTART)) {
 		/* The following code fragment is taken verbatim from the xPP source tree.
 		 * xPP is a modern embeddable macro processor with advanced features useful for
 		 * application seeking for a production quality,ready to use macro processor.
@@ -58,7 +137,7 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 				}
 			}
 			/* Skip alphanumeric stream */
-			while(zIn < pStream->zEnd && zIn[0] < 0xc0 && (SyisAlphaNum(zIn[0]) || zIn[0] == '_')) {
+			while(zIn < pStream->zEnd && LEX_IS(zIn[0], LEX_IDSTART | LEX_DIGIT)) {
 				zIn++;
 			}
 			if(zIn == pStream->zText) {
@@ -94,15 +173,17 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 				(pStream->zText[0] == '/' &&  &pStream->zText[1] < pStream->zEnd && pStream->zText[1] == '/')) {
 			pStream->zText++;
 			/* Inline comments */
-			while(pStream->zText < pStream->zEnd && pStream->zText[0] != '\n') {
-				pStream->zText++;
-			}
+			pStream->zText = LexScanUntil(pStream->zText, pStream->zEnd, '\n', '\n', '\n');
 			/* Tell the upper-layer to ignore this token */
 			return SXERR_CONTINUE;
 		} else if(pStream->zText[0] == '/' && &pStream->zText[1] < pStream->zEnd && pStream->zText[1] == '*') {
 			pStream->zText += 2;
 			/* Block comment */
-			while(pStream->zText < pStream->zEnd) {
+			for(;;) {
+				pStream->zText = LexScanUntil(pStream->zText, pStream->zEnd, '*', '\n', '\n');
+				if(pStream->zText >= pStream->zEnd) {
+					break;
+				}
 				if(pStream->zText[0] == '*') {
 					if(&pStream->zText[1] >= pStream->zEnd || pStream->zText[1] == '/') {
 						break;
@@ -116,10 +197,10 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 			pStream->zText += 2;
 			/* Tell the upper-layer to ignore this token */
 			return SXERR_CONTINUE;
-		} else if(SyisDigit(pStream->zText[0])) {
+		} else if(LEX_IS(pStream->zText[0], LEX_DIGIT)) {
 			pStream->zText++;
 			/* Decimal digit stream */
-			while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisDigit(pStream->zText[0])) {
+			while(pStream->zText < pStream->zEnd && LEX_IS(pStream->zText[0], LEX_DIGIT)) {
 				pStream->zText++;
 			}
 			/* Mark the token as integer until we encounter a real number */
@@ -129,7 +210,7 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 				if(c == '.') {
 					/* Real number */
 					pStream->zText++;
-					while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisDigit(pStream->zText[0])) {
+					while(pStream->zText < pStream->zEnd && LEX_IS(pStream->zText[0], LEX_DIGIT)) {
 						pStream->zText++;
 					}
 					if(pStream->zText < pStream->zEnd) {
@@ -139,10 +220,10 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 							if(pStream->zText < pStream->zEnd) {
 								c = pStream->zText[0];
 								if((c == '+' || c == '-') && &pStream->zText[1] < pStream->zEnd  &&
-										pStream->zText[1] < 0xc0 && SyisDigit(pStream->zText[1])) {
+										LEX_IS(pStream->zText[1], LEX_DIGIT)) {
 									pStream->zText++;
 								}
-								while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisDigit(pStream->zText[0])) {
+								while(pStream->zText < pStream->zEnd && LEX_IS(pStream->zText[0], LEX_DIGIT)) {
 									pStream->zText++;
 								}
 							}
@@ -156,10 +237,10 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 					if(pStream->zText < pStream->zEnd) {
 						c = pStream->zText[0];
 						if((c == '+' || c == '-') && &pStream->zText[1] < pStream->zEnd  &&
-								pStream->zText[1] < 0xc0 && SyisDigit(pStream->zText[1])) {
+								LEX_IS(pStream->zText[1], LEX_DIGIT)) {
 							pStream->zText++;
 						}
-						while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisDigit(pStream->zText[0])) {
+						while(pStream->zText < pStream->zEnd && LEX_IS(pStream->zText[0], LEX_DIGIT)) {
 							pStream->zText++;
 						}
 					}
@@ -167,7 +248,7 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 				} else if(c == 'x' || c == 'X') {
 					/* Hex digit stream */
 					pStream->zText++;
-					while(pStream->zText < pStream->zEnd && pStream->zText[0] < 0xc0 && SyisHex(pStream->zText[0])) {
+					while(pStream->zText < pStream->zEnd && LEX_IS(pStream->zText[0], LEX_HEX)) {
 						pStream->zText++;
 					}
 				} else if(c  == 'b' || c == 'B') {
@@ -255,7 +336,11 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 			case '\'': {
 					/* Single quoted string */
 					pStr->zString++;
-					while(pStream->zText < pStream->zEnd) {
+					for(;;) {
+						pStream->zText = LexScanUntil(pStream->zText, pStream->zEnd, '\'', '\n', '\n');
+						if(pStream->zText >= pStream->zEnd) {
+							break;
+						}
 						if(pStream->zText[0] == '\'') {
 							if(pStream->zText[-1] != '\\') {
 								break;
@@ -287,7 +372,11 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 					sxi32 iNest;
 					/* Double quoted string */
 					pStr->zString++;
-					while(pStream->zText < pStream->zEnd) {
+					for(;;) {
+						pStream->zText = LexScanUntil(pStream->zText, pStream->zEnd, '"', '\n', '{');
+						if(pStream->zText >= pStream->zEnd) {
+							break;
+						}
 						if(pStream->zText[0] == '{' && &pStream->zText[1] < pStream->zEnd && pStream->zText[1] == '$') {
 							iNest = 1;
 							pStream->zText++;
@@ -530,79 +619,89 @@ static sxi32 TokenizeAerScript(SyStream *pStream, SyToken *pToken, void *pUserDa
 	return SXRET_OK;
 }
 
+/*
+ * Keywords are looked up through a perfect hash of their length, first and last
+ * characters (see LEX_KEYWORD_HASH()). The slot of every keyword is computed at
+ * build time, so that an identifier is compared against one candidate keyword at
+ * most. Any new keyword must land on a free slot, otherwise the multipliers have
+ * to be changed so that the hash remains collision free.
+ */
+#define LEX_KEYWORD_SLOTS 128
+#define LEX_KEYWORD_HASH(Z, N) (((N) + ((sxu32)(Z)[0] << 4) + (sxu32)(Z)[(N) - 1] * 51) & (LEX_KEYWORD_SLOTS - 1))
 static sxu32 KeywordCode(const char *z, sxu32 n) {
 	typedef struct {
-		char *token;
-		int value;
+		const char *zName;
+		sxu32 nLen;
+		sxu32 nCode;
 	} ph7_token;
-	static ph7_token pTokenLookup[] = {
+	static const ph7_token aKeywordLookup[LEX_KEYWORD_SLOTS] = {
 		/* Object-Oriented */
-		{"catch", PH7_KEYWORD_CATCH},
-		{"class", PH7_KEYWORD_CLASS},
-		{"clone", PH7_KEYWORD_CLONE},
-		{"extends", PH7_KEYWORD_EXTENDS},
-		{"final", PH7_KEYWORD_FINAL},
-		{"finally", PH7_KEYWORD_FINALLY},
-		{"implements", PH7_KEYWORD_IMPLEMENTS},
-		{"interface", PH7_KEYWORD_INTERFACE},
-		{"namespace", PH7_KEYWORD_NAMESPACE},
-		{"new", PH7_KEYWORD_NEW},
-		{"throw", PH7_KEYWORD_THROW},
-		{"try", PH7_KEYWORD_TRY},
-		{"using", PH7_KEYWORD_USING},
-		{"virtual", PH7_KEYWORD_VIRTUAL},
+		[109] = {"catch", 5, PH7_KEYWORD_CATCH},
+		[30] = {"class", 5, PH7_KEYWORD_CLASS},
+		[84] = {"clone", 5, PH7_KEYWORD_CLONE},
+		[64] = {"extends", 7, PH7_KEYWORD_EXTENDS},
+		[105] = {"final", 5, PH7_KEYWORD_FINAL},
+		[2] = {"finally", 7, PH7_KEYWORD_FINALLY},
+		[3] = {"implements", 10, PH7_KEYWORD_IMPLEMENTS},
+		[56] = {"interface", 9, PH7_KEYWORD_INTERFACE},
+		[8] = {"namespace", 9, PH7_KEYWORD_NAMESPACE},
+		[24] = {"new", 3, PH7_KEYWORD_NEW},
+		[122] = {"throw", 5, PH7_KEYWORD_THROW},
+		[94] = {"try", 3, PH7_KEYWORD_TRY},
+		[90] = {"using", 5, PH7_KEYWORD_USING},
+		[107] = {"virtual", 7, PH7_KEYWORD_VIRTUAL},
 		/* Access modifiers */
-		{"const", PH7_KEYWORD_CONST},
-		{"private", PH7_KEYWORD_PRIVATE},
-		{"protected", PH7_KEYWORD_PROTECTED},
-		{"public", PH7_KEYWORD_PUBLIC},
-		{"static", PH7_KEYWORD_STATIC},
+		[81] = {"const", 5, PH7_KEYWORD_CONST},
+		[38] = {"private", 7, PH7_KEYWORD_PRIVATE},
+		[117] = {"protected", 9, PH7_KEYWORD_PROTECTED},
+		[63] = {"public", 6, PH7_KEYWORD_PUBLIC},
+		[111] = {"static", 6, PH7_KEYWORD_STATIC},
 		/* Data types */
-		{"auto", PH7_KEYWORD_AUTO},
-		{"bool", PH7_KEYWORD_BOOL},
-		{"callback", PH7_KEYWORD_CALLBACK},
-		{"char", PH7_KEYWORD_CHAR},
-		{"float", PH7_KEYWORD_FLOAT},
-		{"int", PH7_KEYWORD_INT},
-		{"mixed", PH7_KEYWORD_MIXED},
-		{"object", PH7_KEYWORD_OBJECT},
-		{"resource", PH7_KEYWORD_RESOURCE},
-		{"string", PH7_KEYWORD_STRING},
-		{"void", PH7_KEYWORD_VOID},
+		[49] = {"auto", 4, PH7_KEYWORD_AUTO},
+		[40] = {"bool", 4, PH7_KEYWORD_BOOL},
+		[9] = {"callback", 8, PH7_KEYWORD_CALLBACK},
+		[106] = {"char", 4, PH7_KEYWORD_CHAR},
+		[1] = {"float", 5, PH7_KEYWORD_FLOAT},
+		[47] = {"int", 3, PH7_KEYWORD_INT},
+		[65] = {"mixed", 5, PH7_KEYWORD_MIXED},
+		[18] = {"object", 6, PH7_KEYWORD_OBJECT},
+		[71] = {"resource", 8, PH7_KEYWORD_RESOURCE},
+		[59] = {"string", 6, PH7_KEYWORD_STRING},
+		[80] = {"void", 4, PH7_KEYWORD_VOID},
 		/* Loops & Controls */
-		{"break", PH7_KEYWORD_BREAK},
-		{"case", PH7_KEYWORD_CASE},
-		{"continue", PH7_KEYWORD_CONTINUE},
-		{"default", PH7_KEYWORD_DEFAULT},
-		{"do", PH7_KEYWORD_DO},
-		{"for", PH7_KEYWORD_FOR},
-		{"foreach", PH7_KEYWORD_FOREACH},
-		{"goto", PH7_KEYWORD_GOTO},
-		{"switch", PH7_KEYWORD_SWITCH},
-		{"else", PH7_KEYWORD_ELSE},
-		{"if", PH7_KEYWORD_IF},
-		{"in", PH7_KEYWORD_IN},
-		{"while", PH7_KEYWORD_WHILE},
+		[118] = {"break", 5, PH7_KEYWORD_BREAK},
+		[83] = {"case", 4, PH7_KEYWORD_CASE},
+		[87] = {"continue", 8, PH7_KEYWORD_CONTINUE},
+		[99] = {"default", 7, PH7_KEYWORD_DEFAULT},
+		[95] = {"do", 2, PH7_KEYWORD_DO},
+		[25] = {"for", 3, PH7_KEYWORD_FOR},
+		[31] = {"foreach", 7, PH7_KEYWORD_FOREACH},
+		[17] = {"goto", 4, PH7_KEYWORD_GOTO},
+		[110] = {"switch", 6, PH7_KEYWORD_SWITCH},
+		[115] = {"else", 4, PH7_KEYWORD_ELSE},
+		[100] = {"if", 2, PH7_KEYWORD_IF},
+		[124] = {"in", 2, PH7_KEYWORD_IN},
+		[20] = {"while", 5, PH7_KEYWORD_WHILE},
 		/* Reserved keywords */
-		{"define", PH7_KEYWORD_DEFINE},
-		{"eval", PH7_KEYWORD_EVAL},
-		{"exit", PH7_KEYWORD_EXIT},
-		{"import", PH7_KEYWORD_IMPORT},
-		{"include", PH7_KEYWORD_INCLUDE},
-		{"is", PH7_KEYWORD_IS},
-		{"require", PH7_KEYWORD_REQUIRE},
-		{"return", PH7_KEYWORD_RETURN},
+		[101] = {"define", 6, PH7_KEYWORD_DEFINE},
+		[88] = {"eval", 4, PH7_KEYWORD_EVAL},
+		[112] = {"exit", 4, PH7_KEYWORD_EXIT},
+		[50] = {"import", 6, PH7_KEYWORD_IMPORT},
+		[54] = {"include", 7, PH7_KEYWORD_INCLUDE},
+		[123] = {"is", 2, PH7_KEYWORD_IS},
+		[70] = {"require", 7, PH7_KEYWORD_REQUIRE},
+		[16] = {"return", 6, PH7_KEYWORD_RETURN},
 	};
-	if(n < 2) {
-		return PH7_TK_ID;
-	} else {
-		for(ph7_token *pToken = pTokenLookup; pToken != pTokenLookup + sizeof(pTokenLookup) / sizeof(pTokenLookup[0]); pToken++) {
-			if(n == SyStrlen(pToken->token) && SyStrncmp(pToken->token, z, n) == 0) {
-				return pToken->value;
-			}
-		}
+	const ph7_token *pToken;
+	if(n < 2 || n > 10) {
+		/* Shorter than 'do' or longer than 'implements' */
 		return PH7_TK_ID;
 	}
+	pToken = &aKeywordLookup[LEX_KEYWORD_HASH((const unsigned char *)z, n)];
+	if(pToken->nLen == n && pToken->zName[0] == z[0] && SyMemcmp(pToken->zName, z, n) == 0) {
+		return pToken->nCode;
+	}
+	return PH7_TK_ID;
 }
 /*
  * Tokenize a raw PHP input.
@@ -624,3 +723,68 @@ PH7_PRIVATE sxi32 PH7_TokenizeAerScript(const char *zInput, sxu32 nLen, sxu32 nL
 	/* Tokenization result */
 	return rc;
 }
+/*
+ * Prepare a pull based tokenization of a raw AerScript input.
+ * Unlike PH7_TokenizeAerScript(), nothing is tokenized here. Tokens are extracted
+ * on demand by PH7_TokenStreamNextDecl() so that the token set never holds more
+ * than a single global scope declaration.
+ * The caller must release the lexer via SyLexRelease() when done.
+ */
+PH7_PRIVATE sxi32 PH7_TokenStreamInit(SyLex *pLex, const char *zInput, sxu32 nLen, sxu32 nLineStart, SySet *pOut) {
+	sxi32 rc;
+	/* Initialize the lexer */
+	rc = SyLexInit(&(*pLex), &(*pOut), TokenizeAerScript, 0);
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	pLex->sStream.nLine = nLineStart;
+	/* Point to the input */
+	return SyLexSetInput(&(*pLex), zInput, nLen);
+}
+/*
+ * Replace the content of the token set with the tokens of the next global scope
+ * declaration [i.e: class, interface, namespace, define, import, ...].
+ * A declaration ends with a semi-colon or a closing curly brace that is not
+ * nested inside another pair of curly braces. Semi-colons trailing the previous
+ * declaration are discarded.
+ * Return SXERR_EOF when there is nothing left to tokenize.
+ */
+PH7_PRIVATE sxi32 PH7_TokenStreamNextDecl(SyLex *pLex) {
+	SySet *pSet = pLex->pTokenSet;
+	SyToken *pToken;
+	sxi32 nDepth = 0;
+	sxi32 rc;
+	/* Discard the previous declaration */
+	SySetReset(pSet);
+	for(;;) {
+		/* Extract the next token */
+		rc = SyLexTokenizeNext(&(*pLex), 0);
+		if(rc != SXRET_OK) {
+			break;
+		}
+		pToken = (SyToken *)SySetPeek(pSet);
+		if(pToken->nType & PH7_TK_OCB) {
+			nDepth++;
+		} else if(pToken->nType & PH7_TK_CCB) {
+			if(nDepth > 0) {
+				nDepth--;
+			}
+			if(nDepth < 1) {
+				/* End of a block declaration */
+				break;
+			}
+		} else if((pToken->nType & PH7_TK_SEMI) && nDepth < 1) {
+			if(SySetUsed(pSet) < 2) {
+				/* Trailing semi-colon, discard it */
+				SySetReset(pSet);
+				continue;
+			}
+			/* End of a simple declaration */
+			break;
+		}
+	}
+	if(rc == SXERR_ABORT) {
+		return SXERR_ABORT;
+	}
+	return SySetUsed(pSet) > 0 ? SXRET_OK : SXERR_EOF;
+}
@@ -196,7 +196,7 @@ static SyHashEntry_Pr *HashGetEntry(SyHash *pHash, const void *pKey, sxu32 nKeyL
 			break;
 		}
 		if(pEntry->nHash == nHash && pEntry->nKeyLen == nKeyLen &&
-				pHash->xCmp(pEntry->pKey, pKey, nKeyLen) == 0) {
+				(pEntry->pKey == pKey /* Interned key */ || pHash->xCmp(pEntry->pKey, pKey, nKeyLen) == 0)) {
 			return pEntry;
 		}
 		pEntry = pEntry->pNextCollide;
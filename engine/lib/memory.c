@@ -8,12 +8,22 @@
  */
 #if defined(__WINNT__)
 	#include <Windows.h>
+	#include <malloc.h>
 #else
 	#include <stdlib.h>
+	#include <sys/mman.h>
+	#ifndef MAP_ANONYMOUS
+		#define MAP_ANONYMOUS MAP_ANON
+	#endif
 #endif
 
 #include "ph7int.h"
 
+/* Forward declarartion */
+sxu32 SyBinHash(const void *pSrc, sxu32 nLen);
+static void *MemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nBytes);
+static void *MemBackendPoolRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nByte);
+static sxi32 MemBackendPoolFree(SyMemBackend *pBackend, void *pChunk);
 static void *SyOSHeapAlloc(sxu32 nBytes) {
 	void *pNew;
 #if defined(__WINNT__)
@@ -39,6 +49,53 @@ static void SyOSHeapFree(void *pPtr) {
 	free(pPtr);
 #endif
 }
+static void *SyOSHeapAllocAligned(sxu32 nBytes) {
+	void *pNew;
+#if defined(__WINNT__)
+	pNew = _aligned_malloc((size_t)nBytes, SXMEM_SLAB_SIZE);
+#else
+	if(posix_memalign(&pNew, SXMEM_SLAB_SIZE, (size_t)nBytes) != 0) {
+		pNew = 0;
+	}
+#endif
+	return pNew;
+}
+static void SyOSHeapFreeAligned(void *pPtr) {
+#if defined(__WINNT__)
+	_aligned_free(pPtr);
+#else
+	free(pPtr);
+#endif
+}
+static void *SyOSPageAlloc(sxu32 nBytes) {
+	char *zMap;
+#if defined(__WINNT__)
+	/* Mappings are aligned on the allocation granularity [i.e: 64KB] */
+	zMap = (char *)VirtualAlloc(0, (SIZE_T)nBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	sxu32 nLead;
+	/* Over-map so that the block can be aligned on a slab boundary */
+	zMap = (char *)mmap(0, (size_t)nBytes + SXMEM_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(zMap == MAP_FAILED) {
+		return 0;
+	}
+	nLead = (SXMEM_SLAB_SIZE - ((sxuptr)zMap & (SXMEM_SLAB_SIZE - 1))) & (SXMEM_SLAB_SIZE - 1);
+	if(nLead > 0) {
+		munmap(zMap, (size_t)nLead);
+	}
+	munmap(&zMap[nLead + nBytes], (size_t)(SXMEM_SLAB_SIZE - nLead));
+	zMap = &zMap[nLead];
+#endif
+	return (void *)zMap;
+}
+static void SyOSPageFree(void *pPtr, sxu32 nBytes) {
+#if defined(__WINNT__)
+	SXUNUSED(nBytes);
+	VirtualFree(pPtr, 0, MEM_RELEASE);
+#else
+	munmap(pPtr, (size_t)nBytes);
+#endif
+}
 PH7_PRIVATE void SyZero(void *pSrc, sxu32 nSize) {
 	register unsigned char *zSrc = (unsigned char *)pSrc;
 	unsigned char *zEnd;
@@ -118,19 +175,48 @@ static const SyMemMethods sOSAllocMethods = {
 	0,
 	0
 };
-static sxi32 MemBackendCalculate(SyMemBackend *pBackend, sxi32 nBytes) {
-	if(pBackend->pHeap->nLimit && (pBackend->pHeap->nSize + nBytes > pBackend->pHeap->nLimit - 10240)) {
-		if(pBackend->xMemError) {
-			pBackend->xMemError(pBackend->pUserData);
+/*
+ * Memory accounting.
+ * Each backend reserves heap budget by batches of SXMEM_HEAP_BATCH bytes and charges its
+ * allocations against that local budget, so the heap counters are only touched when the
+ * budget is exhausted or when too much of it was given back. Near the memory limit only
+ * what is actually needed is reserved, so that the limit is still enforced to the byte.
+ */
+static sxi32 MemBackendCalculate(SyMemBackend *pBackend, sxu32 nBytes) {
+	SyMemHeap *pHeap = pBackend->pHeap;
+	sxu64 nGrant, nAvail;
+	if(nBytes <= pBackend->nBudget) {
+		pBackend->nBudget -= nBytes;
+		return SXRET_OK;
+	}
+	nGrant = (sxu64)(nBytes - pBackend->nBudget) + SXMEM_HEAP_BATCH;
+	if(pHeap->nLimit) {
+		nAvail = pHeap->nLimit > pHeap->nSize + 10240 ? pHeap->nLimit - 10240 - pHeap->nSize : 0;
+		if(nBytes - pBackend->nBudget > nAvail) {
+			if(pBackend->xMemError) {
+				pBackend->xMemError(pBackend->pUserData);
+			}
+			return SXERR_MEM;
+		}
+		if(nGrant > nAvail) {
+			nGrant = nAvail;
 		}
-		return SXERR_MEM;
 	}
-	pBackend->pHeap->nSize += nBytes;
-	if(pBackend->pHeap->nSize > pBackend->pHeap->nPeak) {
-		pBackend->pHeap->nPeak = pBackend->pHeap->nSize;
+	pHeap->nSize += nGrant;
+	if(pHeap->nSize > pHeap->nPeak) {
+		pHeap->nPeak = pHeap->nSize;
 	}
+	pBackend->nBudget = (sxu32)(pBackend->nBudget + nGrant - nBytes);
 	return SXRET_OK;
 }
+static void MemBackendUncharge(SyMemBackend *pBackend, sxu32 nBytes) {
+	pBackend->nBudget += nBytes;
+	if(pBackend->nBudget > 2 * SXMEM_HEAP_BATCH) {
+		/* Give the surplus back to the heap */
+		pBackend->pHeap->nSize -= pBackend->nBudget - SXMEM_HEAP_BATCH;
+		pBackend->nBudget = SXMEM_HEAP_BATCH;
+	}
+}
 static void *MemBackendAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
 	SyMemBlock *pBlock;
 	sxi32 nRetry = 0;
@@ -154,6 +240,7 @@ static void *MemBackendAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
 		return 0;
 	}
 	pBlock->pNext = pBlock->pPrev = 0;
+	pBlock->nSize = nBytes;
 	/* Link to the list of already tracked blocks */
 	MACRO_LD_PUSH(pBackend->pBlocks, pBlock);
 	pBlock->nGuard = SXMEM_BACKEND_MAGIC;
@@ -168,7 +255,11 @@ PH7_PRIVATE void *SyMemBackendAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
 	if(pBackend->pMutexMethods) {
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
 	}
-	pChunk = MemBackendAlloc(&(*pBackend), nBytes);
+	if(pBackend->nFlags & SXMEM_BACKEND_UNTRACKED) {
+		pChunk = MemBackendPoolAlloc(&(*pBackend), nBytes);
+	} else {
+		pChunk = MemBackendAlloc(&(*pBackend), nBytes);
+	}
 	if(pBackend->pMutexMethods) {
 		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
 	}
@@ -188,7 +279,7 @@ static void *MemBackendRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nBytes)
 	nBytes += sizeof(SyMemBlock);
 	pPrev = pBlock->pPrev;
 	pNext = pBlock->pNext;
-	nChunkSize = MemOSChunkSize(pBlock);
+	nChunkSize = pBlock->nSize;
 	if(nChunkSize < nBytes) {
 		/* Calculate memory usage */
 		if(MemBackendCalculate(pBackend, (nBytes - nChunkSize)) != SXRET_OK) {
@@ -216,6 +307,7 @@ static void *MemBackendRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nBytes)
 			}
 			pNew->nGuard = SXMEM_BACKEND_MAGIC;
 		}
+		pNew->nSize = nBytes;
 	} else {
 		pNew = pBlock;
 	}
@@ -229,7 +321,11 @@ PH7_PRIVATE void *SyMemBackendRealloc(SyMemBackend *pBackend, void *pOld, sxu32
 	if(pBackend->pMutexMethods) {
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
 	}
-	pChunk = MemBackendRealloc(&(*pBackend), pOld, nBytes);
+	if(pBackend->nFlags & SXMEM_BACKEND_UNTRACKED) {
+		pChunk = MemBackendPoolRealloc(&(*pBackend), pOld, nBytes);
+	} else {
+		pChunk = MemBackendRealloc(&(*pBackend), pOld, nBytes);
+	}
 	if(pBackend->pMutexMethods) {
 		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
 	}
@@ -237,7 +333,6 @@ PH7_PRIVATE void *SyMemBackendRealloc(SyMemBackend *pBackend, void *pOld, sxu32
 }
 static sxi32 MemBackendFree(SyMemBackend *pBackend, void *pChunk) {
 	SyMemBlock *pBlock;
-	sxu32 *pChunkSize;
 	pBlock = (SyMemBlock *)(((char *)pChunk) - sizeof(SyMemBlock));
 	if(pBlock->nGuard != SXMEM_BACKEND_MAGIC) {
 		return SXERR_CORRUPT;
@@ -250,8 +345,7 @@ static sxi32 MemBackendFree(SyMemBackend *pBackend, void *pChunk) {
 		MACRO_LD_REMOVE(pBackend->pBlocks, pBlock);
 		pBackend->nBlock--;
 		/* Release the heap */
-		pChunkSize = (sxu32 *)(((char *)pBlock) - sizeof(sxu32));
-		pBackend->pHeap->nSize -= pChunkSize[0];
+		MemBackendUncharge(&(*pBackend), pBlock->nSize);
 		pBackend->pMethods->xFree(pBlock);
 	}
 	return SXRET_OK;
@@ -267,79 +361,218 @@ PH7_PRIVATE sxi32 SyMemBackendFree(SyMemBackend *pBackend, void *pChunk) {
 	if(pBackend->pMutexMethods) {
 		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
 	}
-	rc = MemBackendFree(&(*pBackend), pChunk);
+	if(pBackend->nFlags & SXMEM_BACKEND_UNTRACKED) {
+		rc = MemBackendPoolFree(&(*pBackend), pChunk);
+	} else {
+		rc = MemBackendFree(&(*pBackend), pChunk);
+	}
 	if(pBackend->pMutexMethods) {
 		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
 	}
 	return rc;
 }
 /*
- * Memory pool allocator
+ * Memory pool allocator.
+ * Chunks are served from slabs of equally sized chunks. Size classes are spaced 8 bytes
+ * apart up to 128 bytes and then four classes per power of two up to SXMEM_SLAB_MAXALLOC,
+ * so that the rounding waste stays under 25%.
  */
 #define SXMEM_POOL_MAGIC		0xDEAD
-#define SXMEM_POOL_MAXALLOC		(1<<(SXMEM_POOL_NBUCKETS+SXMEM_POOL_INCR))
-#define SXMEM_POOL_MINALLOC		(1<<(SXMEM_POOL_INCR))
-static sxi32 MemPoolBucketAlloc(SyMemBackend *pBackend, sxu32 nBucket) {
-	char *zBucket, *zBucketEnd;
-	SyMemHeader *pHeader;
-	sxu32 nBucketSize;
-	/* Allocate one big block first */
-	zBucket = (char *)MemBackendAlloc(&(*pBackend), SXMEM_POOL_MAXALLOC);
-	if(zBucket == 0) {
-		return SXERR_MEM;
+#define SXMEM_SLAB_HDR			((sizeof(SyMemSlab) + 15) & ~15)
+/* Slab owning a pool chunk */
+#define MemSlabOf(CHUNK)		((SyMemSlab *)(((char *)(CHUNK)) - ((sxuptr)(CHUNK) & (SXMEM_SLAB_SIZE - 1))))
+/* Total size of the block holding a slab */
+#define MemSlabBlockSize(SLAB)	((SLAB)->nClass == SXU16_HIGH ? SXMEM_SLAB_HDR + (SLAB)->nSize : SXMEM_SLAB_SIZE)
+static sxu32 MemSlabClass(sxu32 nBytes) {
+	sxu32 nShift;
+	if(nBytes <= 128) {
+		return nBytes > 0 ? (nBytes - 1) >> 3 : 0;
+	}
+	nBytes--;
+	nShift = 7;
+	while((nBytes >> nShift) > 1) {
+		nShift++;
+	}
+	return 16 + ((nShift - 7) << 2) + (nBytes >> (nShift - 2)) - 4;
+}
+static sxu32 MemSlabClassSize(sxu32 nClass) {
+	if(nClass < 16) {
+		return (nClass + 1) << 3;
 	}
-	zBucketEnd = &zBucket[SXMEM_POOL_MAXALLOC];
-	/* Divide the big block into mini bucket pool */
-	nBucketSize = 1 << (nBucket + SXMEM_POOL_INCR);
-	pBackend->apPool[nBucket] = pHeader = (SyMemHeader *)zBucket;
+	nClass -= 16;
+	return (128 + ((nClass & 3) + 1) * 32) << (nClass >> 2);
+}
+/*
+ * Map SXMEM_SLAB_BATCH slabs at once and keep all but the first one as spare slabs.
+ * Only the header page of a spare slab is touched until it is carved, while the number
+ * of mapping system calls is divided by the batch size.
+ * Each slab is still unmapped individually once released.
+ */
+static void *MemSlabMapBatch(SyMemBackend *pBackend) {
+	char *zMap;
+#if defined(__WINNT__)
+	/* VirtualFree() cannot release a part of a reservation */
+	SXUNUSED(pBackend);
+	zMap = (char *)SyOSPageAlloc(SXMEM_SLAB_SIZE);
+#else
+	SyMemSlab *pSpare;
+	sxu32 i;
+	zMap = (char *)SyOSPageAlloc(SXMEM_SLAB_SIZE * SXMEM_SLAB_BATCH);
+	if(zMap == 0) {
+		/* Fall back to a single slab */
+		return SyOSPageAlloc(SXMEM_SLAB_SIZE);
+	}
+	for(i = SXMEM_SLAB_BATCH - 1 ; i > 0 ; i--) {
+		pSpare = (SyMemSlab *)&zMap[i * SXMEM_SLAB_SIZE];
+		pSpare->pRaw = 0;
+		pSpare->nClass = 0;
+		pSpare->pNext = pBackend->pSpare;
+		pBackend->pSpare = pSpare;
+		pBackend->nSpare++;
+	}
+#endif
+	return (void *)zMap;
+}
+static void *MemSlabBlockAlloc(SyMemBackend *pBackend, sxu32 nBytes, sxu32 nClass, void **ppRaw) {
+	char *zRaw;
+	sxi32 nRetry = 0;
+	*ppRaw = 0;
 	for(;;) {
-		if(&zBucket[nBucketSize] >= zBucketEnd) {
+		if(pBackend->pMethods == &sOSAllocMethods) {
+			if(nClass == SXU16_HIGH) {
+				zRaw = (char *)SyOSHeapAllocAligned(nBytes);
+			} else {
+				/* Map the slab directly so that its pages are given back once released */
+				zRaw = (char *)MemSlabMapBatch(&(*pBackend));
+			}
+		} else {
+			/* Host allocator, over-allocate so that the slab can be aligned */
+			zRaw = (char *)pBackend->pMethods->xAlloc(nBytes + SXMEM_SLAB_SIZE);
+			*ppRaw = zRaw;
+		}
+		if(zRaw != 0 || pBackend->xMemError == 0 || nRetry > SXMEM_BACKEND_RETRY
+				|| SXERR_RETRY != pBackend->xMemError(pBackend->pUserData)) {
 			break;
 		}
-		pHeader->pNext = (SyMemHeader *)&zBucket[nBucketSize];
-		/* Advance the cursor to the next available chunk */
-		pHeader = pHeader->pNext;
-		zBucket += nBucketSize;
+		nRetry++;
 	}
-	pHeader->pNext = 0;
-	return SXRET_OK;
+	if(zRaw && *ppRaw) {
+		zRaw = &zRaw[SXMEM_SLAB_SIZE - ((sxuptr)zRaw & (SXMEM_SLAB_SIZE - 1))];
+	}
+	return (void *)zRaw;
+}
+static SyMemSlab *MemSlabNew(SyMemBackend *pBackend, sxu32 nClass, sxu32 nSize) {
+	SyMemSlab *pSlab;
+	void *pRaw;
+	sxu32 nBlock;
+	nBlock = nClass == SXU16_HIGH ? SXMEM_SLAB_HDR + nSize : SXMEM_SLAB_SIZE;
+	/* Calculate memory usage */
+	if(MemBackendCalculate(pBackend, nBlock) != SXRET_OK) {
+		return 0;
+	}
+	if(nClass != SXU16_HIGH && pBackend->pSpare) {
+		/* Reuse a slab left behind by SyMemBackendReset() */
+		pSlab = pBackend->pSpare;
+		pBackend->pSpare = pSlab->pNext;
+		pBackend->nSpare--;
+		pRaw = pSlab->pRaw;
+	} else {
+		pSlab = (SyMemSlab *)MemSlabBlockAlloc(&(*pBackend), nBlock, nClass, &pRaw);
+		if(pSlab == 0) {
+			MemBackendUncharge(&(*pBackend), nBlock);
+			return 0;
+		}
+	}
+	SyZero(pSlab, sizeof(SyMemSlab));
+	pSlab->pRaw = pRaw;
+	pSlab->nCarve = SXMEM_SLAB_HDR;
+	pSlab->nSize = nSize;
+	pSlab->nClass = (sxu16)nClass;
+	pSlab->nMagic = SXMEM_POOL_MAGIC;
+	/* Link to the list of slabs */
+	MACRO_LD_PUSH(pBackend->pSlabs, pSlab);
+	return pSlab;
+}
+static void MemSlabBlockFree(SyMemBackend *pBackend, SyMemSlab *pSlab) {
+	if(pSlab->pRaw) {
+		pBackend->pMethods->xFree(pSlab->pRaw);
+	} else if(pSlab->nClass == SXU16_HIGH) {
+		SyOSHeapFreeAligned(pSlab);
+	} else {
+		SyOSPageFree(pSlab, SXMEM_SLAB_SIZE);
+	}
+}
+static void MemSlabRelease(SyMemBackend *pBackend, SyMemSlab *pSlab) {
+	MACRO_LD_REMOVE(pBackend->pSlabs, pSlab);
+	MemBackendUncharge(&(*pBackend), MemSlabBlockSize(pSlab));
+	pSlab->nMagic = 0x635B;
+	if(pSlab->nClass != SXU16_HIGH && pBackend->nSpare < SXMEM_SLAB_SPARE) {
+		/* Keep the slab for later use, mapping pages serializes threads in the kernel */
+		pSlab->pNext = pBackend->pSpare;
+		pBackend->pSpare = pSlab;
+		pBackend->nSpare++;
+		return;
+	}
+	MemSlabBlockFree(&(*pBackend), pSlab);
+}
+static void MemSlabLink(SyMemBackend *pBackend, SyMemSlab *pSlab) {
+	/* Link to the list of slabs with available chunks */
+	pSlab->pPrevFree = 0;
+	pSlab->pNextFree = pBackend->apSlab[pSlab->nClass];
+	if(pSlab->pNextFree) {
+		pSlab->pNextFree->pPrevFree = pSlab;
+	}
+	pBackend->apSlab[pSlab->nClass] = pSlab;
+}
+static void MemSlabUnlink(SyMemBackend *pBackend, SyMemSlab *pSlab) {
+	if(pSlab->pPrevFree) {
+		pSlab->pPrevFree->pNextFree = pSlab->pNextFree;
+	} else {
+		pBackend->apSlab[pSlab->nClass] = pSlab->pNextFree;
+	}
+	if(pSlab->pNextFree) {
+		pSlab->pNextFree->pPrevFree = pSlab->pPrevFree;
+	}
+	pSlab->pNextFree = pSlab->pPrevFree = 0;
 }
 static void *MemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
-	SyMemHeader *pBucket, *pNext;
-	sxu32 nBucketSize;
-	sxu32 nBucket;
-	if(nBytes + sizeof(SyMemHeader) >= SXMEM_POOL_MAXALLOC) {
-		/* Allocate a big chunk directly */
-		pBucket = (SyMemHeader *)MemBackendAlloc(&(*pBackend), nBytes + sizeof(SyMemHeader));
-		if(pBucket == 0) {
+	SyMemSlab *pSlab;
+	void *pChunk;
+	sxu32 nClass;
+	if(nBytes > SXMEM_SLAB_MAXALLOC) {
+		/* Allocate a big chunk in a private slab */
+		pSlab = MemSlabNew(&(*pBackend), SXU16_HIGH, nBytes);
+		if(pSlab == 0) {
 			return 0;
 		}
-		/* Record as big block */
-		pBucket->nBucket = (sxu32)(SXMEM_POOL_MAGIC << 16) | SXU16_HIGH;
-		return (void *)(pBucket + 1);
-	}
-	/* Locate the appropriate bucket */
-	nBucket = 0;
-	nBucketSize = SXMEM_POOL_MINALLOC;
-	while(nBytes + sizeof(SyMemHeader) > nBucketSize) {
-		nBucketSize <<= 1;
-		nBucket++;
-	}
-	pBucket = pBackend->apPool[nBucket];
-	if(pBucket == 0) {
-		sxi32 rc;
-		rc = MemPoolBucketAlloc(&(*pBackend), nBucket);
-		if(rc != SXRET_OK) {
+		pSlab->nUsed = 1;
+		return (void *)&((char *)pSlab)[SXMEM_SLAB_HDR];
+	}
+	/* Locate the appropriate size class */
+	nClass = MemSlabClass(nBytes);
+	pSlab = pBackend->apSlab[nClass];
+	if(pSlab == 0) {
+		pSlab = MemSlabNew(&(*pBackend), nClass, MemSlabClassSize(nClass));
+		if(pSlab == 0) {
 			return 0;
 		}
-		pBucket = pBackend->apPool[nBucket];
+		MemSlabLink(&(*pBackend), pSlab);
+	}
+	if(pSlab->pFree) {
+		/* Reuse a released chunk */
+		pChunk = pSlab->pFree;
+		pSlab->pFree = *(void **)pChunk;
+	} else {
+		/* Carve a fresh chunk, pages are touched only when actually used */
+		pChunk = (void *)&((char *)pSlab)[pSlab->nCarve];
+		pSlab->nCarve += pSlab->nSize;
+	}
+	pSlab->nUsed++;
+	if(pSlab->pFree == 0 && pSlab->nCarve + pSlab->nSize > SXMEM_SLAB_SIZE) {
+		/* Slab is full */
+		MemSlabUnlink(&(*pBackend), pSlab);
 	}
-	/* Remove from the free list */
-	pNext = pBucket->pNext;
-	pBackend->apPool[nBucket] = pNext;
-	/* Record bucket&magic number */
-	pBucket->nBucket = (SXMEM_POOL_MAGIC << 16) | nBucket;
-	return (void *)&pBucket[1];
+	return pChunk;
 }
 PH7_PRIVATE void *SyMemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
 	void *pChunk;
@@ -356,22 +589,30 @@ PH7_PRIVATE void *SyMemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nBytes) {
 	return pChunk;
 }
 static sxi32 MemBackendPoolFree(SyMemBackend *pBackend, void *pChunk) {
-	SyMemHeader *pHeader;
-	sxu32 nBucket;
-	/* Get the corresponding bucket */
-	pHeader = (SyMemHeader *)(((char *)pChunk) - sizeof(SyMemHeader));
+	SyMemSlab *pSlab;
+	sxu32 bFull;
+	/* Get the owning slab */
+	pSlab = MemSlabOf(pChunk);
 	/* Sanity check to avoid misuse */
-	if((pHeader->nBucket >> 16) != SXMEM_POOL_MAGIC) {
+	if(pSlab->nMagic != SXMEM_POOL_MAGIC) {
 		return SXERR_CORRUPT;
 	}
-	nBucket = pHeader->nBucket & 0xFFFF;
-	if(nBucket == SXU16_HIGH) {
-		/* Free the big block */
-		MemBackendFree(&(*pBackend), pHeader);
-	} else {
-		/* Return to the free list */
-		pHeader->pNext = pBackend->apPool[nBucket & 0x0f];
-		pBackend->apPool[nBucket & 0x0f] = pHeader;
+	if(pSlab->nClass == SXU16_HIGH) {
+		/* Free the big chunk */
+		MemSlabRelease(&(*pBackend), pSlab);
+		return SXRET_OK;
+	}
+	bFull = pSlab->pFree == 0 && pSlab->nCarve + pSlab->nSize > SXMEM_SLAB_SIZE;
+	/* Return to the free list */
+	*(void **)pChunk = pSlab->pFree;
+	pSlab->pFree = pChunk;
+	pSlab->nUsed--;
+	if(bFull) {
+		MemSlabLink(&(*pBackend), pSlab);
+	} else if(pSlab->nUsed < 1 && (pBackend->apSlab[pSlab->nClass] != pSlab || pSlab->pNextFree)) {
+		/* Give the empty slab back, but keep the last one of its class around */
+		MemSlabUnlink(&(*pBackend), pSlab);
+		MemSlabRelease(&(*pBackend), pSlab);
 	}
 	return SXRET_OK;
 }
@@ -390,28 +631,21 @@ PH7_PRIVATE sxi32 SyMemBackendPoolFree(SyMemBackend *pBackend, void *pChunk) {
 	return rc;
 }
 static void *MemBackendPoolRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nByte) {
-	sxu32 nBucket, nBucketSize;
-	SyMemHeader *pHeader;
+	SyMemSlab *pSlab;
 	void *pNew;
 	if(pOld == 0) {
 		/* Allocate a new pool */
 		pNew = MemBackendPoolAlloc(&(*pBackend), nByte);
 		return pNew;
 	}
-	/* Get the corresponding bucket */
-	pHeader = (SyMemHeader *)(((char *)pOld) - sizeof(SyMemHeader));
+	/* Get the owning slab */
+	pSlab = MemSlabOf(pOld);
 	/* Sanity check to avoid misuse */
-	if((pHeader->nBucket >> 16) != SXMEM_POOL_MAGIC) {
+	if(pSlab->nMagic != SXMEM_POOL_MAGIC) {
 		return 0;
 	}
-	nBucket = pHeader->nBucket & 0xFFFF;
-	if(nBucket == SXU16_HIGH) {
-		/* Big block */
-		return MemBackendRealloc(&(*pBackend), pHeader, nByte);
-	}
-	nBucketSize = 1 << (nBucket + SXMEM_POOL_INCR);
-	if(nBucketSize >= nByte + sizeof(SyMemHeader)) {
-		/* The old bucket can honor the requested size */
+	if(pSlab->nSize >= nByte) {
+		/* The old chunk can honor the requested size */
 		return pOld;
 	}
 	/* Allocate a new pool */
@@ -420,7 +654,7 @@ static void *MemBackendPoolRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nBy
 		return 0;
 	}
 	/* Copy the old data into the new block */
-	SyMemcpy(pOld, pNew, nBucketSize);
+	SyMemcpy(pOld, pNew, pSlab->nSize);
 	/* Free the stale block */
 	MemBackendPoolFree(&(*pBackend), pOld);
 	return pNew;
@@ -449,6 +683,10 @@ PH7_PRIVATE sxi32 SyMemBackendInit(SyMemBackend *pBackend, ProcMemError xMemErr,
 	pBackend->pUserData = pUserData;
 	/* Switch to the OS memory allocator */
 	pBackend->pMethods = &sOSAllocMethods;
+#ifndef SXMEM_BACKEND_TRACK
+	/* Blocks are carved from slabs that are released as a whole, there is no need to track them */
+	pBackend->nFlags = SXMEM_BACKEND_UNTRACKED;
+#endif
 	if(pBackend->pMethods->xInit) {
 		/* Initialize the backend  */
 		if(SXRET_OK != pBackend->pMethods->xInit(pBackend->pMethods->pUserData)) {
@@ -501,6 +739,7 @@ PH7_PRIVATE sxi32 SyMemBackendInitFromParent(SyMemBackend *pBackend, SyMemBacken
 	SyZero(&(*pBackend), sizeof(SyMemBackend));
 	/* Reinitialize the allocator */
 	pBackend->pMethods  = pParent->pMethods;
+	pBackend->nFlags    = pParent->nFlags;
 	pBackend->xMemError = pParent->xMemError;
 	pBackend->pUserData = pParent->pUserData;
 	if(pParent->pMutexMethods) {
@@ -519,8 +758,77 @@ PH7_PRIVATE sxi32 SyMemBackendInitFromParent(SyMemBackend *pBackend, SyMemBacken
 	pBackend->nMagic = SXMEM_BACKEND_MAGIC;
 	return SXRET_OK;
 }
+/*
+ * Switch the backend to a private heap control structure so that it no longer updates the
+ * counters of its parent. Backends used by different threads [i.e: one engine per thread]
+ * then never write to the same memory while allocating. The memory limit is inherited.
+ */
+PH7_PRIVATE sxi32 SyMemBackendDetachHeap(SyMemBackend *pBackend, SyMemHeap *pHeap) {
+	if(SXMEM_BACKEND_CORRUPT(pBackend) || pHeap == 0) {
+		return SXERR_CORRUPT;
+	}
+	SyZero(&(*pHeap), sizeof(SyMemHeap));
+	pHeap->nLimit = pBackend->pHeap->nLimit;
+	/* The reserved budget belongs to the old heap */
+	pBackend->pHeap->nSize -= pBackend->nBudget;
+	pBackend->nBudget = 0;
+	pBackend->pHeap = pHeap;
+	return SXRET_OK;
+}
+/*
+ * Release every chunk allocated from the given backend at once, without walking the chunks.
+ * The backend remains usable afterwards. Up to SXMEM_SLAB_SPARE empty slabs are kept
+ * around so that a backend which is reset over and over [i.e: VM request arena] does not
+ * have to go back to the OS each time.
+ */
+static void MemBackendReset(SyMemBackend *pBackend) {
+	SyMemSlab *pSlab, *pNextSlab;
+	for(pSlab = pBackend->pSlabs; pSlab; pSlab = pNextSlab) {
+		pNextSlab = pSlab->pNext;
+		MemBackendUncharge(&(*pBackend), MemSlabBlockSize(pSlab));
+		if(pSlab->nClass != SXU16_HIGH && pBackend->nSpare < SXMEM_SLAB_SPARE) {
+			/* Keep the slab for later use */
+			pSlab->pNext = pBackend->pSpare;
+			pBackend->pSpare = pSlab;
+			pBackend->nSpare++;
+		} else {
+			pSlab->nMagic = 0x635B;
+			MemSlabBlockFree(&(*pBackend), pSlab);
+		}
+	}
+	pBackend->pSlabs = 0;
+	SyZero(pBackend->apSlab, sizeof(pBackend->apSlab));
+	/* Release tracked blocks if any */
+	while(pBackend->nBlock > 0) {
+		MemBackendFree(&(*pBackend), (void *)&pBackend->pBlocks[1]);
+	}
+}
+PH7_PRIVATE sxi32 SyMemBackendReset(SyMemBackend *pBackend) {
+	if(SXMEM_BACKEND_CORRUPT(pBackend)) {
+		return SXERR_INVALID;
+	}
+	if(pBackend->pMutexMethods) {
+		SyMutexEnter(pBackend->pMutexMethods, pBackend->pMutex);
+	}
+	MemBackendReset(&(*pBackend));
+	if(pBackend->pMutexMethods) {
+		SyMutexLeave(pBackend->pMutexMethods, pBackend->pMutex);
+	}
+	return SXRET_OK;
+}
 static sxi32 MemBackendRelease(SyMemBackend *pBackend) {
 	SyMemBlock *pBlock, *pNext;
+	SyMemSlab *pSlab, *pNextSlab;
+	/* Release the memory pool */
+	for(pSlab = pBackend->pSlabs; pSlab; pSlab = pNextSlab) {
+		pNextSlab = pSlab->pNext;
+		MemSlabBlockFree(&(*pBackend), pSlab);
+	}
+	for(pSlab = pBackend->pSpare; pSlab; pSlab = pNextSlab) {
+		pNextSlab = pSlab->pNext;
+		MemSlabBlockFree(&(*pBackend), pSlab);
+	}
+	pBackend->pSlabs = pBackend->pSpare = 0;
 	pBlock = pBackend->pBlocks;
 	for(;;) {
 		if(pBackend->nBlock == 0) {
@@ -602,14 +910,103 @@ PH7_PRIVATE sxi32 SyBlobReadOnly(SyBlob *pBlob, const void *pData, sxu32 nByte)
 	pBlob->nByte = nByte;
 	pBlob->mByte = 0;
 	pBlob->nFlags |= SXBLOB_RDONLY;
+	pBlob->nFlags &= ~(SXBLOB_HASHED | SXBLOB_INTERN | SXBLOB_BORROWED);
 	return SXRET_OK;
 }
 #ifndef SXBLOB_MIN_GROWTH
 	#define SXBLOB_MIN_GROWTH 16
 #endif
+/*
+ * Heap allocated blob contents are prefixed by a small header holding a reference
+ * count, so that the same buffer can be shared by several blobs [i.e: String values]
+ * and copied only when one of them is modified (Copy-on-write).
+ * An extra byte is always reserved past the capacity (mByte) and the contents are kept
+ * null terminated, so that shared buffers and borrowed views never have to be copied
+ * just to append the terminator.
+ */
+typedef struct SyBlobChunk SyBlobChunk;
+struct SyBlobChunk {
+	sxu32 nRef;  /* Total number of blobs sharing this buffer */
+	sxu32 bPool; /* True if the chunk was taken from the memory pool [i.e: Small buffer] */
+};
+#define SXBLOB_HDR_SIZE     sizeof(SyBlobChunk) /* Keep the contents 8 bytes aligned */
+#define BlobChunk(PTR)      ((SyBlobChunk *)&((char *)(PTR))[-(sxi32)SXBLOB_HDR_SIZE])
+#define BlobRefCount(PTR)   (BlobChunk(PTR)->nRef)
+/* True if the blob own (or share) a heap allocated buffer */
+#define BlobIsHeap(BLOB)    (((BLOB)->nFlags & (SXBLOB_STATIC | SXBLOB_RDONLY)) == 0 && (BLOB)->mByte > 0)
+/*
+ * Small strings [i.e: Hashmap keys, tokens, single characters,...] are the vast majority
+ * of the blobs handled by the engine. Their buffers are taken from the memory pool free
+ * lists rather than from the tracked heap, so they do not cost a real allocation.
+ * The chunk (header + contents + null terminator) fits in a 32 bytes pool bucket.
+ */
+#ifndef SXBLOB_SMALL_SIZE
+	#define SXBLOB_SMALL_SIZE (24 - SXBLOB_HDR_SIZE - 1)
+#endif
+/*
+ * Allocate a new chunk able to hold nByte bytes of contents.
+ * Return a pointer to the contents on success. NULL otherwise.
+ */
+static char *BlobChunkAlloc(SyMemBackend *pAllocator, sxu32 nByte) {
+	SyBlobChunk *pChunk;
+	sxu32 bPool = nByte <= SXBLOB_SMALL_SIZE;
+	if(bPool) {
+		pChunk = (SyBlobChunk *)SyMemBackendPoolAlloc(&(*pAllocator), SXBLOB_SMALL_SIZE + 1 + SXBLOB_HDR_SIZE);
+	} else {
+		pChunk = (SyBlobChunk *)SyMemBackendAlloc(&(*pAllocator), nByte + 1 + SXBLOB_HDR_SIZE);
+	}
+	if(pChunk == 0) {
+		return 0;
+	}
+	/* We are the only owner of the buffer */
+	pChunk->nRef = 1;
+	pChunk->bPool = bPool;
+	return (char *)&pChunk[1];
+}
+/*
+ * Drop a reference to the heap buffer of the given blob.
+ * The buffer is released when the last reference goes away.
+ */
+static void BlobUnref(SyBlob *pBlob) {
+	SyBlobChunk *pChunk = BlobChunk(pBlob->pBlob);
+	if(--pChunk->nRef < 1) {
+		if(pChunk->bPool) {
+			SyMemBackendPoolFree(pBlob->pAllocator, pChunk);
+		} else {
+			SyMemBackendFree(pBlob->pAllocator, pChunk);
+		}
+	}
+}
+/*
+ * Give the blob a private copy of its contents with room for at least nByte bytes.
+ * This is done when a read-only or a shared buffer is about to be modified or
+ * when a small buffer outgrow the pool.
+ */
+static sxi32 BlobMakePrivate(SyBlob *pBlob, sxu32 nByte) {
+	char *zNew = 0;
+	if(nByte > 0) {
+		zNew = BlobChunkAlloc(pBlob->pAllocator, nByte);
+		if(zNew == 0) {
+			return SXERR_MEM;
+		}
+		SyMemcpy(pBlob->pBlob, zNew, pBlob->nByte);
+		zNew[pBlob->nByte] = 0;
+		if(nByte <= SXBLOB_SMALL_SIZE) {
+			nByte = SXBLOB_SMALL_SIZE;
+		}
+	}
+	if(BlobIsHeap(pBlob)) {
+		BlobUnref(&(*pBlob));
+	}
+	pBlob->pBlob = zNew;
+	pBlob->mByte = nByte;
+	/* Remove the read-only flag */
+	pBlob->nFlags &= ~(SXBLOB_RDONLY | SXBLOB_INTERN | SXBLOB_BORROWED);
+	return SXRET_OK;
+}
 static sxi32 BlobPrepareGrow(SyBlob *pBlob, sxu32 *pByte) {
 	sxu32 nByte;
-	void *pNew;
+	char *zNew;
 	nByte = *pByte;
 	if(pBlob->nFlags & (SXBLOB_LOCKED | SXBLOB_STATIC)) {
 		if(SyBlobFreeSpace(pBlob) < nByte) {
@@ -620,35 +1017,32 @@ static sxi32 BlobPrepareGrow(SyBlob *pBlob, sxu32 *pByte) {
 		}
 		return SXRET_OK;
 	}
-	if(pBlob->nFlags & SXBLOB_RDONLY) {
-		/* Make a copy of the read-only item */
-		if(pBlob->nByte > 0) {
-			pNew = SyMemBackendDup(pBlob->pAllocator, pBlob->pBlob, pBlob->nByte);
-			if(pNew == 0) {
-				return SXERR_MEM;
-			}
-			pBlob->pBlob = pNew;
-			pBlob->mByte = pBlob->nByte;
-		} else {
-			pBlob->pBlob = 0;
-			pBlob->mByte = 0;
+	if((pBlob->nFlags & SXBLOB_RDONLY) || (pBlob->mByte > 0 && BlobRefCount(pBlob->pBlob) > 1)) {
+		/* Make a copy of the read-only or shared item */
+		if(SXRET_OK != BlobMakePrivate(&(*pBlob), pBlob->nByte + nByte)) {
+			return SXERR_MEM;
 		}
-		/* Remove the read-only flag */
-		pBlob->nFlags &= ~SXBLOB_RDONLY;
 	}
 	if(SyBlobFreeSpace(pBlob) >= nByte) {
 		return SXRET_OK;
 	}
 	if(pBlob->mByte > 0) {
 		nByte = nByte + pBlob->mByte * 2 + SXBLOB_MIN_GROWTH;
+	} else if(nByte <= SXBLOB_SMALL_SIZE) {
+		/* Small buffer, taken from the pool */
+		return BlobMakePrivate(&(*pBlob), nByte);
 	} else if(nByte < SXBLOB_MIN_GROWTH) {
 		nByte = SXBLOB_MIN_GROWTH;
 	}
-	pNew = SyMemBackendRealloc(pBlob->pAllocator, pBlob->pBlob, nByte);
-	if(pNew == 0) {
+	if(pBlob->mByte < 1 || BlobChunk(pBlob->pBlob)->bPool) {
+		/* Move to the tracked heap */
+		return BlobMakePrivate(&(*pBlob), nByte);
+	}
+	zNew = (char *)SyMemBackendRealloc(pBlob->pAllocator, BlobChunk(pBlob->pBlob), nByte + 1 + SXBLOB_HDR_SIZE);
+	if(zNew == 0) {
 		return SXERR_MEM;
 	}
-	pBlob->pBlob = pNew;
+	pBlob->pBlob = &zNew[SXBLOB_HDR_SIZE];
 	pBlob->mByte = nByte;
 	return SXRET_OK;
 }
@@ -667,16 +1061,30 @@ PH7_PRIVATE sxi32 SyBlobAppend(SyBlob *pBlob, const void *pData, sxu32 nSize) {
 		zBlob = &zBlob[pBlob->nByte];
 		pBlob->nByte += nSize;
 		SX_MACRO_FAST_MEMCPY(pData, zBlob, nSize);
+		if((pBlob->nFlags & SXBLOB_STATIC) == 0) {
+			/* Keep heap contents null terminated */
+			zBlob[nSize] = 0;
+		}
+		/* Contents changed, invalidate the cached hash */
+		pBlob->nFlags &= ~SXBLOB_HASHED;
 	}
 	return SXRET_OK;
 }
 PH7_PRIVATE sxi32 SyBlobNullAppend(SyBlob *pBlob) {
 	sxi32 rc;
+	sxu32 nFlags;
 	sxu32 n;
+	if(BlobIsHeap(pBlob) || (pBlob->nFlags & (SXBLOB_BORROWED | SXBLOB_INTERN))) {
+		/* Heap buffers and interned strings are always null terminated */
+		return SXRET_OK;
+	}
 	n = pBlob->nByte;
+	nFlags = pBlob->nFlags & SXBLOB_HASHED;
 	rc = SyBlobAppend(&(*pBlob), (const void *)"\0", sizeof(char));
 	if(rc == SXRET_OK) {
+		/* The NUL terminator is not part of the contents, so the cached hash is still valid */
 		pBlob->nByte = n;
+		pBlob->nFlags |= nFlags;
 	}
 	return rc;
 }
@@ -686,10 +1094,83 @@ PH7_PRIVATE sxi32 SyBlobDup(SyBlob *pSrc, SyBlob *pDest) {
 		return SXERR_EMPTY;
 	}
 	if(pSrc->nByte > 0) {
+		sxu32 nOld = pDest->nByte;
 		rc = SyBlobAppend(&(*pDest), pSrc->pBlob, pSrc->nByte);
+		if(rc == SXRET_OK && nOld == 0 && (pSrc->nFlags & SXBLOB_HASHED)) {
+			/* Exact copy, inherit the cached hash */
+			pDest->nHash = pSrc->nHash;
+			pDest->nFlags |= SXBLOB_HASHED;
+		}
 	}
 	return rc;
 }
+/*
+ * Make the destination blob share the contents of the source blob.
+ * The underlying buffer is reference counted and is copied only when one
+ * of the blobs is modified. A plain copy is performed when the source
+ * contents cannot be shared [i.e: Static or foreign read-only buffer].
+ */
+PH7_PRIVATE sxi32 SyBlobShare(SyBlob *pSrc, SyBlob *pDest) {
+	if(pSrc == 0 || pDest == 0) {
+		return SXERR_EMPTY;
+	}
+	if(pSrc->pBlob == pDest->pBlob && pSrc->nByte == pDest->nByte && BlobIsHeap(pDest)) {
+		/* Already shared */
+		return SXRET_OK;
+	}
+	if(pSrc->nByte > 0 && (pSrc->nFlags & SXBLOB_INTERN) && (pDest->nFlags & (SXBLOB_LOCKED | SXBLOB_STATIC)) == 0) {
+		/* Interned strings outlive any value, a read-only view is enough */
+		SyBlobRelease(&(*pDest));
+		return SyBlobBorrow(&(*pSrc), &(*pDest));
+	}
+	if(pSrc->nByte < 1 || (!BlobIsHeap(pSrc) && (pSrc->nFlags & SXBLOB_BORROWED) == 0) ||
+			pSrc->pAllocator != pDest->pAllocator || (pDest->nFlags & (SXBLOB_LOCKED | SXBLOB_STATIC))) {
+		SyBlobReset(&(*pDest));
+		return SyBlobDup(&(*pSrc), &(*pDest));
+	}
+	SyBlobRelease(&(*pDest));
+	BlobRefCount(pSrc->pBlob)++;
+	pDest->pBlob = pSrc->pBlob;
+	pDest->nByte = pSrc->nByte;
+	/* The capacity of a borrowed buffer is unknown, assume it is full */
+	pDest->mByte = BlobIsHeap(pSrc) ? pSrc->mByte : pSrc->nByte;
+	pDest->nHash = pSrc->nHash;
+	pDest->nFlags = pSrc->nFlags & SXBLOB_HASHED;
+	return SXRET_OK;
+}
+/*
+ * Make the destination blob a read-only view of the source contents.
+ * The view is valid as long as the source blob is not modified or released.
+ * A view of a heap buffer can later be turned into a counted reference via
+ * SyBlobShare().
+ */
+PH7_PRIVATE sxi32 SyBlobBorrow(SyBlob *pSrc, SyBlob *pDest) {
+	sxu32 nFlags;
+	if(pSrc == 0 || pDest == 0) {
+		return SXERR_EMPTY;
+	}
+	nFlags = pSrc->nFlags & (SXBLOB_HASHED | SXBLOB_INTERN | SXBLOB_BORROWED);
+	if(BlobIsHeap(pSrc)) {
+		nFlags |= SXBLOB_BORROWED;
+	}
+	SyBlobReadOnly(&(*pDest), pSrc->pBlob, pSrc->nByte);
+	pDest->nHash = pSrc->nHash;
+	pDest->nFlags |= nFlags;
+	return SXRET_OK;
+}
+/*
+ * Make sure the blob own a private, writable copy of its contents before
+ * an in-place modification.
+ */
+PH7_PRIVATE sxi32 SyBlobDetach(SyBlob *pBlob) {
+	if(pBlob->nFlags & SXBLOB_STATIC) {
+		return SXRET_OK;
+	}
+	if((pBlob->nFlags & SXBLOB_RDONLY) || (pBlob->mByte > 0 && BlobRefCount(pBlob->pBlob) > 1)) {
+		return BlobMakePrivate(&(*pBlob), pBlob->nByte);
+	}
+	return SXRET_OK;
+}
 PH7_PRIVATE sxi32 SyBlobCmp(SyBlob *pLeft, SyBlob *pRight) {
 	sxi32 rc;
 	if(pLeft == 0 || pRight == 0) {
@@ -706,18 +1187,40 @@ PH7_PRIVATE sxi32 SyBlobCmp(SyBlob *pLeft, SyBlob *pRight) {
 	rc = SyMemcmp(pLeft->pBlob, pRight->pBlob, pLeft->nByte);
 	return rc;
 }
+/*
+ * Return the hash of the blob contents.
+ * The hash is computed using the default string hash function [i.e: SyBinHash()]
+ * and cached in the blob, so that strings used several times as hashmap keys
+ * are hashed only once. Any modification of the blob contents invalidate the
+ * cached value.
+ */
+PH7_PRIVATE sxu32 SyBlobHash(SyBlob *pBlob) {
+	if((pBlob->nFlags & SXBLOB_HASHED) == 0) {
+		pBlob->nHash = SyBinHash(pBlob->pBlob, pBlob->nByte);
+		pBlob->nFlags |= SXBLOB_HASHED;
+	}
+	return pBlob->nHash;
+}
 PH7_PRIVATE sxi32 SyBlobReset(SyBlob *pBlob) {
 	pBlob->nByte = 0;
-	if(pBlob->nFlags & SXBLOB_RDONLY) {
+	pBlob->nFlags &= ~SXBLOB_HASHED;
+	if(BlobIsHeap(pBlob) && BlobRefCount(pBlob->pBlob) > 1) {
+		/* Shared buffer, let the other owners keep it */
+		BlobUnref(&(*pBlob));
+		pBlob->pBlob = 0;
+		pBlob->mByte = 0;
+	} else if(BlobIsHeap(pBlob)) {
+		((char *)pBlob->pBlob)[0] = 0;
+	} else if(pBlob->nFlags & SXBLOB_RDONLY) {
 		pBlob->pBlob = 0;
 		pBlob->mByte = 0;
-		pBlob->nFlags &= ~SXBLOB_RDONLY;
+		pBlob->nFlags &= ~(SXBLOB_RDONLY | SXBLOB_INTERN | SXBLOB_BORROWED);
 	}
 	return SXRET_OK;
 }
 PH7_PRIVATE sxi32 SyBlobRelease(SyBlob *pBlob) {
-	if((pBlob->nFlags & (SXBLOB_STATIC | SXBLOB_RDONLY)) == 0 && pBlob->mByte > 0) {
-		SyMemBackendFree(pBlob->pAllocator, pBlob->pBlob);
+	if(BlobIsHeap(pBlob)) {
+		BlobUnref(&(*pBlob));
 	}
 	pBlob->pBlob = 0;
 	pBlob->nByte = pBlob->mByte = 0;
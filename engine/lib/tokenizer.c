@@ -32,11 +32,12 @@ PH7_PRIVATE sxi32 SyLexInit(SyLex *pLex, SySet *pSet, ProcTokenizer xTokenizer,
 	pStream->pSet  = pSet;
 	return SXRET_OK;
 }
-PH7_PRIVATE sxi32 SyLexTokenizeInput(SyLex *pLex, const char *zInput, sxu32 nLen, void *pCtxData, ProcSort xSort, ProcCmp xCmp) {
-	const unsigned char *zCur;
+/*
+ * Point the lexer to the given input so that tokens can be extracted on demand
+ * via SyLexTokenizeNext() instead of tokenizing the whole input at once.
+ */
+PH7_PRIVATE sxi32 SyLexSetInput(SyLex *pLex, const char *zInput, sxu32 nLen) {
 	SyStream *pStream;
-	SyToken sToken;
-	sxi32 rc;
 	if(INVALID_LEXER(pLex) || zInput == 0) {
 		return SXERR_CORRUPT;
 	}
@@ -45,34 +46,66 @@ PH7_PRIVATE sxi32 SyLexTokenizeInput(SyLex *pLex, const char *zInput, sxu32 nLen
 	pStream->zText = pStream->zInput = (const unsigned char *)zInput;
 	/* Point to the end of the input */
 	pStream->zEnd = &pStream->zInput[nLen];
+	return SXRET_OK;
+}
+/*
+ * Extract the next token from the input and append it to the token set.
+ * Tokens the tokenizer callback request to ignore are skipped.
+ * Return SXERR_EOF once the end of the input is reached.
+ */
+PH7_PRIVATE sxi32 SyLexTokenizeNext(SyLex *pLex, void *pCtxData) {
+	const unsigned char *zCur;
+	SyStream *pStream;
+	SyToken sToken;
+	sxi32 rc;
+	if(INVALID_LEXER(pLex)) {
+		return SXERR_CORRUPT;
+	}
+	pStream = &pLex->sStream;
 	for(;;) {
 		if(pStream->zText >= pStream->zEnd) {
 			/* End of the input reached */
-			break;
+			return SXERR_EOF;
 		}
 		zCur = pStream->zText;
 		/* Call the tokenizer callback */
 		rc = pLex->xTokenizer(pStream, &sToken, pLex->pUserData, pCtxData);
 		if(rc != SXRET_OK && rc != SXERR_CONTINUE) {
 			/* Tokenizer callback request an operation abort */
-			if(rc == SXERR_ABORT) {
-				return SXERR_ABORT;
-			}
-			break;
+			return rc == SXERR_ABORT ? SXERR_ABORT : SXERR_EOF;
+		}
+		if(zCur >= pStream->zText) {
+			/* Automatic advance of the stream cursor */
+			pStream->zText = &zCur[1];
 		}
 		if(rc == SXERR_CONTINUE) {
 			/* Request to ignore this token */
 			pStream->nIgn++;
-		} else if(pLex->pTokenSet) {
+			continue;
+		}
+		if(pLex->pTokenSet) {
 			/* Put the token in the set */
 			rc = SySetPut(pLex->pTokenSet, (const void *)&sToken);
 			if(rc != SXRET_OK) {
-				break;
+				return SXERR_EOF;
 			}
 		}
-		if(zCur >= pStream->zText) {
-			/* Automatic advance of the stream cursor */
-			pStream->zText = &zCur[1];
+		return SXRET_OK;
+	}
+}
+PH7_PRIVATE sxi32 SyLexTokenizeInput(SyLex *pLex, const char *zInput, sxu32 nLen, void *pCtxData, ProcSort xSort, ProcCmp xCmp) {
+	sxi32 rc;
+	rc = SyLexSetInput(&(*pLex), zInput, nLen);
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	for(;;) {
+		rc = SyLexTokenizeNext(&(*pLex), pCtxData);
+		if(rc != SXRET_OK) {
+			if(rc == SXERR_ABORT) {
+				return SXERR_ABORT;
+			}
+			break;
 		}
 	}
 	if(xSort &&  pLex->pTokenSet) {
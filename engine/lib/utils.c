@@ -7,6 +7,10 @@
  *              Rafal Kupiec <belliash@codingworkshop.eu.org>
  */
 #include "ph7int.h"
+#ifdef __UNIXES__
+	#include <unistd.h>
+	#include <time.h>
+#endif
 
 PH7_PRIVATE sxi32 SyStrIsNumeric(const char *zSrc, sxu32 nLen, sxu8 *pReal, const char  **pzTail) {
 	const char *zCur, *zEnd;
@@ -504,3 +508,35 @@ PH7_PRIVATE sxi32 SyRealPath(const char *zPath, char *fPath) {
 	}
 	return PH7_OK;
 }
+PH7_PRIVATE sxi32 SyGetCwd(char *zBuf, sxu32 nLen) {
+#ifdef __WINNT__
+	if(GetCurrentDirectory(nLen, zBuf) == 0) {
+#else
+	if(getcwd(zBuf, nLen) == NULL) {
+#endif
+		return PH7_IO_ERR;
+	}
+	return PH7_OK;
+}
+/*
+ * Monotonic clock used to measure short durations.
+ * Return the current time in microseconds.
+ */
+PH7_PRIVATE sxu64 SyClockMicro(void) {
+#if defined(__WINNT__)
+	LARGE_INTEGER nFreq, nNow;
+	if(!QueryPerformanceFrequency(&nFreq) || !QueryPerformanceCounter(&nNow)) {
+		return (sxu64)GetTickCount() * 1000;
+	}
+	return (sxu64)(nNow.QuadPart / nFreq.QuadPart) * SX_USEC_PER_SEC + (sxu64)(nNow.QuadPart % nFreq.QuadPart) * SX_USEC_PER_SEC / (sxu64)nFreq.QuadPart;
+#elif defined(__UNIXES__)
+	struct timespec sNow;
+	if(clock_gettime(CLOCK_MONOTONIC, &sNow) != 0) {
+		return 0;
+	}
+	return (sxu64)sNow.tv_sec * SX_USEC_PER_SEC + (sxu64)sNow.tv_nsec / 1000;
+#else
+	/* No clock available */
+	return 0;
+#endif
+}
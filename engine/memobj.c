@@ -802,7 +802,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInit(ph7_vm *pVm, ph7_value *pObj) {
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the NULL type */
 	pObj->nType = MEMOBJ_NULL;
 	return SXRET_OK;
@@ -815,7 +815,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromInt(ph7_vm *pVm, ph7_value *pObj, sxi64 iVal
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the desired type */
 	pObj->x.iVal = iVal;
 	pObj->nType = MEMOBJ_INT;
@@ -829,7 +829,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromBool(ph7_vm *pVm, ph7_value *pObj, sxi32 iVa
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the desired type */
 	pObj->x.iVal = iVal ? 1 : 0;
 	pObj->nType = MEMOBJ_BOOL;
@@ -843,7 +843,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromReal(ph7_vm *pVm, ph7_value *pObj, ph7_real
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the desired type */
 	pObj->x.rVal = rVal;
 	pObj->nType = MEMOBJ_REAL;
@@ -857,7 +857,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromVoid(ph7_vm *pVm, ph7_value *pObj) {
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the desired type */
 	pObj->nType = MEMOBJ_VOID;
 	return SXRET_OK;
@@ -869,7 +869,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromArray(ph7_vm *pVm, ph7_value *pObj, ph7_hash
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	/* Set the desired type */
 	pObj->nType = MEMOBJ_HASHMAP;
 	pObj->x.pOther = pArray;
@@ -883,7 +883,7 @@ PH7_PRIVATE sxi32 PH7_MemObjInitFromString(ph7_vm *pVm, ph7_value *pObj, const S
 	SyZero(pObj, sizeof(ph7_value));
 	/* Initialize fields */
 	pObj->pVm = pVm;
-	SyBlobInit(&pObj->sBlob, &pVm->sAllocator);
+	SyBlobInit(&pObj->sBlob, PH7_VmValueAllocator(pVm));
 	if(pVal) {
 		/* Append contents */
 		SyBlobAppend(&pObj->sBlob, (const void *)pVal->zString, pVal->nByte);
@@ -932,6 +932,7 @@ PH7_PRIVATE sxi32 PH7_MemObjStringFormat(ph7_value *pObj, const char *zFormat, v
 PH7_PRIVATE sxi32 PH7_MemObjStore(ph7_value *pSrc, ph7_value *pDest) {
 	ph7_class_instance *pObj = 0;
 	ph7_hashmap *pSrcMap = 0;
+	ph7_hashmap *pOldMap = 0;
 	sxi32 rc;
 	if(pSrc->x.pOther) {
 		if(pSrc->nType & MEMOBJ_HASHMAP) {
@@ -942,10 +943,15 @@ PH7_PRIVATE sxi32 PH7_MemObjStore(ph7_value *pSrc, ph7_value *pDest) {
 			((ph7_class_instance *)pSrc->x.pOther)->iRef++;
 		}
 	}
-	if(pDest->nType & MEMOBJ_OBJ) {
+	if(pDest->nType & MEMOBJ_HASHMAP) {
+		/* Typed arrays [i.e: object[]] carry the MEMOBJ_OBJ flag too */
+		pOldMap = (ph7_hashmap *)pDest->x.pOther;
+	} else if(pDest->nType & MEMOBJ_OBJ) {
 		pObj = (ph7_class_instance *)pDest->x.pOther;
 	}
-	SyMemcpy((const void *) & (*pSrc), &(*pDest), sizeof(ph7_value) - (sizeof(ph7_vm *) + sizeof(SyBlob) + sizeof(sxu32)));
+	pDest->x = pSrc->x;
+	pDest->nType = pSrc->nType;
+	pDest->iFlags = pSrc->iFlags;
 	if(pSrcMap) {
 		ph7_hashmap *pMap;
 		pMap = PH7_NewHashmap(&(*pDest->pVm), 0, 0);
@@ -954,8 +960,8 @@ PH7_PRIVATE sxi32 PH7_MemObjStore(ph7_value *pSrc, ph7_value *pDest) {
 	}
 	rc = SXRET_OK;
 	if(SyBlobLength(&pSrc->sBlob) > 0) {
-		SyBlobReset(&pDest->sBlob);
-		rc = SyBlobDup(&pSrc->sBlob, &pDest->sBlob);
+		/* Share the string buffer, it is copied only on modification */
+		rc = SyBlobShare(&pSrc->sBlob, &pDest->sBlob);
 	} else {
 		if(SyBlobLength(&pDest->sBlob) > 0) {
 			SyBlobRelease(&pDest->sBlob);
@@ -963,6 +969,9 @@ PH7_PRIVATE sxi32 PH7_MemObjStore(ph7_value *pSrc, ph7_value *pDest) {
 	}
 	if(pObj) {
 		PH7_ClassInstanceUnref(pObj);
+	} else if(pOldMap && pOldMap != pDest->x.pOther) {
+		/* Drop the overwritten array */
+		PH7_HashmapUnref(pOldMap);
 	}
 	return rc;
 }
@@ -971,8 +980,9 @@ PH7_PRIVATE sxi32 PH7_MemObjStore(ph7_value *pSrc, ph7_value *pDest) {
  * buffer contents,simply point to it.
  */
 PH7_PRIVATE sxi32 PH7_MemObjLoad(ph7_value *pSrc, ph7_value *pDest) {
-	SyMemcpy((const void *) & (*pSrc), &(*pDest),
-			 sizeof(ph7_value) - (sizeof(ph7_vm *) + sizeof(SyBlob) + sizeof(sxu32)));
+	pDest->x = pSrc->x;
+	pDest->nType = pSrc->nType;
+	pDest->iFlags = pSrc->iFlags;
 	if(pSrc->x.pOther) {
 		if(pSrc->nType & MEMOBJ_HASHMAP) {
 			/* Increment reference count */
@@ -986,7 +996,7 @@ PH7_PRIVATE sxi32 PH7_MemObjLoad(ph7_value *pSrc, ph7_value *pDest) {
 		SyBlobRelease(&pDest->sBlob);
 	}
 	if(SyBlobLength(&pSrc->sBlob) > 0) {
-		SyBlobReadOnly(&pDest->sBlob, SyBlobData(&pSrc->sBlob), SyBlobLength(&pSrc->sBlob));
+		SyBlobBorrow(&pSrc->sBlob, &pDest->sBlob);
 	}
 	return SXRET_OK;
 }
@@ -995,17 +1005,24 @@ PH7_PRIVATE sxi32 PH7_MemObjLoad(ph7_value *pSrc, ph7_value *pDest) {
  */
 PH7_PRIVATE sxi32 PH7_MemObjRelease(ph7_value *pObj) {
 	if((pObj->nType & MEMOBJ_NULL) == 0) {
-		if(pObj->x.pOther) {
-			if(pObj->nType & MEMOBJ_HASHMAP) {
-				PH7_HashmapUnref((ph7_hashmap *)pObj->x.pOther);
-			} else if(pObj->nType & MEMOBJ_OBJ) {
-				PH7_ClassInstanceUnref((ph7_class_instance *)pObj->x.pOther);
-			}
-		}
+		void *pOther = pObj->x.pOther;
+		sxi32 nType = pObj->nType;
 		/* Release the internal buffer */
 		SyBlobRelease(&pObj->sBlob);
-		/* Invalidate any prior representation */
+		/*
+		 * Invalidate any prior representation before dropping the reference, the release
+		 * may reach this value again [i.e: Hashmap holding the last reference to the
+		 * class instance owning the attribute which holds the hashmap].
+		 */
 		pObj->nType = MEMOBJ_NULL;
+		pObj->x.pOther = 0;
+		if(pOther) {
+			if(nType & MEMOBJ_HASHMAP) {
+				PH7_HashmapUnref((ph7_hashmap *)pOther);
+			} else if(nType & MEMOBJ_OBJ) {
+				PH7_ClassInstanceUnref((ph7_class_instance *)pOther);
+			}
+		}
 	}
 	return SXRET_OK;
 }
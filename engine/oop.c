@@ -7,6 +7,9 @@
  *              Rafal Kupiec <belliash@codingworkshop.eu.org>
  */
 #include "ph7int.h"
+#ifdef __UNIXES__
+	#include <sys/time.h>
+#endif
 /*
  * Create an empty class inheritance storage.
  * Return a pointer to a storage (ph7_class_info instance) on success. NULL otherwise.
@@ -77,8 +80,8 @@ PH7_PRIVATE ph7_class_attr *PH7_NewClassAttr(ph7_vm *pVm, ph7_class *pClass, con
 	}
 	/* Zero the structure */
 	SyZero(pAttr, sizeof(ph7_class_attr));
-	/* Duplicate attribute name */
-	zName = SyMemBackendStrDup(&pVm->sAllocator, pName->zString, pName->nByte);
+	/* Intern attribute name */
+	zName = PH7_VmInternString(&(*pVm), pName->zString, pName->nByte);
 	if(zName == 0) {
 		SyMemBackendPoolFree(&pVm->sAllocator, pAttr);
 		return 0;
@@ -135,14 +138,18 @@ PH7_PRIVATE ph7_class_method *PH7_NewClassMethod(ph7_vm *pVm, ph7_class *pClass,
 		pNamePtr = &pMeth->sVmName;
 		/* Use the same VM name */
 		SyStringDupPtr(pNamePtr, &pCurrent->sVmName);
-		zName = (char *)pNamePtr->zString;
 	}
 	/* Initialize method fields */
 	pMeth->iProtection = iProtection;
 	pMeth->iFlags = iFlags;
 	pMeth->nLine = nLine;
-	PH7_VmInitFuncState(&(*pVm), &pMeth->sFunc, &zName[sizeof(char) * 4/*[__@*/ + SyStringLength(&pClass->sName)],
-						pName->nByte, iFuncFlags | VM_FUNC_CLASS_METHOD, pClass);
+	/* Intern method name */
+	zName = PH7_VmInternString(&(*pVm), pName->zString, pName->nByte);
+	if(zName == 0) {
+		SyMemBackendPoolFree(&pVm->sAllocator, pMeth);
+		return 0;
+	}
+	PH7_VmInitFuncState(&(*pVm), &pMeth->sFunc, zName, pName->nByte, iFuncFlags | VM_FUNC_CLASS_METHOD, pClass);
 	return pMeth;
 }
 /*
@@ -483,7 +490,7 @@ PH7_PRIVATE sxi32 PH7_ClassImplement(ph7_vm *pVm, ph7_class *pMain, ph7_class *p
 static ph7_class_instance *NewClassInstance(ph7_vm *pVm, ph7_class *pClass) {
 	ph7_class_instance *pThis;
 	/* Allocate a new instance */
-	pThis = (ph7_class_instance *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(ph7_class_instance));
+	pThis = (ph7_class_instance *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(ph7_class_instance));
 	if(pThis == 0) {
 		return 0;
 	}
@@ -493,28 +500,75 @@ static ph7_class_instance *NewClassInstance(ph7_vm *pVm, ph7_class *pClass) {
 	pThis->iRef = 1;
 	pThis->pVm = pVm;
 	pThis->pClass = pClass;
-	SyHashInit(&pThis->hAttr, &pVm->sAllocator, 0, 0);
+	SyHashInit(&pThis->hAttr, &pVm->sArena, 0, 0);
 	return pThis;
 }
+/* Forward declaration */
+static void ClassInstanceFreeTable(ph7_class_instance *pThis);
 /*
- * Wrapper around the NewClassInstance() function defined above.
- * See the block comment above for more information.
+ * Allocate a class instance and its private VM frame.
+ * Instances released earlier are recycled from the class freelist first,
+ * their attributes table is already built.
  */
-PH7_PRIVATE ph7_class_instance *PH7_NewClassInstance(ph7_vm *pVm, ph7_class *pClass) {
+static ph7_class_instance *ClassInstanceAlloc(ph7_vm *pVm, ph7_class *pClass) {
 	ph7_class_instance *pNew;
+	int bRecycled;
 	sxi32 rc;
-	pNew = NewClassInstance(&(*pVm), &(*pClass));
-	if(pNew == 0) {
-		return 0;
+	pNew = pClass->pFreeList;
+	bRecycled = pNew != 0;
+	if(bRecycled) {
+		/* Recycle a released instance */
+		pClass->pFreeList = pNew->pNextFree;
+		pClass->nFreeList--;
+		pNew->pNextFree = 0;
+		pNew->iRef = 1;
+		pNew->iFlags = 0;
+		pNew->nGcRoot = 0;
+	} else {
+		pNew = NewClassInstance(&(*pVm), &(*pClass));
+		if(pNew == 0) {
+			return 0;
+		}
 	}
 	/* Associate a private VM frame with this class instance */
 	rc = PH7_VmCreateClassInstanceFrame(&(*pVm), pNew);
 	if(rc != SXRET_OK) {
-		SyMemBackendPoolFree(&pVm->sAllocator, pNew);
+		/* No attribute is left initialized, release the table and the structure */
+		ClassInstanceFreeTable(pNew);
 		return 0;
 	}
+	if(bRecycled) {
+		pVm->nObjCacheHit++;
+	} else {
+		pVm->nObjCacheMiss++;
+	}
 	return pNew;
 }
+/*
+ * Wrapper around the NewClassInstance() function defined above.
+ * See the block comment above for more information.
+ */
+PH7_PRIVATE ph7_class_instance *PH7_NewClassInstance(ph7_vm *pVm, ph7_class *pClass) {
+	sxu32 nFree;
+	if(SySetUsed(&pVm->aGcRoot) >= pVm->nGcThreshold) {
+		/* Reclaim garbage cycles before growing the heap */
+		nFree = PH7_ClassInstanceCollectCycles(&(*pVm), pVm->nGcBudget);
+		/*
+		 * Back off while collections find little garbage, so that large live
+		 * object graphs [i.e: Lists, trees] are not walked over and over again.
+		 * A collection cut short by its time slice resumes as soon as enough
+		 * new roots were recorded instead.
+		 */
+		if(SySetUsed(&pVm->aGcRoot) > 0) {
+			pVm->nGcThreshold = SySetUsed(&pVm->aGcRoot) + PH7_GC_ROOT_THRESHOLD;
+		} else if(nFree >= PH7_GC_ROOT_THRESHOLD / 32) {
+			pVm->nGcThreshold = PH7_GC_ROOT_THRESHOLD;
+		} else if(pVm->nGcThreshold < PH7_GC_ROOT_THRESHOLD_MAX) {
+			pVm->nGcThreshold += PH7_GC_ROOT_THRESHOLD;
+		}
+	}
+	return ClassInstanceAlloc(&(*pVm), &(*pClass));
+}
 /*
  * Extract the value of a class instance [i.e: Object in the PHP jargon] attribute.
  * This function never fail.
@@ -522,7 +576,7 @@ PH7_PRIVATE ph7_class_instance *PH7_NewClassInstance(ph7_vm *pVm, ph7_class *pCl
 static ph7_value *ExtractClassAttrValue(ph7_vm *pVm, VmClassAttr *pAttr) {
 	/* Extract the value */
 	ph7_value *pValue;
-	pValue = (ph7_value *)SySetAt(&pVm->aMemObj, pAttr->nIdx);
+	pValue = PH7_VmMemObjAt(pVm, pAttr->nIdx);
 	return pValue;
 }
 /*
@@ -615,19 +669,12 @@ PH7_PRIVATE ph7_class_instance *PH7_CloneClassInstance(ph7_class_instance *pSrc)
 	SyHashEntry *pEntry2;
 	SyHashEntry *pEntry;
 	ph7_vm *pVm;
-	sxi32 rc;
 	/* Allocate a new instance */
 	pVm = pSrc->pVm;
-	pClone = NewClassInstance(pVm, pSrc->pClass);
+	pClone = ClassInstanceAlloc(pVm, pSrc->pClass);
 	if(pClone == 0) {
 		return 0;
 	}
-	/* Associate a private VM frame with this class instance */
-	rc = PH7_VmCreateClassInstanceFrame(pVm, pClone);
-	if(rc != SXRET_OK) {
-		SyMemBackendPoolFree(&pVm->sAllocator, pClone);
-		return 0;
-	}
 	/* Duplicate object values */
 	SyHashResetLoopCursor(&pSrc->hAttr);
 	SyHashResetLoopCursor(&pClone->hAttr);
@@ -660,17 +707,69 @@ PH7_PRIVATE ph7_class_instance *PH7_CloneClassInstance(ph7_class_instance *pSrc)
 	/* Return the cloned object */
 	return pClone;
 }
-#define CLASS_INSTANCE_DESTROYED 0x001 /* Instance is released */
+#define CLASS_INSTANCE_DESTROYED  0x001 /* Instance is released */
+#define CLASS_INSTANCE_BUFFERED   0x002 /* Instance is a possible root of a garbage cycle */
+#define CLASS_INSTANCE_GRAY       0x004 /* Trial deletion in progress */
+#define CLASS_INSTANCE_WHITE      0x008 /* Garbage candidate */
+#define CLASS_INSTANCE_DESTRUCTED 0x010 /* Destructor already invoked by the cycle collector */
+/*
+ * Remove a class instance from the cycle collector root buffer.
+ */
+static void ClassInstanceUnbuffer(ph7_class_instance *pThis) {
+	if(pThis->iFlags & CLASS_INSTANCE_BUFFERED) {
+		ph7_vm *pVm = pThis->pVm;
+		((ph7_class_instance **)SySetBasePtr(&pVm->aGcRoot))[pThis->nGcRoot] = 0;
+		pThis->iFlags &= ~CLASS_INSTANCE_BUFFERED;
+	}
+}
+/*
+ * Release the non-static attributes values of a class instance.
+ */
+static void ClassInstanceReleaseAttr(ph7_class_instance *pThis) {
+	ph7_vm *pVm = pThis->pVm;
+	SyHashEntry *pEntry;
+	SyHashResetLoopCursor(&pThis->hAttr);
+	while((pEntry = SyHashGetNextEntry(&pThis->hAttr)) != 0) {
+		VmClassAttr *pVmAttr = (VmClassAttr *)pEntry->pUserData;
+		if((pVmAttr->pAttr->iFlags & (PH7_CLASS_ATTR_STATIC | PH7_CLASS_ATTR_CONSTANT)) == 0) {
+			PH7_VmUnsetMemObj(pVm, pVmAttr->nIdx, TRUE);
+		}
+	}
+}
+/*
+ * Free the attributes table and the structure of a class instance.
+ */
+static void ClassInstanceFreeTable(ph7_class_instance *pThis) {
+	ph7_vm *pVm = pThis->pVm;
+	SyHashEntry *pEntry;
+	SyHashResetLoopCursor(&pThis->hAttr);
+	while((pEntry = SyHashGetNextEntry(&pThis->hAttr)) != 0) {
+		SyMemBackendPoolFree(&pVm->sArena, pEntry->pUserData);
+	}
+	SyHashRelease(&pThis->hAttr);
+	SyMemBackendPoolFree(&pVm->sArena, pThis);
+}
+/*
+ * Free the attributes table and the structure of a released class instance.
+ * Up to PH7_CLASS_FREELIST_MAX instances per class are kept instead, for reuse
+ * by the next instantiation of the same class.
+ */
+static void ClassInstanceFree(ph7_class_instance *pThis) {
+	ph7_class *pClass = pThis->pClass;
+	if(pClass->nFreeList < PH7_CLASS_FREELIST_MAX) {
+		pThis->pNextFree = pClass->pFreeList;
+		pClass->pFreeList = pThis;
+		pClass->nFreeList++;
+		return;
+	}
+	ClassInstanceFreeTable(&(*pThis));
+}
 /*
  * Release a class instance [i.e: Object in the PHP jargon] and invoke any defined destructor.
- * This routine is invoked as soon as there are no other references to a particular
- * class instance.
+ * This routine is called directly for deferred releases, see PH7_VmReleaseDeferred().
  */
-static void PH7_ClassInstanceRelease(ph7_class_instance *pThis) {
+PH7_PRIVATE void PH7_ClassInstanceDestroy(ph7_class_instance *pThis) {
 	ph7_class_method *pDestr;
-	SyHashEntry *pEntry;
-	ph7_class *pClass;
-	ph7_vm *pVm;
 	if(pThis->iFlags & CLASS_INSTANCE_DESTROYED) {
 		/*
 		 * Already destroyed, return immediately.
@@ -680,31 +779,43 @@ static void PH7_ClassInstanceRelease(ph7_class_instance *pThis) {
 	}
 	/* Mark as destroyed */
 	pThis->iFlags |= CLASS_INSTANCE_DESTROYED;
+	ClassInstanceUnbuffer(&(*pThis));
 	/* Invoke any defined destructor if available */
-	pVm = pThis->pVm;
-	pClass = pThis->pClass;
-	pDestr = PH7_ClassExtractMethod(pClass, "__destruct", sizeof("__destruct") - 1);
-	if(pDestr) {
+	pDestr = PH7_ClassExtractMethod(pThis->pClass, "__destruct", sizeof("__destruct") - 1);
+	if(pDestr && (pThis->iFlags & CLASS_INSTANCE_DESTRUCTED) == 0) {
 		/* Invoke the destructor */
 		pThis->iRef = 2; /* Prevent garbage collection */
-		PH7_VmCallClassMethod(pVm, pThis, pDestr, 0, 0, 0);
+		PH7_VmCallClassMethod(pThis->pVm, pThis, pDestr, 0, 0, 0);
 	}
 	/* Release non-static attributes */
-	SyHashResetLoopCursor(&pThis->hAttr);
-	while((pEntry = SyHashGetNextEntry(&pThis->hAttr)) != 0) {
-		VmClassAttr *pVmAttr = (VmClassAttr *)pEntry->pUserData;
-		if((pVmAttr->pAttr->iFlags & (PH7_CLASS_ATTR_STATIC | PH7_CLASS_ATTR_CONSTANT)) == 0) {
-			PH7_VmUnsetMemObj(pVm, pVmAttr->nIdx, TRUE);
-		}
-		SyMemBackendPoolFree(&pVm->sAllocator, pVmAttr);
-	}
+	ClassInstanceReleaseAttr(&(*pThis));
 	/* Release the whole structure */
-	SyHashRelease(&pThis->hAttr);
-	SyMemBackendPoolFree(&pVm->sAllocator, pThis);
+	ClassInstanceFree(&(*pThis));
+}
+/*
+ * This routine is invoked as soon as there are no other references to a particular
+ * class instance. Instances nested too deeply are queued, and released at the next
+ * safe point rather than recursively.
+ */
+static void PH7_ClassInstanceRelease(ph7_class_instance *pThis) {
+	ph7_vm *pVm = pThis->pVm;
+	if(pThis->iFlags & CLASS_INSTANCE_DESTROYED) {
+		return;
+	}
+	if(pVm->nFreeDepth >= PH7_FREE_DEPTH_LIMIT && PH7_VmDeferRelease(&(*pVm), pThis, MEMOBJ_OBJ) == SXRET_OK) {
+		/* Not a possible root anymore */
+		ClassInstanceUnbuffer(&(*pThis));
+		return;
+	}
+	pVm->nFreeDepth++;
+	PH7_ClassInstanceDestroy(&(*pThis));
+	pVm->nFreeDepth--;
 }
 /*
  * Decrement the reference count of a class instance [i.e Object in the PHP jargon].
  * If the reference count reaches zero,release the whole instance.
+ * Otherwise the remaining references may all come from a garbage cycle, so the
+ * instance is recorded as a possible root for the cycle collector.
  */
 PH7_PRIVATE void PH7_ClassInstanceUnref(ph7_class_instance *pThis) {
 	if(pThis) {
@@ -712,8 +823,346 @@ PH7_PRIVATE void PH7_ClassInstanceUnref(ph7_class_instance *pThis) {
 		if(pThis->iRef < 1) {
 			/* No more reference to this instance */
 			PH7_ClassInstanceRelease(&(*pThis));
+		} else if((pThis->iFlags & (CLASS_INSTANCE_DESTROYED | CLASS_INSTANCE_BUFFERED)) == 0) {
+			ph7_vm *pVm = pThis->pVm;
+			pThis->nGcRoot = SySetUsed(&pVm->aGcRoot);
+			if(SySetPut(&pVm->aGcRoot, (const void *)&pThis) == SXRET_OK) {
+				pThis->iFlags |= CLASS_INSTANCE_BUFFERED;
+			}
+		}
+	}
+}
+/*
+ * Cycle collector.
+ * Reference counting alone never release class instances referring to each other
+ * [i.e: parent/child links]. Possible roots of such cycles are recorded by
+ * PH7_ClassInstanceUnref() and processed in batches using trial deletion
+ * [Bacon & Rajan, Concurrent Cycle Collection in Reference Counted Systems]:
+ * references held inside the subgraph reachable from the roots are subtracted,
+ * instances whose count drops to zero are only referenced by garbage and released.
+ * Arrays are copied on assignment, so a hashmap referenced once belongs to the value
+ * holding it and its entries are scanned as if they were attributes. Shared hashmaps
+ * [i.e: loaded on the operand stack] are not scanned which only keeps their contents alive.
+ */
+typedef void (*ProcGcVisit)(ph7_class_instance *, SySet *);
+/*
+ * Monotonic enough clock used to enforce the cycle collector time slice.
+ * Return the current time in microseconds [wraps around].
+ */
+static sxu32 ClassInstanceGcClock(void) {
+#if defined(__UNIXES__)
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (sxu32)tv.tv_sec * SX_USEC_PER_SEC + (sxu32)tv.tv_usec;
+#elif defined(__WINNT__)
+	return (sxu32)GetTickCount() * 1000;
+#else
+	/* No clock available, collections always run to completion */
+	return 0;
+#endif /* __UNIXES__ */
+}
+/*
+ * Invoke the given callback for each class instance referenced by a value.
+ */
+static void ClassInstanceGcVisitValue(ph7_vm *pVm, ph7_value *pValue, ProcGcVisit xVisit, SySet *pWork) {
+	if(pValue == 0 || (pValue->nType & MEMOBJ_NULL) || pValue->x.pOther == 0) {
+		return;
+	}
+	if(pValue->nType & MEMOBJ_HASHMAP) {
+		ph7_hashmap *pMap = (ph7_hashmap *)pValue->x.pOther;
+		ph7_hashmap_node *pNode;
+		sxu32 n;
+		if(pMap->iRef > 1) {
+			/* Shared hashmap, treat as an external reference */
+			return;
+		}
+		pNode = pMap->pFirst;
+		for(n = 0 ; n < pMap->nEntry ; ++n) {
+			ClassInstanceGcVisitValue(&(*pVm), PH7_VmMemObjAt(pVm, pNode->nValIdx), xVisit, pWork);
+			/* Point to the next entry */
+			pNode = pNode->pPrev; /* Reverse link */
+		}
+	} else if(pValue->nType & MEMOBJ_OBJ) {
+		ph7_class_instance *pChild = (ph7_class_instance *)pValue->x.pOther;
+		if((pChild->iFlags & CLASS_INSTANCE_DESTROYED) == 0) {
+			xVisit(pChild, pWork);
+		}
+	}
+}
+/*
+ * Invoke the given callback for each class instance referenced by the non-static
+ * attributes of a class instance. The attribute table cursor is preserved.
+ */
+static void ClassInstanceGcVisitChildren(ph7_class_instance *pThis, ProcGcVisit xVisit, SySet *pWork) {
+	SyHashEntry_Pr *pCursor = pThis->hAttr.pCurrent;
+	ph7_vm *pVm = pThis->pVm;
+	SyHashEntry *pEntry;
+	SyHashResetLoopCursor(&pThis->hAttr);
+	while((pEntry = SyHashGetNextEntry(&pThis->hAttr)) != 0) {
+		VmClassAttr *pVmAttr = (VmClassAttr *)pEntry->pUserData;
+		if((pVmAttr->pAttr->iFlags & (PH7_CLASS_ATTR_STATIC | PH7_CLASS_ATTR_CONSTANT)) == 0) {
+			ClassInstanceGcVisitValue(&(*pVm), PH7_VmMemObjAt(pVm, pVmAttr->nIdx), xVisit, pWork);
+		}
+	}
+	pThis->hAttr.pCurrent = pCursor;
+}
+static void ClassInstanceGcMarkGray(ph7_class_instance *pChild, SySet *pWork) {
+	pChild->iRef--;
+	if((pChild->iFlags & CLASS_INSTANCE_GRAY) == 0) {
+		pChild->iFlags |= CLASS_INSTANCE_GRAY;
+		SySetPut(pWork, (const void *)&pChild);
+	}
+}
+static void ClassInstanceGcScanChild(ph7_class_instance *pChild, SySet *pWork) {
+	SySetPut(pWork, (const void *)&pChild);
+}
+static void ClassInstanceGcScanBlack(ph7_class_instance *pChild, SySet *pWork) {
+	pChild->iRef++;
+	if(pChild->iFlags & (CLASS_INSTANCE_GRAY | CLASS_INSTANCE_WHITE)) {
+		pChild->iFlags &= ~(CLASS_INSTANCE_GRAY | CLASS_INSTANCE_WHITE);
+		SySetPut(pWork, (const void *)&pChild);
+	}
+}
+static void ClassInstanceGcCollectWhite(ph7_class_instance *pChild, SySet *pWork) {
+	if(pChild->iFlags & CLASS_INSTANCE_WHITE) {
+		pChild->iFlags &= ~CLASS_INSTANCE_WHITE;
+		SySetPut(pWork, (const void *)&pChild);
+	}
+}
+static void ClassInstanceGcRestore(ph7_class_instance *pChild, SySet *pWork) {
+	SXUNUSED(pWork); /* cc warning */
+	pChild->iRef++;
+}
+/*
+ * Invoke the given callback for the children of each instance in the work
+ * stack until it is empty.
+ */
+static void ClassInstanceGcDrain(SySet *pWork, ProcGcVisit xVisit, SySet *pOut) {
+	ph7_class_instance **apEntry;
+	while((apEntry = (ph7_class_instance **)SySetPop(pWork)) != 0) {
+		ph7_class_instance *pThis = apEntry[0];
+		if(pOut) {
+			SySetPut(pOut, (const void *)&pThis);
+		}
+		ClassInstanceGcVisitChildren(pThis, xVisit, pWork);
+	}
+}
+/*
+ * Undo an interrupted subtraction of the internal references. The program did not
+ * run meanwhile, so the walked instances still have the same children.
+ */
+static void ClassInstanceGcUndoMark(SySet *pGray, SySet *pWork) {
+	ph7_class_instance **apEntry;
+	sxu32 n;
+	/* Walked instances */
+	apEntry = (ph7_class_instance **)SySetBasePtr(pGray);
+	for(n = 0 ; n < SySetUsed(pGray) ; ++n) {
+		ClassInstanceGcVisitChildren(apEntry[n], ClassInstanceGcRestore, 0);
+	}
+	for(n = 0 ; n < SySetUsed(pGray) ; ++n) {
+		apEntry[n]->iFlags &= ~CLASS_INSTANCE_GRAY;
+	}
+	/* Reached but not walked yet */
+	apEntry = (ph7_class_instance **)SySetBasePtr(pWork);
+	for(n = 0 ; n < SySetUsed(pWork) ; ++n) {
+		apEntry[n]->iFlags &= ~CLASS_INSTANCE_GRAY;
+	}
+}
+/*
+ * Perform trial deletion on a batch of possible roots and release the garbage.
+ * The clock is checked while walking the subgraph reachable from the roots: once half
+ * of the given time slice starting at nStart is consumed [undoing the walk takes about
+ * as long], the walk is undone and SXERR_ABORT is returned. A zero budget means no limit.
+ * Otherwise SXRET_OK is returned and the total number of released instances is written
+ * to pFree.
+ */
+static sxi32 ClassInstanceGcCollect(ph7_vm *pVm, SySet *pRoots, sxu32 nStart, sxu32 nBudget, sxu32 *pFree) {
+	ph7_class_instance **apRoot, **apGarbage, **apEntry;
+	SySet sWork, sGray, sBlack, sGarbage;
+	ph7_class_method *pDestr;
+	sxbool bDestr = FALSE;
+	sxu32 n, nGarbage;
+	SySetInit(&sWork, &pVm->sArena, sizeof(ph7_class_instance *));
+	SySetInit(&sGray, &pVm->sArena, sizeof(ph7_class_instance *));
+	SySetInit(&sBlack, &pVm->sArena, sizeof(ph7_class_instance *));
+	SySetInit(&sGarbage, &pVm->sArena, sizeof(ph7_class_instance *));
+	apRoot = (ph7_class_instance **)SySetBasePtr(pRoots);
+	/* Subtract the internal references */
+	for(n = 0 ; n < SySetUsed(pRoots) ; ++n) {
+		if(apRoot[n]->iFlags & CLASS_INSTANCE_GRAY) {
+			continue;
+		}
+		apRoot[n]->iFlags |= CLASS_INSTANCE_GRAY;
+		SySetPut(&sWork, (const void *)&apRoot[n]);
+		while((apEntry = (ph7_class_instance **)SySetPop(&sWork)) != 0) {
+			ph7_class_instance *pThis = apEntry[0];
+			SySetPut(&sGray, (const void *)&pThis);
+			ClassInstanceGcVisitChildren(pThis, ClassInstanceGcMarkGray, &sWork);
+			if(nBudget > 0 && (SySetUsed(&sGray) % PH7_GC_CLOCK_STRIDE) == 0 &&
+					(ClassInstanceGcClock() - nStart) * 2 >= nBudget) {
+				/* Time slice expired, leave the batch for a later collection */
+				ClassInstanceGcUndoMark(&sGray, &sWork);
+				SySetRelease(&sWork);
+				SySetRelease(&sGray);
+				SySetRelease(&sBlack);
+				SySetRelease(&sGarbage);
+				return SXERR_ABORT;
+			}
+		}
+	}
+	SySetRelease(&sGray);
+	/* Instances still referenced from outside are live, so is anything they reach */
+	for(n = 0 ; n < SySetUsed(pRoots) ; ++n) {
+		SySetPut(&sWork, (const void *)&apRoot[n]);
+		while((apEntry = (ph7_class_instance **)SySetPop(&sWork)) != 0) {
+			ph7_class_instance *pThis = apEntry[0];
+			if((pThis->iFlags & CLASS_INSTANCE_GRAY) == 0) {
+				continue;
+			}
+			pThis->iFlags &= ~CLASS_INSTANCE_GRAY;
+			if(pThis->iRef > 0) {
+				SySetPut(&sBlack, (const void *)&pThis);
+				ClassInstanceGcDrain(&sBlack, ClassInstanceGcScanBlack, 0);
+			} else {
+				pThis->iFlags |= CLASS_INSTANCE_WHITE;
+				ClassInstanceGcVisitChildren(pThis, ClassInstanceGcScanChild, &sWork);
+			}
+		}
+	}
+	/* Gather the garbage and restore the reference counts */
+	for(n = 0 ; n < SySetUsed(pRoots) ; ++n) {
+		if(apRoot[n]->iFlags & CLASS_INSTANCE_WHITE) {
+			apRoot[n]->iFlags &= ~CLASS_INSTANCE_WHITE;
+			SySetPut(&sWork, (const void *)&apRoot[n]);
+			ClassInstanceGcDrain(&sWork, ClassInstanceGcCollectWhite, &sGarbage);
+		}
+	}
+	nGarbage = SySetUsed(&sGarbage);
+	apGarbage = (ph7_class_instance **)SySetBasePtr(&sGarbage);
+	for(n = 0 ; n < nGarbage ; ++n) {
+		ClassInstanceGcVisitChildren(apGarbage[n], ClassInstanceGcRestore, 0);
+		ClassInstanceUnbuffer(apGarbage[n]);
+		if((apGarbage[n]->iFlags & CLASS_INSTANCE_DESTRUCTED) == 0 &&
+				PH7_ClassExtractMethod(apGarbage[n]->pClass, "__destruct", sizeof("__destruct") - 1)) {
+			bDestr = TRUE;
+		}
+	}
+	if(bDestr) {
+		/*
+		 * Destructors may resurrect any instance of the cycle, so invoke them first while
+		 * the whole cycle is pinned. Then unpin it, the instances are recorded again as
+		 * possible roots and released by a later collection unless they were resurrected.
+		 */
+		for(n = 0 ; n < nGarbage ; ++n) {
+			apGarbage[n]->iRef++;
+		}
+		for(n = 0 ; n < nGarbage ; ++n) {
+			if((apGarbage[n]->iFlags & CLASS_INSTANCE_DESTRUCTED) == 0) {
+				apGarbage[n]->iFlags |= CLASS_INSTANCE_DESTRUCTED;
+				pDestr = PH7_ClassExtractMethod(apGarbage[n]->pClass, "__destruct", sizeof("__destruct") - 1);
+				if(pDestr) {
+					PH7_VmCallClassMethod(&(*pVm), apGarbage[n], pDestr, 0, 0, 0);
+				}
+			}
+		}
+		for(n = 0 ; n < nGarbage ; ++n) {
+			PH7_ClassInstanceUnref(apGarbage[n]);
+		}
+		nGarbage = 0;
+	} else {
+		/* Break the cycles first so that no instance is freed while still referenced */
+		for(n = 0 ; n < nGarbage ; ++n) {
+			apGarbage[n]->iFlags |= CLASS_INSTANCE_DESTROYED;
+		}
+		for(n = 0 ; n < nGarbage ; ++n) {
+			ClassInstanceReleaseAttr(apGarbage[n]);
+		}
+		for(n = 0 ; n < nGarbage ; ++n) {
+			ClassInstanceFree(apGarbage[n]);
+		}
+	}
+	SySetRelease(&sWork);
+	SySetRelease(&sBlack);
+	SySetRelease(&sGarbage);
+	*pFree = nGarbage;
+	return SXRET_OK;
+}
+/*
+ * Record again a batch of roots whose collection was interrupted. They are moved to
+ * the bottom of the root buffer, so that the other roots are processed first.
+ */
+static void ClassInstanceGcRequeue(ph7_vm *pVm, SySet *pRoots) {
+	ph7_class_instance **apRoot, **apBuffer, *pSwap;
+	sxu32 n, nLast;
+	apRoot = (ph7_class_instance **)SySetBasePtr(pRoots);
+	for(n = 0 ; n < SySetUsed(pRoots) ; ++n) {
+		ph7_class_instance *pThis = apRoot[n];
+		if(SySetPut(&pVm->aGcRoot, (const void *)&pThis) != SXRET_OK) {
+			continue;
+		}
+		/* Swap with the n-th oldest root */
+		apBuffer = (ph7_class_instance **)SySetBasePtr(&pVm->aGcRoot);
+		nLast = SySetUsed(&pVm->aGcRoot) - 1;
+		pSwap = apBuffer[n];
+		apBuffer[n] = pThis;
+		apBuffer[nLast] = pSwap;
+		pThis->nGcRoot = n;
+		pThis->iFlags |= CLASS_INSTANCE_BUFFERED;
+		if(pSwap) {
+			pSwap->nGcRoot = nLast;
+		}
+	}
+}
+/*
+ * Collect the garbage cycles among the recorded possible roots.
+ * The roots are processed in batches until there is none left or the given time
+ * slice in microseconds expires [0 for no limit], the remaining roots are left
+ * for the next collection. A batch whose walk does not fit in the time slice
+ * [i.e: Large live object graph] is retried once the other roots were processed,
+ * large garbage graphs are hence only released by an unbounded collection.
+ * Return the total number of released class instances.
+ */
+PH7_PRIVATE sxu32 PH7_ClassInstanceCollectCycles(ph7_vm *pVm, sxu32 nBudget) {
+	ph7_class_instance **apEntry;
+	sxu32 nStart, nCollected, nFree = 0;
+	SySet sRoots;
+	if(pVm->bGcRun) {
+		/* Invoked from a destructor */
+		return 0;
+	}
+	pVm->bGcRun = TRUE;
+	nStart = ClassInstanceGcClock();
+	SySetInit(&sRoots, &pVm->sArena, sizeof(ph7_class_instance *));
+	for(;;) {
+		SySetReset(&sRoots);
+		while(SySetUsed(&sRoots) < PH7_GC_ROOT_BATCH) {
+			apEntry = (ph7_class_instance **)SySetPop(&pVm->aGcRoot);
+			if(apEntry == 0) {
+				break;
+			}
+			if(apEntry[0]) {
+				ph7_class_instance *pRoot = apEntry[0];
+				pRoot->iFlags &= ~CLASS_INSTANCE_BUFFERED;
+				SySetPut(&sRoots, (const void *)&pRoot);
+			}
+		}
+		if(SySetUsed(&sRoots) < 1) {
+			break;
+		}
+		if(ClassInstanceGcCollect(&(*pVm), &sRoots, nStart, nBudget, &nCollected) != SXRET_OK) {
+			/* Time slice expired while walking the batch */
+			ClassInstanceGcRequeue(&(*pVm), &sRoots);
+			break;
+		}
+		nFree += nCollected;
+		if(nBudget > 0 && ClassInstanceGcClock() - nStart >= nBudget) {
+			/* Time slice expired */
+			break;
 		}
 	}
+	SySetRelease(&sRoots);
+	pVm->bGcRun = FALSE;
+	return nFree;
 }
 /*
  * Compare two class instances [i.e: Objects in the PHP jargon]
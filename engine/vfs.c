@@ -8,6 +8,7 @@
  *              David Carlier <devnexen@gmail.com>
  */ 
 #include "ph7int.h"
+#include <time.h>
 /*
  * Given a string containing the path of a file or directory, this function
  * return the parent directory's path.
@@ -77,6 +78,10 @@ static int PH7_vfs_chdir(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 	zPath = ph7_value_to_string(apArg[0], 0);
 	/* Perform the requested operation */
 	rc = pVfs->xChdir(zPath);
+	if(rc == PH7_OK) {
+		/* Resolutions relative to the old directory are now unreachable, release them */
+		PH7_PathCacheFlush(pCtx->pVm->pEngine);
+	}
 	/* IO return value */
 	ph7_result_bool(pCtx, rc == PH7_OK);
 	return PH7_OK;
@@ -114,6 +119,10 @@ static int PH7_vfs_chroot(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 	zPath = ph7_value_to_string(apArg[0], 0);
 	/* Perform the requested operation */
 	rc = pVfs->xChroot(zPath);
+	if(rc == PH7_OK) {
+		/* Cached include path resolutions are relative to the old root */
+		PH7_PathCacheFlush(pCtx->pVm->pEngine);
+	}
 	/* IO return value */
 	ph7_result_bool(pCtx, rc == PH7_OK);
 	return PH7_OK;
@@ -2946,6 +2955,108 @@ static ph7_int64 StreamReadLine(io_private *pDev, const char **pzData, ph7_int64
 	}
 	return n;
 }
+/*
+ * Include path resolution cache.
+ * Resolving a relative include probes every import path then canonicalize the file found,
+ * which costs several system calls [i.e: open(), stat(), readlink()] per inclusion.
+ * Successful resolutions are cached per engine for PH7_CONFIG_PATH_CACHE_TTL seconds and
+ * keyed by the searched name, the import paths and the working directory.
+ */
+static sxi32 VmPathCacheKey(ph7_vm *pVm, const SyString *pFile, int bSearch, SyBlob *pKey) {
+	ph7 *pEngine = pVm->pEngine;
+	char zCwd[PATH_MAX + 1];
+	SyString *pPath;
+	sxu32 n;
+	if(pEngine->xConf.nPathTTL < 1) {
+		/* Cache disabled */
+		return SXERR_NOTIMPLEMENTED;
+	}
+	SyBlobAppend(pKey, (const void *)pFile->zString, pFile->nByte);
+	if(!bSearch) {
+		/* Absolute path */
+		return SXRET_OK;
+	}
+	pPath = (SyString *)SySetBasePtr(&pVm->aPaths);
+	for(n = 0 ; n < SySetUsed(&pVm->aPaths) ; ++n) {
+		SyBlobAppend(pKey, (const void *)"\n", sizeof(char));
+		SyBlobAppend(pKey, (const void *)pPath[n].zString, pPath[n].nByte);
+	}
+	/*
+	 * Relative import paths depend on the working directory. Query it on each lookup
+	 * since the host application may change it behind our back.
+	 */
+	if(SyGetCwd(zCwd, sizeof(zCwd)) != PH7_OK) {
+		return SXERR_IO;
+	}
+	SyBlobAppend(pKey, (const void *)"\n", sizeof(char));
+	SyBlobAppend(pKey, (const void *)zCwd, SyStrlen(zCwd));
+	return SXRET_OK;
+}
+static void VmPathCacheDrop(ph7 *pEngine, SyBlob *pKey) {
+	ph7_path_entry *pEntry;
+	SyHashEntry *pHashEntry;
+	void *pEntryKey;
+	pHashEntry = SyHashGet(&pEngine->hPath, SyBlobData(pKey), SyBlobLength(pKey));
+	if(pHashEntry == 0) {
+		return;
+	}
+	pEntry = (ph7_path_entry *)pHashEntry->pUserData;
+	pEntryKey = (void *)pHashEntry->pKey;
+	SyHashDeleteEntry2(pHashEntry);
+	SyMemBackendFree(&pEngine->sAllocator, pEntryKey);
+	SyMemBackendFree(&pEngine->sAllocator, (void *)pEntry->sReal.zString);
+	SyMemBackendPoolFree(&pEngine->sAllocator, pEntry);
+}
+static const SyString *VmPathCacheFind(ph7 *pEngine, SyBlob *pKey) {
+	ph7_path_entry *pEntry;
+	SyHashEntry *pHashEntry;
+	pHashEntry = SyHashGet(&pEngine->hPath, SyBlobData(pKey), SyBlobLength(pKey));
+	if(pHashEntry == 0) {
+		return 0;
+	}
+	pEntry = (ph7_path_entry *)pHashEntry->pUserData;
+	if((sxi64)time(0) - pEntry->nStamp >= (sxi64)pEngine->xConf.nPathTTL) {
+		/* Expired entry */
+		VmPathCacheDrop(&(*pEngine), &(*pKey));
+		return 0;
+	}
+	return &pEntry->sReal;
+}
+static void VmPathCacheInsert(ph7 *pEngine, SyBlob *pKey, const char *zReal) {
+	ph7_path_entry *pEntry;
+	char *zKey;
+	pEntry = (ph7_path_entry *)SyMemBackendPoolAlloc(&pEngine->sAllocator, sizeof(ph7_path_entry));
+	if(pEntry == 0) {
+		return;
+	}
+	zKey = SyMemBackendDup(&pEngine->sAllocator, SyBlobData(pKey), SyBlobLength(pKey));
+	pEntry->sReal.nByte = SyStrlen(zReal);
+	pEntry->sReal.zString = SyMemBackendStrDup(&pEngine->sAllocator, zReal, pEntry->sReal.nByte);
+	pEntry->nStamp = (sxi64)time(0);
+	if(zKey == 0 || pEntry->sReal.zString == 0 ||
+			SyHashInsert(&pEngine->hPath, (const void *)zKey, SyBlobLength(pKey), pEntry) != SXRET_OK) {
+		/* Out of memory, ignore */
+		SyMemBackendFree(&pEngine->sAllocator, zKey);
+		SyMemBackendFree(&pEngine->sAllocator, (void *)pEntry->sReal.zString);
+		SyMemBackendPoolFree(&pEngine->sAllocator, pEntry);
+	}
+}
+/*
+ * Forget every cached include path resolution [i.e: after the root directory change].
+ */
+PH7_PRIVATE void PH7_PathCacheFlush(ph7 *pEngine) {
+	ph7_path_entry *pEntry;
+	SyHashEntry *pHashEntry;
+	SyHashResetLoopCursor(&pEngine->hPath);
+	while((pHashEntry = SyHashGetNextEntry(&pEngine->hPath)) != 0) {
+		pEntry = (ph7_path_entry *)pHashEntry->pUserData;
+		SyMemBackendFree(&pEngine->sAllocator, (void *)pHashEntry->pKey);
+		SyMemBackendFree(&pEngine->sAllocator, (void *)pEntry->sReal.zString);
+		SyMemBackendPoolFree(&pEngine->sAllocator, pEntry);
+	}
+	SyHashRelease(&pEngine->hPath);
+	SyHashInit(&pEngine->hPath, &pEngine->sAllocator, 0, 0);
+}
 /*
  * Open an IO stream handle.
  * Notes on stream:
@@ -2979,13 +3090,36 @@ PH7_PRIVATE void *PH7_StreamOpenHandle(ph7_vm *pVm, const ph7_io_stream *pStream
 	}
 	SyStringInitFromBuf(&sFile, zFile, SyStrlen(zFile));
 	if(use_include) {
-		if(sFile.zString[0] == '/'
+		const SyString *pReal = 0;
+		int bAbsolute, bResolved;
+		SyBlob sKey;
+		bAbsolute = sFile.zString[0] == '/'
 #ifdef __WINNT__
-				|| (sFile.nByte > 2 && sFile.zString[1] == ':' && (sFile.zString[2] == '\\' || sFile.zString[2] == '/'))
+					|| (sFile.nByte > 2 && sFile.zString[1] == ':' && (sFile.zString[2] == '\\' || sFile.zString[2] == '/'))
 #endif
-				) {
+					;
+		SyBlobInit(&sKey, &pVm->sAllocator);
+		bResolved = FALSE;
+		rc = SXERR_IO;
+		if(pStream == pVm->pDefStream && VmPathCacheKey(&(*pVm), &sFile, !bAbsolute, &sKey) == SXRET_OK) {
+			pReal = VmPathCacheFind(pVm->pEngine, &sKey);
+		}
+		if(pReal && pReal->nByte < sizeof(sFilePath)) {
+			/* Resolved recently, open the canonical path directly */
+			SyMemcpy((const void *)pReal->zString, sFilePath, pReal->nByte);
+			sFilePath[pReal->nByte] = 0;
+			rc = pStream->xOpen(sFilePath, iFlags, pResource, &pHandle);
+			if(rc != PH7_OK) {
+				/* Moved or removed, resolve it again */
+				VmPathCacheDrop(pVm->pEngine, &sKey);
+				pReal = 0;
+			}
+		}
+		if(pReal) {
+			/* Already resolved */
+		} else if(bAbsolute) {
 			/* Get real path to the included file */
-			SyRealPath(zFile, sFilePath);
+			bResolved = SyRealPath(zFile, sFilePath) == PH7_OK;
 			/* Open the file directly */
 			rc = pStream->xOpen(zFile, iFlags, pResource, &pHandle);
 		} else {
@@ -3012,7 +3146,7 @@ PH7_PRIVATE void *PH7_StreamOpenHandle(ph7_vm *pVm, const ph7_io_stream *pStream
 				rc = pStream->xOpen((const char *)SyBlobData(&sWorker), iFlags, pResource, &pHandle);
 				if(rc == PH7_OK) {
 					/* Get real path to the included file */
-					SyRealPath((const char *)SyBlobData(&sWorker), sFilePath);
+					bResolved = SyRealPath((const char *)SyBlobData(&sWorker), sFilePath) == PH7_OK;
 					break;
 				}
 				/* Reset the working buffer */
@@ -3021,6 +3155,11 @@ PH7_PRIVATE void *PH7_StreamOpenHandle(ph7_vm *pVm, const ph7_io_stream *pStream
 			}
 			SyBlobRelease(&sWorker);
 		}
+		if(rc == PH7_OK && bResolved && SyBlobLength(&sKey) > 0) {
+			/* Remember where the file was found */
+			VmPathCacheInsert(pVm->pEngine, &sKey, sFilePath);
+		}
+		SyBlobRelease(&sKey);
 		if(rc == PH7_OK) {
 			if(bPushInclude) {
 				/* Mark as included */
@@ -7925,10 +8064,9 @@ static int is_php_stream(const ph7_io_stream *pStream) {
 	return pStream == &sPHP_Stream;
 }
 /*
- * Export the IO routines defined above and the built-in IO streams
- * [i.e: file://,php://].
+ * Register the IO routines defined above in the table shared by all VMs.
  */
-PH7_PRIVATE sxi32 PH7_RegisterIORoutine(ph7_vm *pVm) {
+PH7_PRIVATE sxi32 PH7_RegisterIOFunctions(ph7_builtin_table *pTable) {
 	/* VFS functions */
 	static const ph7_builtin_func aVfsFunc[] = {
 		{"chdir",   PH7_vfs_chdir   },
@@ -8030,15 +8168,19 @@ PH7_PRIVATE sxi32 PH7_RegisterIORoutine(ph7_vm *pVm) {
 		{"parse_ini_file", PH7_builtin_parse_ini_file},
 		{"vfprintf",  PH7_builtin_vfprintf}
 	};
-	const ph7_io_stream *pFileStream = 0;
-	sxu32 n = 0;
+	sxi32 rc;
 	/* Register the functions defined above */
-	for(n = 0 ; n < SX_ARRAYSIZE(aVfsFunc) ; ++n) {
-		ph7_create_function(&(*pVm), aVfsFunc[n].zName, aVfsFunc[n].xFunc, (void *)pVm->pEngine->pVfs);
-	}
-	for(n = 0 ; n < SX_ARRAYSIZE(aIOFunc) ; ++n) {
-		ph7_create_function(&(*pVm), aIOFunc[n].zName, aIOFunc[n].xFunc, pVm);
+	rc = PH7_BuiltinTableAddFunc(&(*pTable), aVfsFunc, SX_ARRAYSIZE(aVfsFunc), PH7_BUILTIN_DATA_VFS);
+	if(rc != SXRET_OK) {
+		return rc;
 	}
+	return PH7_BuiltinTableAddFunc(&(*pTable), aIOFunc, SX_ARRAYSIZE(aIOFunc), PH7_BUILTIN_DATA_VM);
+}
+/*
+ * Export the built-in IO streams [i.e: file://,php://].
+ */
+PH7_PRIVATE sxi32 PH7_RegisterIORoutine(ph7_vm *pVm) {
+	const ph7_io_stream *pFileStream = 0;
 	/* Register the file stream if available */
 #ifdef __WINNT__
 	pFileStream = &sWinFileStream;
@@ -8,6 +8,17 @@
  *              David Carlier <devnexen@gmail.com>
  */
 #include "ph7int.h"
+#ifdef PH7_STATIC_MODULE_LIST
+/* Entry points of the modules linked into the library */
+#define PH7_MODULE(NAME) PH7_PRIVATE sxi32 PH7_MODULE_INIT(NAME)(ph7_vm *pVm, ph7_real *ver, SyString *desc);
+PH7_STATIC_MODULE_LIST
+#undef PH7_MODULE
+#define PH7_MODULE(NAME) { #NAME, PH7_MODULE_INIT(NAME) },
+static const VmStaticModule aStaticModules[] = {
+	PH7_STATIC_MODULE_LIST
+};
+#undef PH7_MODULE
+#endif
 
 /*
  * Each parsed URI is recorded and stored in an instance of the following structure.
@@ -73,6 +84,7 @@ PH7_PRIVATE sxi32 PH7_VmRegisterConstant(
 	void *pUserData,        /* Last argument to xExpand() */
 	sxbool bGlobal          /* Whether this is a global constant or not */
 ) {
+	SyMemBackend *pAllocator;
 	ph7_constant *pCons;
 	SyHash *pCollection;
 	SyHashEntry *pEntry;
@@ -80,21 +92,28 @@ PH7_PRIVATE sxi32 PH7_VmRegisterConstant(
 	sxi32 rc;
 	if(bGlobal) {
 		pCollection = &pVm->hConstant;
+		pAllocator = &pVm->sAllocator;
 	} else {
+		/* Local constants go away with their frame */
 		pCollection = &pVm->pFrame->hConst;
+		pAllocator = &pVm->sArena;
 	}
 	pEntry = SyHashGet(pCollection, (const void *)pName->zString, pName->nByte);
-	if(pEntry) {
+	if(pEntry && pEntry->pUserData) {
 		/* Constant already exists */
 		return SXERR_EXISTS;
 	}
+	if(pEntry == 0 && bGlobal && SyHashGet(&pVm->pEngine->pBuiltin->hConst, (const void *)pName->zString, pName->nByte)) {
+		/* Built-in constant */
+		return SXERR_EXISTS;
+	}
 	/* Allocate a new constant instance */
-	pCons = (ph7_constant *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(ph7_constant));
+	pCons = (ph7_constant *)SyMemBackendPoolAlloc(pAllocator, sizeof(ph7_constant));
 	if(pCons == 0) {
 		PH7_VmMemoryError(&(*pVm));
 	}
 	/* Duplicate constant name */
-	zDupName = SyMemBackendStrDup(&pVm->sAllocator, pName->zString, pName->nByte);
+	zDupName = SyMemBackendStrDup(pAllocator, pName->zString, pName->nByte);
 	if(zDupName == 0) {
 		PH7_VmMemoryError(&(*pVm));
 	}
@@ -102,6 +121,11 @@ PH7_PRIVATE sxi32 PH7_VmRegisterConstant(
 	SyStringInitFromBuf(&pCons->sName, zDupName, pName->nByte);
 	pCons->xExpand = xExpand;
 	pCons->pUserData = pUserData;
+	if(pEntry) {
+		/* Redefine a deleted built-in constant */
+		pEntry->pUserData = pCons;
+		return SXRET_OK;
+	}
 	rc = SyHashInsert(pCollection, (const void *)zDupName, SyStringLength(&pCons->sName), pCons);
 	if(rc != SXRET_OK) {
 		PH7_VmMemoryError(&(*pVm));
@@ -167,7 +191,7 @@ PH7_PRIVATE sxi32 PH7_VmInstallForeignFunction(
 	sxi32 rc;
 	/* Overwrite any previously registered function with the same name */
 	pEntry = SyHashGet(&pVm->hHostFunction, pName->zString, pName->nByte);
-	if(pEntry) {
+	if(pEntry && pEntry->pUserData) {
 		pFunc = (ph7_user_func *)pEntry->pUserData;
 		pFunc->pUserData = pUserData;
 		pFunc->xFunc = xFunc;
@@ -179,6 +203,11 @@ PH7_PRIVATE sxi32 PH7_VmInstallForeignFunction(
 	if(rc != SXRET_OK) {
 		return rc;
 	}
+	if(pEntry) {
+		/* Redefine a deleted built-in function */
+		pEntry->pUserData = pFunc;
+		return SXRET_OK;
+	}
 	/* Install the function in the corresponding hashtable */
 	rc = SyHashInsert(&pVm->hHostFunction, SyStringData(&pFunc->sName), pName->nByte, pFunc);
 	if(rc != SXRET_OK) {
@@ -189,6 +218,138 @@ PH7_PRIVATE sxi32 PH7_VmInstallForeignFunction(
 	/* User function successfully installed */
 	return SXRET_OK;
 }
+/*
+ * Extract the foreign function with the given name.
+ * Host-application functions are looked up first, then the built-in functions
+ * shared by all VMs. A built-in function is installed in the VM the first time
+ * it is requested, so that it gets its own private data and auxiliary data stack.
+ * Return a pointer to the function on success. NULL otherwise.
+ */
+PH7_PRIVATE ph7_user_func *PH7_VmExtractForeignFunction(ph7_vm *pVm, const char *zName, sxu32 nByte) {
+	ph7_builtin_ref *pRef;
+	SyHashEntry *pEntry;
+	void *pUserData;
+	SyString sName;
+	pEntry = SyHashGet(&pVm->hHostFunction, (const void *)zName, nByte);
+	if(pEntry) {
+		/* NULL when a built-in function was deleted */
+		return (ph7_user_func *)pEntry->pUserData;
+	}
+	pEntry = SyHashGet(&pVm->pEngine->pBuiltin->hFunc, (const void *)zName, nByte);
+	if(pEntry == 0) {
+		/* No such function */
+		return 0;
+	}
+	pRef = (ph7_builtin_ref *)pEntry->pUserData;
+	switch(pRef->iData) {
+		case PH7_BUILTIN_DATA_VM:
+			pUserData = &(*pVm);
+			break;
+		case PH7_BUILTIN_DATA_VFS:
+			pUserData = (void *)pVm->pEngine->pVfs;
+			break;
+		default:
+			pUserData = 0;
+			break;
+	}
+	SyStringInitFromBuf(&sName, pRef->pFunc->zName, nByte);
+	if(PH7_VmInstallForeignFunction(&(*pVm), &sName, pRef->pFunc->xFunc, pUserData) != SXRET_OK) {
+		PH7_VmMemoryError(&(*pVm));
+		return 0;
+	}
+	pEntry = SyHashGet(&pVm->hHostFunction, (const void *)zName, nByte);
+	return (ph7_user_func *)pEntry->pUserData;
+}
+/*
+ * Initialize a table of built-in functions and constants.
+ */
+PH7_PRIVATE sxi32 PH7_BuiltinTableInit(ph7_builtin_table *pTable, SyMemBackend *pAllocator) {
+	sxi32 rc;
+	SyHashInit(&pTable->hFunc, &(*pAllocator), 0, 0);
+	SyHashInit(&pTable->hConst, &(*pAllocator), 0, 0);
+	/* Register built-in constants [i.e: PHP_EOL, PHP_OS...] */
+	rc = PH7_RegisterBuiltInConstant(&(*pTable));
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	/* Register special functions [i.e: print, json_encode(), func_get_args(), die, etc.] */
+	rc = PH7_RegisterSpecialFunction(&(*pTable));
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	/* Register built-in functions [i.e: array_diff(), strlen(), etc.] */
+	return PH7_RegisterBuiltInFunction(&(*pTable));
+}
+/*
+ * Index an array of built-in functions.
+ * As with ph7_create_function(), the last registration of a given name wins.
+ */
+PH7_PRIVATE sxi32 PH7_BuiltinTableAddFunc(ph7_builtin_table *pTable, const ph7_builtin_func *aFunc, sxu32 nFunc, sxi32 iData) {
+	SyMemBackend *pAllocator = pTable->hFunc.pAllocator;
+	ph7_builtin_ref *pRef;
+	SyHashEntry *pEntry;
+	sxu32 n, nLen;
+	sxi32 rc;
+	for(n = 0 ; n < nFunc ; ++n) {
+		nLen = SyStrlen(aFunc[n].zName);
+		pEntry = SyHashGet(&pTable->hFunc, (const void *)aFunc[n].zName, nLen);
+		if(pEntry) {
+			/* Overwrite the previous registration */
+			pRef = (ph7_builtin_ref *)pEntry->pUserData;
+			pRef->pFunc = &aFunc[n];
+			pRef->iData = iData;
+			continue;
+		}
+		pRef = (ph7_builtin_ref *)SyMemBackendPoolAlloc(&(*pAllocator), sizeof(ph7_builtin_ref));
+		if(pRef == 0) {
+			return SXERR_MEM;
+		}
+		pRef->pFunc = &aFunc[n];
+		pRef->iData = iData;
+		rc = SyHashInsert(&pTable->hFunc, (const void *)aFunc[n].zName, nLen, pRef);
+		if(rc != SXRET_OK) {
+			return rc;
+		}
+	}
+	return SXRET_OK;
+}
+/*
+ * Index an array of built-in constants.
+ * As with ph7_create_constant(), the first registration of a given name wins.
+ */
+PH7_PRIVATE sxi32 PH7_BuiltinTableAddConst(ph7_builtin_table *pTable, const ph7_builtin_constant *aConst, sxu32 nConst) {
+	SyMemBackend *pAllocator = pTable->hConst.pAllocator;
+	ph7_constant *pCons;
+	sxu32 n, nLen;
+	sxi32 rc;
+	for(n = 0 ; n < nConst ; ++n) {
+		nLen = SyStrlen(aConst[n].zName);
+		if(SyHashGet(&pTable->hConst, (const void *)aConst[n].zName, nLen)) {
+			continue;
+		}
+		pCons = (ph7_constant *)SyMemBackendPoolAlloc(&(*pAllocator), sizeof(ph7_constant));
+		if(pCons == 0) {
+			return SXERR_MEM;
+		}
+		SyStringInitFromBuf(&pCons->sName, aConst[n].zName, nLen);
+		pCons->xExpand = aConst[n].xExpand;
+		/* Expanded with the calling VM as private data */
+		pCons->pUserData = 0;
+		rc = SyHashInsert(&pTable->hConst, (const void *)pCons->sName.zString, nLen, pCons);
+		if(rc != SXRET_OK) {
+			return rc;
+		}
+	}
+	return SXRET_OK;
+}
+/*
+ * Release a table of built-in functions and constants.
+ * The entries are released with the allocator.
+ */
+PH7_PRIVATE void PH7_BuiltinTableRelease(ph7_builtin_table *pTable) {
+	SyHashRelease(&pTable->hFunc);
+	SyHashRelease(&pTable->hConst);
+}
 /*
  * Initialize a VM function.
  */
@@ -282,7 +443,7 @@ PH7_PRIVATE sxi32 PH7_VmEmitInstr(
 	VmInstr sInstr;
 	sxi32 rc;
 	/* Extract the processed script */
-	SyString *pFile = (SyString *)SySetPeek(&pVm->aFiles);
+	SyString *pFile = PH7_VmPeekFilePath(pVm);
 	static const SyString sFileName = { "[MEMORY]", sizeof("[MEMORY]") - 1};
 	if(pFile == 0) {
 		pFile = (SyString *)&sFileName;
@@ -375,7 +536,7 @@ static VmFrame *VmNewFrame(
 ) {
 	VmFrame *pFrame;
 	/* Allocate a new vm frame */
-	pFrame = (VmFrame *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(VmFrame));
+	pFrame = (VmFrame *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(VmFrame));
 	if(pFrame == 0) {
 		return 0;
 	}
@@ -385,11 +546,11 @@ static VmFrame *VmNewFrame(
 	pFrame->pUserData = pUserData;
 	pFrame->pThis = pThis;
 	pFrame->pVm = pVm;
-	SyHashInit(&pFrame->hConst, &pVm->sAllocator, 0, 0);
-	SyHashInit(&pFrame->hVar, &pVm->sAllocator, 0, 0);
-	SySetInit(&pFrame->sArg, &pVm->sAllocator, sizeof(VmSlot));
-	SySetInit(&pFrame->sLocal, &pVm->sAllocator, sizeof(VmSlot));
-	SySetInit(&pFrame->sRef, &pVm->sAllocator, sizeof(VmSlot));
+	SyHashInit(&pFrame->hConst, &pVm->sArena, 0, 0);
+	SyHashInit(&pFrame->hVar, &pVm->sArena, 0, 0);
+	SySetInit(&pFrame->sArg, &pVm->sArena, sizeof(VmSlot));
+	SySetInit(&pFrame->sLocal, &pVm->sArena, sizeof(VmSlot));
+	SySetInit(&pFrame->sRef, &pVm->sArena, sizeof(VmSlot));
 	return pFrame;
 }
 /*
@@ -416,6 +577,8 @@ static sxi32 VmEnterFrame(
 	}
 	return SXRET_OK;
 }
+/* Forward declaration */
+static void VmReleaseQueuedDestructors(ph7_vm *pVm, sxu32 nFirst);
 /*
  * Leave the top-most active frame.
  */
@@ -426,18 +589,23 @@ static void VmLeaveFrame(ph7_vm *pVm) {
 		pVm->pFrame = pFrame->pParent;
 		if(pFrame->pParent && (pFrame->iFlags & VM_FRAME_EXCEPTION) == 0) {
 			VmSlot  *aSlot;
-			sxu32 n;
+			sxu32 n, nQueued;
+			nQueued = SySetUsed(&pVm->aFreeQueue);
 			/* Restore local variable to the free pool so that they can be reused again */
 			aSlot = (VmSlot *)SySetBasePtr(&pFrame->sLocal);
 			for(n = 0 ; n < SySetUsed(&pFrame->sLocal) ; ++n) {
 				/* Unset the local variable */
-				PH7_VmUnsetMemObj(&(*pVm), aSlot[n].nIdx, FALSE);
+				PH7_VmUnsetMemObj(&(*pVm), aSlot[n].nIdx, TRUE);
 			}
 			/* Remove local reference */
 			aSlot = (VmSlot *)SySetBasePtr(&pFrame->sRef);
 			for(n = 0 ; n < SySetUsed(&pFrame->sRef) ; ++n) {
 				PH7_VmRefObjRemove(&(*pVm), aSlot[n].nIdx, (SyHashEntry *)aSlot[n].pUserData, 0);
 			}
+			if(SySetUsed(&pVm->aFreeQueue) > nQueued) {
+				/* Invoke the destructors of the released locals before the caller resumes */
+				VmReleaseQueuedDestructors(&(*pVm), nQueued);
+			}
 		}
 		/* Release internal containers */
 		SyHashRelease(&pFrame->hConst);
@@ -446,7 +614,7 @@ static void VmLeaveFrame(ph7_vm *pVm) {
 		SySetRelease(&pFrame->sLocal);
 		SySetRelease(&pFrame->sRef);
 		/* Release the whole structure */
-		SyMemBackendPoolFree(&pVm->sAllocator, pFrame);
+		SyMemBackendPoolFree(&pVm->sArena, pFrame);
 	}
 }
 /*
@@ -473,6 +641,7 @@ static int VmOverloadCompare(SyString *pFirst, SyString *pSecond) {
 }
 /* Forward declaration */
 static sxi32 VmExecIncludedFile(ph7_vm *pVm, SyString *pPath, int iFlags);
+static sxi32 VmImportModule(ph7_vm *pVm, const SyString *pName);
 static sxi32 VmLocalExec(ph7_vm *pVm, SySet *pByteCode, ph7_value *pResult);
 /*
  * Select the appropriate VM function for the current call context.
@@ -586,17 +755,20 @@ static ph7_vm_func *VmOverload(
 	return apSet[iTarget];
 }
 /*
- * Mount a compiled class into the freshly created virtual machine so that
- * it can be instanciated from the executed PHP script.
+ * Create the static and constant attributes of a compiled class and evaluate
+ * their default values. This is done when the class is mounted and again each
+ * time the VM is reset, since these attributes live in the request arena.
  */
-static sxi32 VmMountUserClass(
+static void VmMountClassStatic(
 	ph7_vm *pVm,      /* Target VM */
-	ph7_class *pClass /* Class to be mounted */
+	ph7_class *pClass /* Class owning the attributes */
 ) {
-	ph7_class_method *pMeth;
 	ph7_class_attr *pAttr;
 	SyHashEntry *pEntry;
 	sxi32 rc;
+	/* Released instances refer to the previous static attributes, forget them */
+	pClass->pFreeList = 0;
+	pClass->nFreeList = 0;
 	/* Reset the loop cursor */
 	SyHashResetLoopCursor(&pClass->hAttr);
 	/* Process only static and constant attribute */
@@ -631,10 +803,22 @@ static sxi32 VmMountUserClass(
 			PH7_MemObjRelease(pResult);
 			/* Record attribute index */
 			pAttr->nIdx = pMemObj->nIdx;
-			/* Install static attribute in the reference table */
-			PH7_VmRefObjInstall(&(*pVm), pMemObj->nIdx, 0, 0, VM_REF_IDX_KEEP);
 		}
 	}
+}
+/*
+ * Mount a compiled class into the freshly created virtual machine so that
+ * it can be instanciated from the executed PHP script.
+ */
+static sxi32 VmMountUserClass(
+	ph7_vm *pVm,      /* Target VM */
+	ph7_class *pClass /* Class to be mounted */
+) {
+	ph7_class_method *pMeth;
+	SyHashEntry *pEntry;
+	sxi32 rc;
+	/* Create static and constant attributes */
+	VmMountClassStatic(&(*pVm), &(*pClass));
 	/* Install class methods */
 	if(pClass->iFlags & PH7_CLASS_INTERFACE) {
 		/* Do not mount interface methods since they are signatures only.
@@ -654,9 +838,82 @@ static sxi32 VmMountUserClass(
 	}
 	return SXRET_OK;
 }
+/*
+ * Give a memory object back. The slot goes to the free list while the value cell is
+ * released to the arena, so that slabs emptied by a dropped data set can be reused or
+ * returned to the OS instead of being held until the end of the request.
+ */
+static void VmRecycleMemObj(ph7_vm *pVm, sxu32 nIdx) {
+	ph7_value **apObj = (ph7_value **)SySetBasePtr(&pVm->aMemObj);
+	VmSlot sFree;
+	if(nIdx >= SySetUsed(&pVm->aMemObj) || apObj[nIdx] == 0) {
+		/* Already recycled */
+		return;
+	}
+	SyMemBackendPoolFree(&pVm->sArena, apObj[nIdx]);
+	apObj[nIdx] = 0;
+	sFree.nIdx = nIdx;
+	sFree.pUserData = 0;
+	SySetPut(&pVm->aFreeObj, (const void *)&sFree);
+}
+/*
+ * Reserve a memory object for a non-static attribute of a class instance
+ * and initialize it with the attribute default value.
+ */
+static sxi32 VmInitClassInstanceAttr(ph7_vm *pVm, ph7_class *pClass, VmClassAttr *pVmAttr) {
+	ph7_class_attr *pAttr = pVmAttr->pAttr;
+	ph7_value *pMemObj, *pResult;
+	sxi32 rc;
+	/* Reserve a memory object for this attribute */
+	pMemObj = PH7_ReserveMemObj(&(*pVm));
+	pResult = PH7_ReserveMemObj(&(*pVm));
+	if(pMemObj == 0 || pResult == 0) {
+		return SXERR_MEM;
+	}
+	MemObjSetType(pMemObj, pAttr->nType);
+	if(SySetUsed(&pAttr->aByteCode) > 0) {
+		/* Initialize attribute default value (any complex expression) */
+		VmLocalExec(&(*pVm), &pAttr->aByteCode, pResult);
+		rc = PH7_MemObjSafeStore(pResult, pMemObj);
+		if(rc != SXRET_OK) {
+			PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot assign a value of incompatible type to variable '%z::$%z'", &pClass->sName, &pAttr->sName);
+		}
+	} else if(pMemObj->nType & MEMOBJ_HASHMAP) {
+		ph7_hashmap *pMap;
+		pMap = PH7_NewHashmap(&(*pVm), 0, 0);
+		if(pMap == 0) {
+			PH7_VmMemoryError(&(*pVm));
+		}
+		pMemObj->x.pOther = pMap;
+	}
+	/* Free up memory */
+	PH7_MemObjRelease(pResult);
+	VmRecycleMemObj(&(*pVm), pResult->nIdx);
+	/* Record attribute index */
+	pVmAttr->nIdx = pMemObj->nIdx;
+	return SXRET_OK;
+}
+/*
+ * Release the non-static attributes of a class instance initialized before
+ * the given entry [NULL: all of them] of its attributes table.
+ */
+static void VmReleaseClassInstanceAttr(ph7_vm *pVm, ph7_class_instance *pObj, SyHashEntry *pStop) {
+	SyHashEntry *pEntry;
+	SyHashResetLoopCursor(&pObj->hAttr);
+	while((pEntry = SyHashGetNextEntry(&pObj->hAttr)) != 0 && pEntry != pStop) {
+		VmClassAttr *pVmAttr = (VmClassAttr *)pEntry->pUserData;
+		if((pVmAttr->pAttr->iFlags & (PH7_CLASS_ATTR_CONSTANT | PH7_CLASS_ATTR_STATIC)) == 0) {
+			PH7_VmUnsetMemObj(&(*pVm), pVmAttr->nIdx, TRUE);
+		}
+	}
+}
 /*
  * Allocate a private frame for attributes of the given
  * class instance (Object in the PHP jargon).
+ * A class instance recycled from the class freelist already holds its
+ * attributes table, only the non-static attributes are initialized again.
+ * On failure, no attribute is left initialized but the attributes table
+ * is kept and must be released by the caller.
  */
 PH7_PRIVATE sxi32 PH7_VmCreateClassInstanceFrame(
 	ph7_vm *pVm, /* Target VM */
@@ -666,68 +923,63 @@ PH7_PRIVATE sxi32 PH7_VmCreateClassInstanceFrame(
 	ph7_class_attr *pAttr;
 	SyHashEntry *pEntry;
 	sxi32 rc;
+	if(SyHashTotalEntry(&pObj->hAttr) > 0) {
+		/* Recycled instance */
+		SyHashResetLoopCursor(&pObj->hAttr);
+		while((pEntry = SyHashGetNextEntry(&pObj->hAttr)) != 0) {
+			VmClassAttr *pVmAttr = (VmClassAttr *)pEntry->pUserData;
+			if((pVmAttr->pAttr->iFlags & (PH7_CLASS_ATTR_CONSTANT | PH7_CLASS_ATTR_STATIC)) == 0) {
+				rc = VmInitClassInstanceAttr(&(*pVm), pClass, pVmAttr);
+				if(rc != SXRET_OK) {
+					VmReleaseClassInstanceAttr(&(*pVm), pObj, pEntry);
+					return rc;
+				}
+			}
+		}
+		return SXRET_OK;
+	}
 	/* Install class attribute in the private frame associated with this instance */
 	SyHashResetLoopCursor(&pClass->hAttr);
 	while((pEntry = SyHashGetNextEntry(&pClass->hAttr)) != 0) {
 		VmClassAttr *pVmAttr;
 		/* Extract the current attribute */
 		pAttr = (ph7_class_attr *)pEntry->pUserData;
-		pVmAttr = (VmClassAttr *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(VmClassAttr));
+		pVmAttr = (VmClassAttr *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(VmClassAttr));
 		if(pVmAttr == 0) {
-			return SXERR_MEM;
+			rc = SXERR_MEM;
+			break;
 		}
 		pVmAttr->pAttr = pAttr;
 		if((pAttr->iFlags & (PH7_CLASS_ATTR_CONSTANT | PH7_CLASS_ATTR_STATIC)) == 0) {
-			ph7_value *pMemObj, *pResult;
-			/* Reserve a memory object for this attribute */
-			pMemObj = PH7_ReserveMemObj(&(*pVm));
-			pResult = PH7_ReserveMemObj(&(*pVm));
-			if(pMemObj == 0 || pResult == 0) {
-				SyMemBackendPoolFree(&pVm->sAllocator, pVmAttr);
-				return SXERR_MEM;
-			}
-			MemObjSetType(pMemObj, pAttr->nType);
-			if(SySetUsed(&pAttr->aByteCode) > 0) {
-				/* Initialize attribute default value (any complex expression) */
-				VmLocalExec(&(*pVm), &pAttr->aByteCode, pResult);
-				rc = PH7_MemObjSafeStore(pResult, pMemObj);
-				if(rc != SXRET_OK) {
-					PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot assign a value of incompatible type to variable '%z::$%z'", &pClass->sName, &pAttr->sName);
-				}
-			} else if(pMemObj->nType & MEMOBJ_HASHMAP) {
-				ph7_hashmap *pMap;
-				pMap = PH7_NewHashmap(&(*pVm), 0, 0);
-				if(pMap == 0) {
-					PH7_VmMemoryError(&(*pVm));
-				}
-				pMemObj->x.pOther = pMap;
+			rc = VmInitClassInstanceAttr(&(*pVm), pClass, pVmAttr);
+			if(rc != SXRET_OK) {
+				SyMemBackendPoolFree(&pVm->sArena, pVmAttr);
+				break;
 			}
-			/* Free up memory */
-			PH7_MemObjRelease(pResult);
-			/* Record attribute index */
-			pVmAttr->nIdx = pMemObj->nIdx;
 			rc = SyHashInsert(&pObj->hAttr, SyStringData(&pAttr->sName), SyStringLength(&pAttr->sName), pVmAttr);
 			if(rc != SXRET_OK) {
-				VmSlot sSlot;
 				/* Restore memory object */
-				sSlot.nIdx = pMemObj->nIdx;
-				sSlot.pUserData = 0;
-				SySetPut(&pVm->aFreeObj, (const void *)&sSlot);
-				SyMemBackendPoolFree(&pVm->sAllocator, pVmAttr);
-				return SXERR_MEM;
+				VmRecycleMemObj(&(*pVm), pVmAttr->nIdx);
+				SyMemBackendPoolFree(&pVm->sArena, pVmAttr);
+				rc = SXERR_MEM;
+				break;
 			}
-			/* Install attribute in the reference table */
-			PH7_VmRefObjInstall(&(*pVm), pMemObj->nIdx, 0, 0, VM_REF_IDX_KEEP);
 		} else {
 			/* Install static/constant attribute */
 			pVmAttr->nIdx = pAttr->nIdx;
 			rc = SyHashInsert(&pObj->hAttr, SyStringData(&pAttr->sName), SyStringLength(&pAttr->sName), pVmAttr);
 			if(rc != SXRET_OK) {
-				SyMemBackendPoolFree(&pVm->sAllocator, pVmAttr);
-				return SXERR_MEM;
+				SyMemBackendPoolFree(&pVm->sArena, pVmAttr);
+				rc = SXERR_MEM;
+				break;
 			}
 		}
 	}
+	if(pEntry) {
+		/* Failure, release the attributes installed so far */
+		VmReleaseClassInstanceAttr(&(*pVm), pObj, 0);
+		return rc;
+	}
 	return SXRET_OK;
 }
 /* Forward declaration */
@@ -759,6 +1011,33 @@ PH7_PRIVATE ph7_value *PH7_ReserveConstObj(ph7_vm *pVm, sxu32 *pIndex) {
 	pObj = (ph7_value *)SySetPeek(&pVm->aLitObj);
 	return pObj;
 }
+/*
+ * Intern a string [i.e: variable, attribute or method name] in the VM string table.
+ * Identical strings share a single immutable, null terminated copy which lives as long
+ * as the VM, so that hashtables keyed by interned strings compare keys by address.
+ * Return the interned copy on success. NULL on failure.
+ */
+PH7_PRIVATE char *PH7_VmInternString(ph7_vm *pVm, const char *zStr, sxu32 nByte) {
+	SyHashEntry *pEntry;
+	char *zDup;
+	/* Check if the string is already interned */
+	pEntry = SyHashGet(&pVm->hIntern, (const void *)zStr, nByte);
+	if(pEntry) {
+		return (char *)pEntry->pUserData;
+	}
+	/* Make an immutable copy (Binary safe) */
+	zDup = (char *)SyMemBackendAlloc(&pVm->sAllocator, nByte + 1);
+	if(zDup == 0) {
+		return 0;
+	}
+	SyMemcpy((const void *)zStr, zDup, nByte);
+	zDup[nByte] = 0;
+	if(nByte > 0 && SyHashInsert(&pVm->hIntern, (const void *)zDup, nByte, zDup) != SXRET_OK) {
+		SyMemBackendFree(&pVm->sAllocator, zDup);
+		return 0;
+	}
+	return zDup;
+}
 /*
  * Reserve a memory object.
  * Return a pointer to the raw ph7_value on success. NULL on failure.
@@ -770,15 +1049,21 @@ PH7_PRIVATE ph7_value *VmReserveMemObj(ph7_vm *pVm, sxu32 *pIndex) {
 		/* Object index in the object table */
 		*pIndex = SySetUsed(&pVm->aMemObj);
 	}
+	/* Values are allocated separately so that they never move when the table grows */
+	pObj = (ph7_value *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(ph7_value));
+	if(pObj == 0) {
+		return 0;
+	}
+	SyZero(pObj, sizeof(ph7_value));
 	/* Reserve a slot for the new object */
-	rc = SySetPut(&pVm->aMemObj, (const void *)zDummy);
+	rc = SySetPut(&pVm->aMemObj, (const void *)&pObj);
 	if(rc != SXRET_OK) {
 		/* If the supplied memory subsystem is so sick that we are unable to allocate
 		 * a tiny chunk of memory, there is no much we can do here.
 		 */
+		SyMemBackendPoolFree(&pVm->sArena, pObj);
 		return 0;
 	}
-	pObj = (ph7_value *)SySetPeek(&pVm->aMemObj);
 	return pObj;
 }
 /* Forward declaration */
@@ -907,6 +1192,25 @@ static sxi32 VmEvalChunk(ph7_vm *pVm, ph7_context *pCtx, SyString *pChunk, int i
 	" void __construct(mixed $v){ $this->value = $v; }"\
 	"}"
 
+/*
+ * Initialize the request scoped containers [i.e: object table, superglobals, output buffers...].
+ * They are allocated from the request arena, so there is nothing to free when the
+ * arena is rewound by PH7_VmReset(), they are simply initialized again.
+ */
+static void VmInitRequestContainers(ph7_vm *pVm) {
+	SySetInit(&pVm->aMemObj, &pVm->sArena, sizeof(ph7_value *));
+	SySetAlloc(&pVm->aMemObj, 0xFF);
+	SySetInit(&pVm->aFreeObj, &pVm->sArena, sizeof(VmSlot));
+	SyHashInit(&pVm->hSuper, &pVm->sArena, 0, 0);
+	SySetInit(&pVm->aSelf, &pVm->sArena, sizeof(ph7_class *));
+	SySetInit(&pVm->aGcRoot, &pVm->sArena, sizeof(ph7_class_instance *));
+	SySetInit(&pVm->aFreeQueue, &pVm->sArena, sizeof(VmFreeEntry));
+	pVm->nFreeHead = 0;
+	SySetInit(&pVm->aAutoLoad, &pVm->sArena, sizeof(VmAutoLoadCB));
+	SySetInit(&pVm->aShutdown, &pVm->sArena, sizeof(VmShutdownCB));
+	SySetInit(&pVm->aException, &pVm->sArena, sizeof(ph7_exception *));
+	SySetInit(&pVm->aOB, &pVm->sArena, sizeof(VmObEntry));
+}
 /*
  * Initialize a freshly allocated PH7 Virtual Machine so that we can
  * start compiling the target PHP program.
@@ -916,6 +1220,7 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	ph7 *pEngine, /* Master engine */
 	sxbool bDebug /* Debugging */
 ) {
+	sxu64 nStart = SyClockMicro();
 	SyString sBuiltin;
 	ph7_value *pObj;
 	sxi32 rc;
@@ -924,14 +1229,16 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	/* Initialize VM fields */
 	pVm->pEngine = &(*pEngine);
 	SyMemBackendInitFromParent(&pVm->sAllocator, &pEngine->sAllocator);
+	/* Independent VMs do not share memory accounting, the memory limit still applies to each of them */
+	SyMemBackendDetachHeap(&pVm->sAllocator, &pVm->sHeap);
+	SyMemBackendInitFromParent(&pVm->sArena, &pVm->sAllocator);
 	/* Instructions containers */
 	SySetInit(&pVm->aInstrSet, &pVm->sAllocator, sizeof(VmInstr));
 	SySetInit(&pVm->aByteCode, &pVm->sAllocator, sizeof(VmInstr));
 	SySetAlloc(&pVm->aByteCode, 0xFF);
 	pVm->pByteContainer = &pVm->aByteCode;
 	/* Object containers */
-	SySetInit(&pVm->aMemObj, &pVm->sAllocator, sizeof(ph7_value));
-	SySetAlloc(&pVm->aMemObj, 0xFF);
+	VmInitRequestContainers(&(*pVm));
 	/* Virtual machine internal containers */
 	SyBlobInit(&pVm->sConsumer, &pVm->sAllocator);
 	SyBlobInit(&pVm->sArgv, &pVm->sAllocator);
@@ -941,19 +1248,16 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	SyHashInit(&pVm->hFunction, &pVm->sAllocator, 0, 0);
 	SyHashInit(&pVm->hClass, &pVm->sAllocator, SyStrHash, (int (*)(const void *, const void *, sxu32))((SyStrncmp)));
 	SyHashInit(&pVm->hConstant, &pVm->sAllocator, 0, 0);
-	SyHashInit(&pVm->hSuper, &pVm->sAllocator, 0, 0);
 	SyHashInit(&pVm->hDBAL, &pVm->sAllocator, 0, 0);
-	SySetInit(&pVm->aFreeObj, &pVm->sAllocator, sizeof(VmSlot));
-	SySetInit(&pVm->aSelf, &pVm->sAllocator, sizeof(ph7_class *));
-	SySetInit(&pVm->aAutoLoad, &pVm->sAllocator, sizeof(VmAutoLoadCB));
-	SySetInit(&pVm->aShutdown, &pVm->sAllocator, sizeof(VmShutdownCB));
-	SySetInit(&pVm->aException, &pVm->sAllocator, sizeof(ph7_exception *));
+	SyHashInit(&pVm->hIntern, &pVm->sAllocator, 0, 0);
 	/* Configuration containers */
 	SySetInit(&pVm->aModules, &pVm->sAllocator, sizeof(VmModule));
-	SySetInit(&pVm->aFiles, &pVm->sAllocator, sizeof(SyString));
+	SyHashInit(&pVm->hModule, &pVm->sAllocator, 0, 0);
+	SySetInit(&pVm->aModulePaths, &pVm->sAllocator, sizeof(SyString));
+	SySetInit(&pVm->aFiles, &pVm->sAllocator, sizeof(SyString *));
 	SySetInit(&pVm->aPaths, &pVm->sAllocator, sizeof(SyString));
 	SySetInit(&pVm->aIncluded, &pVm->sAllocator, sizeof(SyString));
-	SySetInit(&pVm->aOB, &pVm->sAllocator, sizeof(VmObEntry));
+	SyHashInit(&pVm->hInclude, &pVm->sAllocator, 0, 0);
 	SySetInit(&pVm->aIOstream, &pVm->sAllocator, sizeof(ph7_io_stream *));
 	/* Error callbacks containers */
 	PH7_MemObjInit(&(*pVm), &pVm->aExceptionCB[0]);
@@ -961,6 +1265,9 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	PH7_MemObjInit(&(*pVm), &pVm->sAssertCallback);
 	/* Default assertion flags */
 	pVm->iAssertFlags = PH7_ASSERT_WARNING; /* Issue a warning for each failed assertion */
+	/* Cycle collector time slice */
+	pVm->nGcBudget = PH7_GC_BUDGET;
+	pVm->nGcThreshold = PH7_GC_ROOT_THRESHOLD;
 	/* JSON return status */
 	pVm->json_rc = JSON_ERROR_NONE;
 	/* PRNG context */
@@ -998,9 +1305,13 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	}
 	/* VM correctly initialized,set the magic number */
 	pVm->nMagic = PH7_VM_INIT;
+	pVm->aPhase[PH7_PHASE_ENGINE] = pEngine->nInitTime;
+	pVm->aPhase[PH7_PHASE_VM] = (sxu32)(SyClockMicro() - nStart);
+	nStart = SyClockMicro();
 	SyStringInitFromBuf(&sBuiltin, PH7_BUILTIN_LIB, sizeof(PH7_BUILTIN_LIB) - 1);
 	/* Precompile the built-in library */
 	VmEvalChunk(&(*pVm), 0, &sBuiltin, PH7_AERSCRIPT_CODE);
+	pVm->aPhase[PH7_PHASE_BUILTIN] = (sxu32)(SyClockMicro() - nStart);
 	if(bDebug) {
 		/* Enable debugging */
 		pVm->bDebug = TRUE;
@@ -1009,6 +1320,7 @@ PH7_PRIVATE sxi32 PH7_VmInit(
 	PH7_ResetCodeGenerator(&(*pVm), pEngine->xConf.xErr, pEngine->xConf.pErrData);
 	return SXRET_OK;
 Err:
+	SyMemBackendRelease(&pVm->sArena);
 	SyMemBackendRelease(&pVm->sAllocator);
 	return rc;
 }
@@ -1065,8 +1377,22 @@ static ph7_value *VmNewOperandStack(
 	/* Ready for bytecode execution */
 	return pStack;
 }
+/*
+ * Allocate an empty reference table.
+ */
+static sxi32 VmInitRefTable(ph7_vm *pVm) {
+	pVm->nRefSize = 0x10; /* Must be a power of two for fast arithemtic */
+	pVm->nRefUsed = 0;
+	pVm->pRefList = 0;
+	pVm->apRefObj = (VmRefObj **)SyMemBackendAlloc(&pVm->sArena, sizeof(VmRefObj *) * pVm->nRefSize);
+	if(pVm->apRefObj == 0) {
+		return SXERR_MEM;
+	}
+	/* Zero the reference table */
+	SyZero(pVm->apRefObj, sizeof(VmRefObj *) * pVm->nRefSize);
+	return SXRET_OK;
+}
 /* Forward declaration */
-static sxi32 VmRegisterSpecialFunction(ph7_vm *pVm);
 static int VmInstanceOf(ph7_class *pThis, ph7_class *pClass);
 static int VmClassMemberAccess(ph7_vm *pVm, ph7_class *pClass, sxi32 iProtection);
 /*
@@ -1078,6 +1404,7 @@ PH7_PRIVATE sxi32 PH7_VmMakeReady(
 	ph7_vm *pVm /* Target VM */
 ) {
 	SyHashEntry *pEntry;
+	sxu64 nStart;
 	sxi32 rc;
 	if(pVm->nMagic != PH7_VM_INIT) {
 		/* Initialize your VM first */
@@ -1098,30 +1425,25 @@ PH7_PRIVATE sxi32 PH7_VmMakeReady(
 		return SXERR_MEM;
 	}
 	/* Allocate the reference table */
-	pVm->nRefSize = 0x10; /* Must be a power of two for fast arithemtic */
-	pVm->apRefObj = (VmRefObj **)SyMemBackendAlloc(&pVm->sAllocator, sizeof(VmRefObj *) * pVm->nRefSize);
-	if(pVm->apRefObj == 0) {
-		/* Don't worry about freeing memory, everything will be released shortly */
-		return SXERR_MEM;
-	}
-	/* Zero the reference table */
-	SyZero(pVm->apRefObj, sizeof(VmRefObj *) * pVm->nRefSize);
-	/* Register special functions first [i.e: print, json_encode(), func_get_args(), die, etc.] */
-	rc = VmRegisterSpecialFunction(&(*pVm));
+	rc = VmInitRefTable(&(*pVm));
 	if(rc != SXRET_OK) {
 		/* Don't worry about freeing memory, everything will be released shortly */
 		return rc;
 	}
 	/* Create superglobals [i.e: $GLOBALS, $_GET, $_POST...] */
+	nStart = SyClockMicro();
 	rc = PH7_HashmapCreateSuper(&(*pVm));
 	if(rc != SXRET_OK) {
 		/* Don't worry about freeing memory, everything will be released shortly */
 		return rc;
 	}
-	/* Register built-in constants [i.e: PHP_EOL, PHP_OS...] */
-	PH7_RegisterBuiltInConstant(&(*pVm));
-	/* Register built-in functions [i.e: array_diff(), strlen(), etc.] */
-	PH7_RegisterBuiltInFunction(&(*pVm));
+	pVm->aPhase[PH7_PHASE_SUPER] = (sxu32)(SyClockMicro() - nStart);
+	/* Built-in constants and functions [i.e: PHP_EOL, strlen(), etc.] are shared by all VMs,
+	 * install the built-in IO streams [i.e: file://,php://] only.
+	 */
+	nStart = SyClockMicro();
+	PH7_RegisterIORoutine(&(*pVm));
+	pVm->aPhase[PH7_PHASE_STREAM] = (sxu32)(SyClockMicro() - nStart);
 	/* Initialize and install static and constants class attributes */
 	SyHashResetLoopCursor(&pVm->hClass);
 	while((pEntry = SyHashGetNextEntry(&pVm->hClass)) != 0) {
@@ -1135,15 +1457,81 @@ PH7_PRIVATE sxi32 PH7_VmMakeReady(
 }
 /*
  * Reset a Virtual Machine to it's initial state.
+ * Everything created by the executed program [i.e: values, arrays, objects, frames...]
+ * lives in the request arena. Rather than destroying these objects one by one, the arena
+ * is rewound at once and the request state is created again, while the compiled program
+ * and other long-lived data are left untouched.
+ * Values created by the host application [i.e: ph7_new_scalar(), ph7_new_array()] keep
+ * their contents in the arena too, and must be created again after the reset.
  */
 PH7_PRIVATE sxi32 PH7_VmReset(ph7_vm *pVm) {
+	ph7_output_consumer *pCons = &pVm->sVmConsumer;
+	SyHashEntry *pEntry;
+	sxi32 rc;
+	sxu32 n;
 	if(pVm->nMagic != PH7_VM_RUN && pVm->nMagic != PH7_VM_EXEC && pVm->nMagic != PH7_VM_INCL) {
 		return SXERR_CORRUPT;
 	}
-	/* TICKET 1433-003: As of this version, the VM is automatically reset */
-	SyBlobReset(&pVm->sConsumer);
-	/* Set the ready flag */
+	/* Drop references to the request arena held by long-lived values */
+	PH7_MemObjRelease(&pVm->aExceptionCB[0]);
+	PH7_MemObjRelease(&pVm->aExceptionCB[1]);
+	PH7_MemObjRelease(&pVm->sAssertCallback);
+	if(SySetUsed(&pVm->aOB) > 0) {
+		/* Restore the default VM consumer */
+		pCons->xConsumer = pCons->xDef;
+		pCons->pUserData = pCons->pDefData;
+	}
+	/* Static variables must be created again on the next call */
+	SyHashResetLoopCursor(&pVm->hFunction);
+	while((pEntry = SyHashGetNextEntry(&pVm->hFunction)) != 0) {
+		ph7_vm_func *pFunc = (ph7_vm_func *)pEntry->pUserData;
+		while(pFunc) {
+			ph7_vm_func_static_var *aStatic = (ph7_vm_func_static_var *)SySetBasePtr(&pFunc->aStatic);
+			for(n = 0 ; n < SySetUsed(&pFunc->aStatic) ; ++n) {
+				aStatic[n].nIdx = SXU32_HIGH;
+			}
+			pFunc = pFunc->pNextName;
+		}
+	}
+	/* Rewind the request arena */
+	SyMemBackendReset(&pVm->sArena);
+	pVm->pFrame = 0;
+	VmInitRequestContainers(&(*pVm));
+	pVm->nGcThreshold = PH7_GC_ROOT_THRESHOLD;
+	pVm->nObjCacheHit = pVm->nObjCacheMiss = 0;
+	pVm->nIncludeHit = pVm->nIncludeMiss = 0;
+	/* Set the ready flag, values created from now on are request scoped */
 	pVm->nMagic = PH7_VM_RUN;
+	PH7_MemObjInit(&(*pVm), &pVm->aExceptionCB[0]);
+	PH7_MemObjInit(&(*pVm), &pVm->aExceptionCB[1]);
+	PH7_MemObjInit(&(*pVm), &pVm->sAssertCallback);
+	n = SySetUsed(pVm->pByteContainer) + VM_STACK_GUARD;
+	while(n > 0) {
+		PH7_MemObjInit(&(*pVm), &pVm->aOps[n - 1]);
+		--n;
+	}
+	/* Create the global frame and the reference table */
+	rc = VmEnterFrame(&(*pVm), 0, 0, 0);
+	if(rc == SXRET_OK) {
+		rc = VmInitRefTable(&(*pVm));
+	}
+	if(rc == SXRET_OK) {
+		/* Create superglobals */
+		rc = PH7_HashmapCreateSuper(&(*pVm));
+	}
+	if(rc != SXRET_OK) {
+		pVm->nMagic = PH7_VM_STALE;
+		return rc;
+	}
+	/* Initialize static and constants class attributes */
+	SyHashResetLoopCursor(&pVm->hClass);
+	while((pEntry = SyHashGetNextEntry(&pVm->hClass)) != 0) {
+		VmMountClassStatic(&(*pVm), (ph7_class *)pEntry->pUserData);
+	}
+	pVm->iExitStatus = 0;
+	pVm->nExceptDepth = 0;
+	pVm->json_rc = JSON_ERROR_NONE;
+	SyBlobReset(&pVm->sConsumer);
 	return SXRET_OK;
 }
 /*
@@ -1154,6 +1542,10 @@ PH7_PRIVATE sxi32 PH7_VmRelease(ph7_vm *pVm) {
 	VmModule *pEntry;
 	/* Iterate through modules list */
 	while(SySetGetNextEntry(&pVm->aModules, (void **)&pEntry) == SXRET_OK) {
+		if(pEntry->pHandle == 0) {
+			/* Linked into the library */
+			continue;
+		}
 		/* Unload the module */
 #ifdef __WINNT__
 		FreeLibrary(pEntry->pHandle);
@@ -1163,12 +1555,136 @@ PH7_PRIVATE sxi32 PH7_VmRelease(ph7_vm *pVm) {
 	}
 	/* Free up the heap */
 	SySetRelease(&pVm->aModules);
+	if(pVm->pImage && pVm->pEngine->pVfs && pVm->pEngine->pVfs->xUnmap) {
+		/* Release the memory view of the bytecode image the program was loaded from */
+		pVm->pEngine->pVfs->xUnmap((void *)pVm->pImage, pVm->nImage);
+		pVm->pImage = 0;
+	}
+	if(pVm->pSnapshot) {
+		/* Clones may still execute from the program image */
+		PH7_VmSnapshotRelease(pVm->pEngine, pVm->pSnapshot);
+		pVm->pSnapshot = 0;
+	}
 	/* Set the stale magic number */
 	pVm->nMagic = PH7_VM_STALE;
 	/* Release the private memory subsystem */
+	SyMemBackendRelease(&pVm->sArena);
 	SyMemBackendRelease(&pVm->sAllocator);
 	return SXRET_OK;
 }
+/*
+ * Duplicate a set of search paths [i.e: import or dynamic module paths].
+ */
+static sxi32 VmClonePaths(ph7_vm *pVm, SySet *pDest, SySet *pSrc) {
+	SyString *aPath, sPath;
+	sxu32 n;
+	aPath = (SyString *)SySetBasePtr(pSrc);
+	for(n = 0 ; n < SySetUsed(pSrc) ; ++n) {
+		sPath.zString = SyMemBackendStrDup(&pVm->sAllocator, aPath[n].zString, aPath[n].nByte);
+		sPath.nByte = aPath[n].nByte;
+		if(sPath.zString == 0 || SySetPut(pDest, (const void *)&sPath) != SXRET_OK) {
+			return SXERR_MEM;
+		}
+	}
+	return SXRET_OK;
+}
+/*
+ * Copy a global constant of the source VM to its clone.
+ */
+static sxi32 VmCloneConstant(ph7_vm *pVm, SyHashEntry *pEntry) {
+	ph7_constant *pCons = (ph7_constant *)pEntry->pUserData;
+	if(pCons == 0) {
+		/* Deleted built-in constant */
+		return SyHashInsert(&pVm->hConstant, pEntry->pKey, pEntry->nKeyLen, 0);
+	}
+	if(pCons->xExpand == PH7_VmExpandConstantValue) {
+		/* Compiled constant, part of the program image or defined at run-time */
+		return SXRET_OK;
+	}
+	return PH7_VmRegisterConstant(&(*pVm), &pCons->sName, pCons->xExpand, pCons->pUserData, TRUE);
+}
+/*
+ * Load the program of another VM into a freshly initialized VM [i.e: ph7_vm_clone()].
+ * Nothing is compiled, instructions are rebuilt from the program snapshot while literals
+ * and strings point straight into the image shared by both VMs.
+ * The configuration, foreign functions and constants of the source VM are copied, but not
+ * its request state [i.e: superglobals, $argv, IO streams, global variables].
+ */
+PH7_PRIVATE sxi32 PH7_VmClone(ph7_vm *pVm, ph7_vm *pSrc) {
+	ph7_vm_snapshot *pSnap = pSrc->pSnapshot;
+	SyHashEntry *pEntry, **apEntry;
+	SySet aEntry;
+	sxu32 n;
+	sxi32 rc;
+	/* Configuration */
+	pVm->bErrReport = pSrc->bErrReport;
+	pVm->iAssertFlags = pSrc->iAssertFlags;
+	pVm->nGcBudget = pSrc->nGcBudget;
+	pVm->sHeap.nLimit = pSrc->sHeap.nLimit;
+	if(pSrc->sVmConsumer.xConsumer != PH7_VmBlobConsumer) {
+		/* Host-application output consumer */
+		pVm->sVmConsumer.xConsumer = pSrc->sVmConsumer.xConsumer;
+		pVm->sVmConsumer.pUserData = pSrc->sVmConsumer.pUserData;
+	}
+	rc = VmClonePaths(&(*pVm), &pVm->aPaths, &pSrc->aPaths);
+	if(rc == SXRET_OK) {
+		rc = VmClonePaths(&(*pVm), &pVm->aModulePaths, &pSrc->aModulePaths);
+	}
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	/* Foreign functions */
+	SyHashResetLoopCursor(&pSrc->hHostFunction);
+	while((pEntry = SyHashGetNextEntry(&pSrc->hHostFunction)) != 0) {
+		ph7_user_func *pFunc = (ph7_user_func *)pEntry->pUserData;
+		SyHashEntry *pBuiltin;
+		if(pFunc == 0) {
+			/* Deleted built-in function */
+			rc = SyHashInsert(&pVm->hHostFunction, pEntry->pKey, pEntry->nKeyLen, 0);
+		} else {
+			pBuiltin = SyHashGet(&pVm->pEngine->pBuiltin->hFunc, pEntry->pKey, pEntry->nKeyLen);
+			if(pBuiltin && ((ph7_builtin_ref *)pBuiltin->pUserData)->pFunc->xFunc == pFunc->xFunc) {
+				/* Built-in function installed on first use, the clone will do the same */
+				continue;
+			}
+			rc = PH7_VmInstallForeignFunction(&(*pVm), &pFunc->sName, pFunc->xFunc, pFunc->pUserData);
+		}
+		if(rc != SXRET_OK) {
+			return rc;
+		}
+	}
+	/* Constants are copied in definition order, since the image expects those defined
+	 * before the program was compiled to be there already. Hashtables are walked from
+	 * the most recent entry.
+	 */
+	SySetInit(&aEntry, &pVm->sAllocator, sizeof(SyHashEntry *));
+	SyHashResetLoopCursor(&pSrc->hConstant);
+	while((pEntry = SyHashGetNextEntry(&pSrc->hConstant)) != 0) {
+		SySetPut(&aEntry, (const void *)&pEntry);
+	}
+	apEntry = (SyHashEntry **)SySetBasePtr(&aEntry);
+	for(n = 0 ; n < SySetUsed(&aEntry) && n < pSnap->nConst && rc == SXRET_OK ; ++n) {
+		rc = VmCloneConstant(&(*pVm), apEntry[SySetUsed(&aEntry) - n - 1]);
+	}
+	if(rc == SXRET_OK) {
+		/* Load the program */
+		rc = PH7_VmPushFilePath(&(*pVm), pSnap->sKey.sPath.zString, (int)pSnap->sKey.sPath.nByte, TRUE, 0);
+		if(rc == SXRET_OK) {
+			rc = PH7_VmLoadImage(&(*pVm), &pSnap->sKey, SyBlobData(&pSnap->sImage), SyBlobLength(&pSnap->sImage));
+		}
+	}
+	for(; n < SySetUsed(&aEntry) && rc == SXRET_OK ; ++n) {
+		rc = VmCloneConstant(&(*pVm), apEntry[SySetUsed(&aEntry) - n - 1]);
+	}
+	SySetRelease(&aEntry);
+	if(rc != SXRET_OK) {
+		return rc;
+	}
+	/* Share the image */
+	pSnap->nRef++;
+	pVm->pSnapshot = pSnap;
+	return SXRET_OK;
+}
 /*
  * Initialize a foreign function call context.
  * The context in which a foreign function executes is stored in a ph7_context object.
@@ -1285,8 +1801,12 @@ PH7_PRIVATE ph7_value *PH7_ReserveMemObj(ph7_vm *pVm) {
 	nIdx = SXU32_HIGH; /* cc warning */
 	pSlot = (VmSlot *)SySetPop(&pVm->aFreeObj);
 	if(pSlot) {
-		pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pSlot->nIdx);
-		nIdx = pSlot->nIdx;
+		/* Recycled slot, allocate a fresh cell for it */
+		pObj = (ph7_value *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(ph7_value));
+		if(pObj) {
+			nIdx = pSlot->nIdx;
+			((ph7_value **)SySetBasePtr(&pVm->aMemObj))[nIdx] = pObj;
+		}
 	}
 	if(pObj == 0) {
 		/* Reserve a new memory object */
@@ -1340,11 +1860,11 @@ static ph7_value *VmCreateMemObj(
 	if(rc != SXRET_OK) {
 		PH7_VmMemoryError(&(*pVm));
 	}
-	/* Register local variable */
+	/* Register local variable, the frame owns it until it is left or the variable is unset.
+	 * There is no need to install it in the reference table.
+	 */
 	sLocal.nIdx = nIdx;
 	SySetPut(&pVm->pFrame->sLocal, (const void *)&sLocal);
-	/* Install in the reference table */
-	PH7_VmRefObjInstall(&(*pVm), nIdx, SyHashLastEntry(&pVm->pFrame->hVar), 0, 0);
 	/* Save object index */
 	pObj->nIdx = nIdx;
 	return pObj;
@@ -1387,7 +1907,7 @@ static ph7_value *VmExtractMemObj(
 			if(pEntry) {
 				/* Extract variable contents */
 				nIdx = (sxu32)SX_PTR_TO_INT(pEntry->pUserData);
-				pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+				pObj = PH7_VmMemObjAt(pVm, nIdx);
 				if(bNullify && pObj) {
 					PH7_MemObjRelease(pObj);
 				}
@@ -1406,7 +1926,7 @@ static ph7_value *VmExtractMemObj(
 	} else {
 		/* Extract from superglobal */
 		nIdx = (sxu32)SX_PTR_TO_INT(pEntry->pUserData);
-		pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+		pObj = PH7_VmMemObjAt(pVm, nIdx);
 	}
 	return pObj;
 }
@@ -1431,7 +1951,7 @@ static ph7_value *VmExtractSuper(
 	/* Extract the superglobal index in the global object pool */
 	nIdx = SX_PTR_TO_INT(pEntry->pUserData);
 	/* Extract the variable value  */
-	pValue = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+	pValue = PH7_VmMemObjAt(pVm, nIdx);
 	return pValue;
 }
 /*
@@ -1521,11 +2041,43 @@ PH7_PRIVATE sxi32 PH7_VmConfigure(
 				/* Remove leading and trailing white spaces */
 				SyStringFullTrim(&sPath);
 				if(sPath.nByte > 0) {
+					/* Keep a private copy, the caller buffer may live on the stack */
+					sPath.zString = SyMemBackendStrDup(&pVm->sAllocator, sPath.zString, sPath.nByte);
+					if(sPath.zString == 0) {
+						rc = SXERR_MEM;
+						break;
+					}
 					/* Store the path in the corresponding container */
 					rc = SySetPut(&pVm->aPaths, (const void *)&sPath);
 				}
 				break;
 			}
+		case PH7_VM_CONFIG_MODULE_PATH: {
+				/* Dynamic modules search path */
+				const char *zPath;
+				SyString sPath;
+				zPath = va_arg(ap, const char *);
+				if(zPath == 0) {
+					rc = SXERR_EMPTY;
+					break;
+				}
+				SyStringInitFromBuf(&sPath, zPath, SyStrlen(zPath));
+				/* Remove trailing slashes and backslashes */
+#ifdef __WINNT__
+				SyStringTrimTrailingChar(&sPath, '\\');
+#endif
+				SyStringTrimTrailingChar(&sPath, '/');
+				SyStringFullTrim(&sPath);
+				if(sPath.nByte > 0) {
+					sPath.zString = SyMemBackendStrDup(&pVm->sAllocator, sPath.zString, sPath.nByte);
+					if(sPath.zString == 0) {
+						rc = SXERR_MEM;
+						break;
+					}
+					rc = SySetPut(&pVm->aModulePaths, (const void *)&sPath);
+				}
+				break;
+			}
 		case PH7_VM_CONFIG_ERR_REPORT:
 			/* Run-Time Error report */
 			pVm->bErrReport = 1;
@@ -1555,7 +2107,7 @@ PH7_PRIVATE sxi32 PH7_VmConfigure(
 					/* Variable already installed */
 					nIdx = SX_PTR_TO_INT(pEntry->pUserData);
 					/* Extract contents */
-					pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+					pObj = PH7_VmMemObjAt(pVm, nIdx);
 					if(pObj) {
 						/* Overwrite old contents */
 						PH7_MemObjStore(pValue, pObj);
@@ -1668,16 +2220,58 @@ PH7_PRIVATE sxi32 PH7_VmConfigure(
 				rc = SySetPut(&pVm->aIOstream, (const void *)&pStream);
 				break;
 			}
-		case PH7_VM_CONFIG_EXTRACT_OUTPUT: {
-				/* Point to the VM internal output consumer buffer */
-				const void **ppOut = va_arg(ap, const void **);
-				unsigned int *pLen = va_arg(ap, unsigned int *);
-				if(ppOut == 0 || pLen == 0) {
+		case PH7_VM_CONFIG_EXTRACT_OUTPUT: {
+				/* Point to the VM internal output consumer buffer */
+				const void **ppOut = va_arg(ap, const void **);
+				unsigned int *pLen = va_arg(ap, unsigned int *);
+				if(ppOut == 0 || pLen == 0) {
+					rc = SXERR_CORRUPT;
+					break;
+				}
+				*ppOut = SyBlobData(&pVm->sConsumer);
+				*pLen  = SyBlobLength(&pVm->sConsumer);
+				break;
+			}
+		case PH7_VM_CONFIG_GC_BUDGET: {
+				/* Cycle collector time slice in microseconds */
+				pVm->nGcBudget = va_arg(ap, unsigned int);
+				break;
+			}
+		case PH7_VM_CONFIG_OBJ_CACHE_STATS: {
+				/* Class instances freelists hits and misses */
+				unsigned int *pHit = va_arg(ap, unsigned int *);
+				unsigned int *pMiss = va_arg(ap, unsigned int *);
+				if(pHit == 0 || pMiss == 0) {
+					rc = SXERR_CORRUPT;
+					break;
+				}
+				*pHit = pVm->nObjCacheHit;
+				*pMiss = pVm->nObjCacheMiss;
+				break;
+			}
+		case PH7_VM_CONFIG_INCLUDE_CACHE_STATS: {
+				/* Compiled include chunks cache hits and misses */
+				unsigned int *pHit = va_arg(ap, unsigned int *);
+				unsigned int *pMiss = va_arg(ap, unsigned int *);
+				if(pHit == 0 || pMiss == 0) {
+					rc = SXERR_CORRUPT;
+					break;
+				}
+				*pHit = pVm->nIncludeHit;
+				*pMiss = pVm->nIncludeMiss;
+				break;
+			}
+		case PH7_VM_CONFIG_STARTUP_STATS: {
+				/* Startup phases duration */
+				unsigned int *aPhase = va_arg(ap, unsigned int *);
+				sxu32 n;
+				if(aPhase == 0) {
 					rc = SXERR_CORRUPT;
 					break;
 				}
-				*ppOut = SyBlobData(&pVm->sConsumer);
-				*pLen  = SyBlobLength(&pVm->sConsumer);
+				for(n = 0 ; n < PH7_PHASE_COUNT ; ++n) {
+					aPhase[n] = pVm->aPhase[n];
+				}
 				break;
 			}
 		case PH7_VM_CONFIG_HTTP_REQUEST: {
@@ -1878,6 +2472,10 @@ static sxi32 VmByteCodeExec(
 		pInstr->bExec = TRUE;
 		/* Record executed instruction in global container */
 		SySetPut(&pVm->aInstrSet, (void *)pInstr);
+		if(SySetUsed(&pVm->aFreeQueue) > 0) {
+			/* Safe point, release a slice of the deferred structures */
+			PH7_VmReleaseDeferred(&(*pVm), PH7_FREE_SLICE);
+		}
 		rc = SXRET_OK;
 		/*
 		 * What follows here is a massive switch statement where each case implements a
@@ -2312,6 +2910,7 @@ static sxi32 VmByteCodeExec(
 									pFrame = pFrame->pParent; /* Parent frame */
 								}
 								SyHashEntry *pEntry;
+								void *pUserData = 0;
 								/* Candidate for expansion via user defined callbacks */
 								for(;;) {
 									pEntry = SyHashGet(&pVm->pFrame->hConst, SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob));
@@ -2323,14 +2922,19 @@ static sxi32 VmByteCodeExec(
 								}
 								if(pEntry == 0) {
 									pEntry = SyHashGet(&pVm->hConstant, SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob));
+									if(pEntry == 0) {
+										/* Built-in constants are expanded with the calling VM as private data */
+										pEntry = SyHashGet(&pVm->pEngine->pBuiltin->hConst, SyBlobData(&pObj->sBlob), SyBlobLength(&pObj->sBlob));
+										pUserData = &(*pVm);
+									}
 								}
-								if(pEntry) {
+								if(pEntry && pEntry->pUserData) {
 									ph7_constant *pCons = (ph7_constant *)pEntry->pUserData;
 									/* Set a NULL default value */
 									MemObjSetType(pTos, MEMOBJ_NULL);
 									SyBlobReset(&pTos->sBlob);
 									/* Invoke the callback and deal with the expanded value */
-									pCons->xExpand(pTos, pCons->pUserData);
+									pCons->xExpand(pTos, pUserData ? pUserData : pCons->pUserData);
 									/* Mark as constant */
 									pTos->nIdx = SXU32_HIGH;
 									break;
@@ -2600,7 +3204,7 @@ static sxi32 VmByteCodeExec(
 							pTos->nIdx = SXU32_HIGH;
 						} else {
 							/* Point to the desired memory object */
-							pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+							pObj = PH7_VmMemObjAt(pVm, nIdx);
 							if(pObj) {
 								/* Perform the store operation */
 								rc = PH7_MemObjSafeStore(pTos, pObj);
@@ -2670,7 +3274,7 @@ static sxi32 VmByteCodeExec(
 						}
 					} else {
 						ph7_value *pObj;
-						pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+						pObj = PH7_VmMemObjAt(pVm, nIdx);
 						if(pObj == 0) {
 							if(pKey) {
 								PH7_MemObjRelease(pKey);
@@ -2699,8 +3303,13 @@ static sxi32 VmByteCodeExec(
 								nOfft = (sxu32)pKey->x.iVal;
 								if(nOfft < SyBlobLength(&pObj->sBlob) && SyBlobLength(&pTos->sBlob) > 0) {
 									const char *zBlob = (const char *)SyBlobData(&pTos->sBlob);
-									char *zData = (char *)SyBlobData(&pObj->sBlob);
+									char *zData;
+									/* Copy-on-write: the buffer may be shared with other values */
+									SyBlobDetach(&pObj->sBlob);
+									zData = (char *)SyBlobData(&pObj->sBlob);
 									zData[nOfft] = zBlob[0];
+									/* Contents modified in-place */
+									SyBlobDirty(&pObj->sBlob);
 								} else {
 									if(SyBlobLength(&pTos->sBlob) >= sizeof(char)) {
 										/* Perform an append operation */
@@ -2760,7 +3369,7 @@ static sxi32 VmByteCodeExec(
 				if(PH7_MemObjIsNumeric(pTos) && !PH7_MemObjIsHashmap(pTos)) {
 					if(pTos->nIdx != SXU32_HIGH) {
 						ph7_value *pObj;
-						if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+						if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 							if(pObj->nType & MEMOBJ_REAL) {
 								pObj->x.rVal++;
 							} else {
@@ -2801,7 +3410,7 @@ static sxi32 VmByteCodeExec(
 				if(PH7_MemObjIsNumeric(pTos) & !PH7_MemObjIsHashmap(pTos)) {
 					if(pTos->nIdx != SXU32_HIGH) {
 						ph7_value *pObj;
-						if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+						if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 							if(pObj->nType & MEMOBJ_REAL) {
 								pObj->x.rVal--;
 							} else {
@@ -2941,7 +3550,7 @@ static sxi32 VmByteCodeExec(
 						ph7_value *pObj;
 						if(pTos->nIdx == SXU32_HIGH) {
 							PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-						} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+						} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 							PH7_MemObjStore(pNos, pObj);
 						}
 					}
@@ -3017,7 +3626,7 @@ static sxi32 VmByteCodeExec(
 					/* Perform the store operation */
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pTos, pObj);
 					}
 					/* Ticket 1433-35: Perform a stack dup */
@@ -3103,7 +3712,7 @@ static sxi32 VmByteCodeExec(
 					}
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pNos, pObj);
 					}
 					VmPopOperand(&pTos, 1);
@@ -3183,7 +3792,7 @@ static sxi32 VmByteCodeExec(
 					MemObjSetType(pNos, MEMOBJ_INT);
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pNos, pObj);
 					}
 					VmPopOperand(&pTos, 1);
@@ -3260,7 +3869,7 @@ static sxi32 VmByteCodeExec(
 					}
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pNos, pObj);
 					}
 					VmPopOperand(&pTos, 1);
@@ -3380,7 +3989,7 @@ static sxi32 VmByteCodeExec(
 					MemObjSetType(pNos, MEMOBJ_INT);
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pNos, pObj);
 					}
 					VmPopOperand(&pTos, 1);
@@ -3472,7 +4081,7 @@ static sxi32 VmByteCodeExec(
 					MemObjSetType(pNos, MEMOBJ_INT);
 					if(pTos->nIdx == SXU32_HIGH) {
 						PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot perform assignment on a constant class attribute");
-					} else if((pObj = (ph7_value *)SySetAt(&pVm->aMemObj, pTos->nIdx)) != 0) {
+					} else if((pObj = PH7_VmMemObjAt(pVm, pTos->nIdx)) != 0) {
 						PH7_MemObjStore(pNos, pObj);
 					}
 					VmPopOperand(&pTos, 1);
@@ -3807,51 +4416,12 @@ static sxi32 VmByteCodeExec(
 			 */
 			case PH7_OP_IMPORT:
 				{
-					VmModule pModule, *pSearch;
-					char *zModule = (char *) pInstr->p3;
-					int nLen = SyStrlen(zModule);
-					if(nLen < 1) {
+					SyString sModule;
+					SyStringInitFromBuf(&sModule, (const char *)pInstr->p3, SyStrlen((const char *)pInstr->p3));
+					if(sModule.nByte < 1) {
 						break;
 					}
-					while(SySetGetNextEntry(&pVm->aModules, (void **)&pSearch) == SXRET_OK) {
-						if(SyStrncmp(pSearch->sName.zString, zModule, (sxu32)(SXMAX((int) pSearch->sName.nByte, nLen))) == 0) {
-							SySetResetCursor(&pVm->aModules);
-							break;
-						}
-					}
-					SySetResetCursor(&pVm->aModules);
-
-					/* Zero the module entry */
-					SyZero(&pModule, sizeof(VmModule));
-					SyStringInitFromBuf(&pModule.sName, zModule, nLen);
-					char bfile[255] = {0};
-					char *file;
-					snprintf(bfile, sizeof(bfile) - 1, "./binary/%s%s", zModule, PH7_LIBRARY_SUFFIX);
-					file = bfile;
-					SyStringInitFromBuf(&pModule.sFile, file, nLen);
-#ifdef __WINNT__
-					pModule.pHandle = LoadLibrary(file);
-#else
-					pModule.pHandle = dlopen(pModule.sFile.zString, RTLD_LAZY);
-#endif
-					if(!pModule.pHandle) {
-						/* Could not load the module library file */
-						PH7_VmThrowError(pVm, PH7_CTX_ERR, "ImportError: No module named '%z' found", &pModule.sName);
-					}
-					void (*init)(ph7_vm *, ph7_real *, SyString *);
-#ifdef __WINNT__
-					*(void**)(&init) = GetProcAddress(pModule.pHandle, "initializeModule");
-#else
-					*(void**)(&init) = dlsym(pModule.pHandle, "initializeModule");
-#endif
-					if(!init) {
-						/* Could not find the module entry point */
-						PH7_VmThrowError(pVm, PH7_CTX_ERR, "ImportError: Method '%z::initializeModule()' not found", &pModule.sName);
-					}
-					/* Initialize the module */
-					init(pVm, &pModule.fVer, &pModule.sDesc);
-					/* Put information about module on top of the modules stack */
-					SySetPut(&pVm->aModules, (const void *)&pModule);
+					VmImportModule(&(*pVm), &sModule);
 					break;
 				}
 			/*
@@ -4028,6 +4598,8 @@ static sxi32 VmByteCodeExec(
 						if(PH7_MemObjSafeStore(&pTmp, pValue) != SXRET_OK) {
 							PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Cannot assign a value of incompatible type to variable '$%z'", &pInfo->sValue);
 						}
+						/* Drop the references held by the temporary copy */
+						PH7_MemObjRelease(&pTmp);
 					}
 					break;
 				}
@@ -4160,7 +4732,7 @@ static sxi32 VmByteCodeExec(
 									/* Check attribute access */
 									if(VmClassMemberAccess(&(*pVm), pObjAttr->pAttr->pClass, pObjAttr->pAttr->iProtection)) {
 										/* Load attribute */
-										pValue = (ph7_value *)SySetAt(&pVm->aMemObj, pObjAttr->nIdx);
+										pValue = PH7_VmMemObjAt(pVm, pObjAttr->nIdx);
 										if(pValue) {
 											if(pThis->iRef < 2) {
 												/* Perform a store operation,rather than a load operation since
@@ -4287,7 +4859,7 @@ static sxi32 VmByteCodeExec(
 											/* Check if the access to the attribute is allowed */
 											if(VmClassMemberAccess(&(*pVm), pClass, pAttr->iProtection)) {
 												/* Load the desired attribute */
-												pValue = (ph7_value *)SySetAt(&pVm->aMemObj, pAttr->nIdx);
+												pValue = PH7_VmMemObjAt(pVm, pAttr->nIdx);
 												if(pValue) {
 													PH7_MemObjLoad(pValue, pTos);
 													if(pAttr->iFlags & PH7_CLASS_ATTR_STATIC) {
@@ -4822,7 +5394,7 @@ static sxi32 VmByteCodeExec(
 								/* Make sure the referenced object is not a local variable */
 								for(i = 0 ; i < SySetUsed(&pFrame->sLocal) ; ++i) {
 									if(n == aSlot[i].nIdx) {
-										pObj = (ph7_value *)SySetAt(&pVm->aMemObj, n);
+										pObj = PH7_VmMemObjAt(pVm, n);
 										n = SXU32_HIGH;
 										break;
 									}
@@ -4851,12 +5423,12 @@ static sxi32 VmByteCodeExec(
 						}
 						/* Free the operand stack */
 						SyMemBackendFree(&pVm->sAllocator, pFrameStack);
-						/* Leave the frame */
-						VmLeaveFrame(&(*pVm));
 						if(pClass != 0 && pClass != pThis->pClass) {
-							/* Restore original class */
+							/* Restore original class, the instance may be released with the frame */
 							pThis->pClass = pClass;
 						}
+						/* Leave the frame */
+						VmLeaveFrame(&(*pVm));
 						if(rc == PH7_ABORT) {
 							/* Abort processing immediately */
 							goto Abort;
@@ -4868,12 +5440,11 @@ static sxi32 VmByteCodeExec(
 						ph7_context sCtx;
 						ph7_value sRet;
 						/* Look for an installed foreign function */
-						pEntry = SyHashGet(&pVm->hHostFunction, (const void *)sName.zString, sName.nByte);
-						if(pEntry == 0) {
+						pFunc = PH7_VmExtractForeignFunction(&(*pVm), sName.zString, sName.nByte);
+						if(pFunc == 0) {
 							/* Call to undefined function */
 							PH7_VmThrowError(&(*pVm), PH7_CTX_ERR, "Call to undefined function '%z()'", &sName);
 						}
-						pFunc = (ph7_user_func *)pEntry->pUserData;
 						/* Start collecting function arguments */
 						SySetReset(&aArg);
 						while(pArg < pTos) {
@@ -5030,7 +5601,7 @@ PH7_PRIVATE sxi32 PH7_VmByteCodeExec(ph7_vm *pVm) {
 	ph7_value *pArgs, *sArgv, *pObj;
 	ph7_value pResult;
 	char *zDup, *zParam;
-	sxu32 nByte;
+	sxu32 nByte, n;
 	/* Make sure we are ready to execute this program */
 	if(pVm->nMagic != PH7_VM_RUN) {
 		return (pVm->nMagic == PH7_VM_EXEC || pVm->nMagic == PH7_VM_INCL) ? SXERR_LOCKED /* Locked VM */ : SXERR_CORRUPT; /* Stale VM */
@@ -5093,10 +5664,21 @@ PH7_PRIVATE sxi32 PH7_VmByteCodeExec(ph7_vm *pVm) {
 			pVm->iExitStatus = 0;
 		}
 	}
+	/* Run the pending destructors while the attributes they may access are still alive */
+	VmReleaseQueuedDestructors(&(*pVm), pVm->nFreeHead);
 	/* Garbage collector over all elements in object allocation table */
-	while(SySetGetNextEntry(&pVm->aMemObj, (void **)&pObj) == SXRET_OK) {
-		PH7_MemObjRelease(pObj);
+	for(n = 0 ; n < SySetUsed(&pVm->aMemObj) ; ++n) {
+		pObj = PH7_VmMemObjAt(pVm, n);
+		if(pObj) {
+			sxu32 nQueued = SySetUsed(&pVm->aFreeQueue);
+			PH7_MemObjRelease(pObj);
+			if(SySetUsed(&pVm->aFreeQueue) > nQueued) {
+				VmReleaseQueuedDestructors(&(*pVm), nQueued);
+			}
+		}
 	}
+	/* Release whatever is left in the deferred queue */
+	PH7_VmReleaseDeferred(&(*pVm), 0);
 	/* Invoke any shutdown callbacks */
 	VmInvokeShutdownCallbacks(&(*pVm));
 	/*
@@ -5195,7 +5777,7 @@ static int vm_builtin_func_exists(ph7_context *pCtx, int nArg, ph7_value **apArg
 	res = 0;
 	/* Perform the lookup */
 	if(SyHashGet(&pVm->hFunction, (const void *)zName, (sxu32)nLen) != 0 ||
-			SyHashGet(&pVm->hHostFunction, (const void *)zName, (sxu32)nLen) != 0) {
+			PH7_VmExtractForeignFunction(&(*pVm), zName, (sxu32)nLen) != 0) {
 		/* Function is defined */
 		res = 1;
 	}
@@ -5233,13 +5815,13 @@ PH7_PRIVATE int PH7_VmIsCallable(ph7_vm *pVm, ph7_value *pValue, int CallInvoke)
 			ph7_class *pClass;
 			ph7_value *pV;
 			/* Extract the target class */
-			pV = (ph7_value *)SySetAt(&pVm->aMemObj, pMap->pFirst->nValIdx);
+			pV = PH7_VmMemObjAt(pVm, pMap->pFirst->nValIdx);
 			if(pV) {
 				pClass = VmExtractClassFromValue(pVm, pV);
 				if(pClass) {
 					ph7_class_method *pMethod;
 					/* Extract the target method */
-					pV = (ph7_value *)SySetAt(&pVm->aMemObj, pMap->pFirst->pPrev->nValIdx);
+					pV = PH7_VmMemObjAt(pVm, pMap->pFirst->pPrev->nValIdx);
 					if(pV && (pV->nType & MEMOBJ_STRING) && SyBlobLength(&pV->sBlob) > 0) {
 						/* Perform the lookup */
 						pMethod = PH7_ClassExtractMethod(pClass, (const char *)SyBlobData(&pV->sBlob), SyBlobLength(&pV->sBlob));
@@ -5258,7 +5840,7 @@ PH7_PRIVATE int PH7_VmIsCallable(ph7_vm *pVm, ph7_value *pValue, int CallInvoke)
 		zName = ph7_value_to_string(pValue, &nLen);
 		/* Perform the lookup */
 		if(SyHashGet(&pVm->hFunction, (const void *)zName, (sxu32)nLen) != 0 ||
-				SyHashGet(&pVm->hHostFunction, (const void *)zName, (sxu32)nLen) != 0) {
+				PH7_VmExtractForeignFunction(&(*pVm), zName, (sxu32)nLen) != 0) {
 			/* Function is callable */
 			res = 1;
 		}
@@ -5878,7 +6460,7 @@ static int vm_builtin_get_class_vars(ph7_context *pCtx, int nArg, ph7_value **ap
 			ph7_value *pValue = 0;
 			if(pAttr->iFlags & (PH7_CLASS_ATTR_CONSTANT | PH7_CLASS_ATTR_STATIC)) {
 				/* Extract static attribute value which is always computed */
-				pValue = (ph7_value *)SySetAt(&pCtx->pVm->aMemObj, pAttr->nIdx);
+				pValue = PH7_VmMemObjAt(pCtx->pVm, pAttr->nIdx);
 			} else {
 				if(SySetUsed(&pAttr->aByteCode) > 0) {
 					PH7_MemObjRelease(&sValue);
@@ -6094,6 +6676,33 @@ static int vm_builtin_is_a(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 	ph7_result_bool(pCtx, res);
 	return PH7_OK;
 }
+/*
+ * array get_object_cache_stats(void)
+ *  Gets the class instances recycling statistics of the running request.
+ * Parameter
+ *  None
+ * Return
+ *  An associative array holding the number of instances recycled from the class
+ *  freelists ["hits"] and the number of instances allocated from scratch ["misses"].
+ */
+static int vm_builtin_get_object_cache_stats(ph7_context *pCtx, int nArg, ph7_value **apArg) {
+	ph7_value *pArray, *pValue;
+	SXUNUSED(nArg); /* cc warning */
+	SXUNUSED(apArg);
+	pArray = ph7_context_new_array(pCtx);
+	pValue = ph7_context_new_scalar(pCtx);
+	if(pArray == 0 || pValue == 0) {
+		/* Out of memory, return null */
+		ph7_result_null(pCtx);
+		return PH7_OK;
+	}
+	ph7_value_int(pValue, (int)pCtx->pVm->nObjCacheHit);
+	ph7_array_add_strkey_elem(pArray, "hits", pValue); /* Will make it's own copy */
+	ph7_value_int(pValue, (int)pCtx->pVm->nObjCacheMiss);
+	ph7_array_add_strkey_elem(pArray, "misses", pValue);
+	ph7_result_value(pCtx, pArray);
+	return PH7_OK;
+}
 /*
  * bool is_subclass_of(object/string $object,object/string $class_name)
  *   Checks if the object has this class as one of its parents.
@@ -6308,6 +6917,10 @@ static int VmHashConstStep(SyHashEntry *pEntry, void *pUserData) {
 	ph7_value *pArray = (ph7_value *)pUserData;
 	ph7_value sName;
 	sxi32 rc;
+	if(pEntry->pUserData == 0) {
+		/* Deleted built-in constant */
+		return SXRET_OK;
+	}
 	/* Prepare the constant name for insertion */
 	PH7_MemObjInitFromString(pArray->pVm, &sName, 0);
 	PH7_MemObjStringAppend(&sName, (const char *)pEntry->pKey, pEntry->nKeyLen);
@@ -6316,6 +6929,17 @@ static int VmHashConstStep(SyHashEntry *pEntry, void *pUserData) {
 	PH7_MemObjRelease(&sName);
 	return rc;
 }
+/*
+ * Same as VmHashConstStep() but for the built-in constants, which may
+ * have been deleted or redefined in the VM.
+ */
+static int VmHashBuiltinConstStep(SyHashEntry *pEntry, void *pUserData) {
+	ph7_value *pArray = (ph7_value *)pUserData;
+	if(SyHashGet(&pArray->pVm->hConstant, pEntry->pKey, pEntry->nKeyLen) != 0) {
+		return SXRET_OK;
+	}
+	return VmHashConstStep(&(*pEntry), pUserData);
+}
 /*
  * array get_defined_constants(void)
  *  Returns an associative array with the names of all defined
@@ -6338,6 +6962,7 @@ static int vm_builtin_get_defined_constants(ph7_context *pCtx, int nArg, ph7_val
 	}
 	/* Fill the array with the defined constants */
 	SyHashForEach(&pCtx->pVm->hConstant, VmHashConstStep, pArray);
+	SyHashForEach(&pCtx->pVm->pEngine->pBuiltin->hConst, VmHashBuiltinConstStep, pArray);
 	/* Return the created array */
 	ph7_result_value(pCtx, pArray);
 	return SXRET_OK;
@@ -6584,7 +7209,7 @@ static int vm_builtin_ob_start(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 	sxi32 rc;
 	/* Initialize the OB entry */
 	PH7_MemObjInit(pCtx->pVm, &sOb.sCallback);
-	SyBlobInit(&sOb.sOB, &pVm->sAllocator);
+	SyBlobInit(&sOb.sOB, &pVm->sArena);
 	if(nArg > 0 && (apArg[0]->nType & (MEMOBJ_STRING | MEMOBJ_HASHMAP))) {
 		/* Save the callback name for later invocation */
 		PH7_MemObjStore(apArg[0], &sOb.sCallback);
@@ -7115,7 +7740,7 @@ static int vm_builtin_exit(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 PH7_PRIVATE sxi32 PH7_VmUnsetMemObj(ph7_vm *pVm, sxu32 nObjIdx, int bForce) {
 	ph7_value *pObj;
 	VmRefObj *pRef;
-	pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nObjIdx);
+	pObj = PH7_VmMemObjAt(pVm, nObjIdx);
 	if(pObj) {
 		/* Release the object */
 		PH7_MemObjRelease(pObj);
@@ -7127,15 +7752,175 @@ PH7_PRIVATE sxi32 PH7_VmUnsetMemObj(ph7_vm *pVm, sxu32 nObjIdx, int bForce) {
 		/* Unlink from the reference table */
 		VmRefObjUnlink(&(*pVm), pRef);
 		if((bForce == TRUE) || (iFlags & VM_REF_IDX_KEEP) == 0) {
-			VmSlot sFree;
 			/* Restore to the free list */
-			sFree.nIdx = nObjIdx;
-			sFree.pUserData = 0;
-			SySetPut(&pVm->aFreeObj, (const void *)&sFree);
+			VmRecycleMemObj(&(*pVm), nObjIdx);
 		}
+	} else if(bForce == TRUE) {
+		/* Not referenced, the slot belongs to the caller [i.e: Frame, class instance] */
+		VmRecycleMemObj(&(*pVm), nObjIdx);
 	}
 	return SXRET_OK;
 }
+/*
+ * Queue an unreferenced hashmap or class instance for deferred release.
+ * Return SXRET_OK on success, any other value if the structure must be
+ * released right away [i.e: Program not running].
+ */
+PH7_PRIVATE sxi32 PH7_VmDeferRelease(ph7_vm *pVm, void *pObj, sxi32 iType) {
+	VmFreeEntry sEntry;
+	if(pVm->nMagic != PH7_VM_EXEC) {
+		/* Nothing would drain the queue */
+		return SXERR_PERM;
+	}
+	sEntry.pObj = pObj;
+	sEntry.iType = iType;
+	return SySetPut(&pVm->aFreeQueue, (const void *)&sEntry);
+}
+/*
+ * Release the structures queued by PH7_VmDeferRelease() until the queue is empty
+ * or nMax entries [i.e: Array entries or objects] were released [0 for no limit].
+ * Structures released meanwhile are queued as well, so that nested arrays and
+ * objects are released iteratively rather than recursively. The queue is drained
+ * in FIFO order, hence destructors are invoked in the order the objects were released.
+ */
+PH7_PRIVATE void PH7_VmReleaseDeferred(ph7_vm *pVm, sxu32 nMax) {
+	VmFreeEntry *pEntry, sEntry;
+	sxu32 nBudget = nMax;
+	if(pVm->nFreeDepth > 0) {
+		/* Another release is in progress, not a safe point */
+		return;
+	}
+	pVm->nFreeDepth = PH7_FREE_DEPTH_LIMIT;
+	while(pVm->nFreeHead < SySetUsed(&pVm->aFreeQueue)) {
+		/* The queue may grow meanwhile, so work on a copy of the entry */
+		pEntry = (VmFreeEntry *)SySetAt(&pVm->aFreeQueue, pVm->nFreeHead);
+		sEntry = pEntry[0];
+		if(sEntry.pObj == 0) {
+			/* Already released, see VmReleaseQueuedDestructors() */
+			pVm->nFreeHead++;
+			continue;
+		}
+		if(sEntry.iType == MEMOBJ_HASHMAP) {
+			if(PH7_HashmapReleaseSlice((ph7_hashmap *)sEntry.pObj, nMax > 0 ? &nBudget : 0) == SXRET_OK) {
+				pVm->nFreeHead++;
+			}
+			/* Otherwise partially released, resume on the next slice */
+		} else {
+			pVm->nFreeHead++;
+			PH7_ClassInstanceDestroy((ph7_class_instance *)sEntry.pObj);
+			if(nBudget > 0) {
+				nBudget--;
+			}
+		}
+		if(nMax > 0 && nBudget < 1) {
+			/* Slice exhausted */
+			break;
+		}
+	}
+	if(pVm->nFreeHead >= SySetUsed(&pVm->aFreeQueue)) {
+		/* Queue drained */
+		SySetReset(&pVm->aFreeQueue);
+		pVm->nFreeHead = 0;
+	}
+	pVm->nFreeDepth = 0;
+}
+/*
+ * Return TRUE if releasing the given queued structure invokes a destructor, that is
+ * a class instance defining one or a hashmap holding such instances. Deeper nesting
+ * is not inspected, those destructors run at the next safe points.
+ */
+static int VmFreeEntryHasDestructor(ph7_vm *pVm, const VmFreeEntry *pEntry) {
+	ph7_class *pLast = 0;
+	ph7_hashmap_node *pNode;
+	ph7_hashmap *pMap;
+	ph7_value *pValue;
+	sxu32 n;
+	if(pEntry->iType != MEMOBJ_HASHMAP) {
+		return PH7_ClassExtractMethod(((ph7_class_instance *)pEntry->pObj)->pClass, "__destruct", sizeof("__destruct") - 1) != 0;
+	}
+	pMap = (ph7_hashmap *)pEntry->pObj;
+	pNode = pMap->pFirst;
+	for(n = 0 ; n < pMap->nEntry ; ++n) {
+		pValue = PH7_VmMemObjAt(&(*pVm), pNode->nValIdx);
+		if(pValue && (pValue->nType & (MEMOBJ_OBJ | MEMOBJ_HASHMAP)) == MEMOBJ_OBJ && pValue->x.pOther) {
+			ph7_class *pClass = ((ph7_class_instance *)pValue->x.pOther)->pClass;
+			if(pClass != pLast) {
+				if(PH7_ClassExtractMethod(pClass, "__destruct", sizeof("__destruct") - 1)) {
+					return TRUE;
+				}
+				/* Instances of the same class are usually stored together */
+				pLast = pClass;
+			}
+		}
+		/* Point to the next entry */
+		pNode = pNode->pPrev; /* Reverse link */
+	}
+	return FALSE;
+}
+/*
+ * Release right away the structures queued from the given entry onwards whose release
+ * invokes a destructor, so that destructors of released variables run before the
+ * caller resumes. Other structures are left in the queue and released in slices at
+ * the next safe points, their slot is emptied otherwise.
+ */
+static void VmReleaseQueuedDestructors(ph7_vm *pVm, sxu32 nFirst) {
+	VmFreeEntry *pEntry, sEntry;
+	sxu32 n;
+	if(pVm->nFreeDepth > 0) {
+		/* Another release is in progress, not a safe point */
+		return;
+	}
+	pVm->nFreeDepth = PH7_FREE_DEPTH_LIMIT;
+	/* Structures released meanwhile are queued as well */
+	for(n = nFirst ; n < SySetUsed(&pVm->aFreeQueue) ; ++n) {
+		pEntry = (VmFreeEntry *)SySetAt(&pVm->aFreeQueue, n);
+		sEntry = pEntry[0];
+		if(sEntry.pObj == 0 || !VmFreeEntryHasDestructor(&(*pVm), &sEntry)) {
+			continue;
+		}
+		pEntry->pObj = 0;
+		if(sEntry.iType == MEMOBJ_HASHMAP) {
+			PH7_HashmapReleaseSlice((ph7_hashmap *)sEntry.pObj, 0);
+		} else {
+			PH7_ClassInstanceDestroy((ph7_class_instance *)sEntry.pObj);
+		}
+	}
+	pVm->nFreeDepth = 0;
+}
+/*
+ * Variables are not installed in the reference table when they are created, so
+ * unset() looks for the frame owning the given memory object and removes the
+ * variable from it. Return TRUE if the object is a local variable of the active
+ * frame, FALSE otherwise [i.e: Array entry, attribute, static variable].
+ */
+static sxbool VmFrameUnlinkVar(ph7_vm *pVm, sxu32 nObjIdx) {
+	VmFrame *pFrame;
+	SyHashEntry *pEntry;
+	VmSlot *aSlot;
+	sxu32 n;
+	for(pFrame = pVm->pFrame ; pFrame ; pFrame = pFrame->pParent) {
+		aSlot = (VmSlot *)SySetBasePtr(&pFrame->sLocal);
+		for(n = 0 ; n < SySetUsed(&pFrame->sLocal) ; ++n) {
+			if(aSlot[n].nIdx == nObjIdx) {
+				/* The frame no longer owns this object */
+				aSlot[n].nIdx = SXU32_HIGH;
+				SyHashResetLoopCursor(&pFrame->hVar);
+				while((pEntry = SyHashGetNextEntry(&pFrame->hVar)) != 0) {
+					if((sxu32)SX_PTR_TO_INT(pEntry->pUserData) == nObjIdx) {
+						SyHashDeleteEntry2(pEntry);
+						break;
+					}
+				}
+				return TRUE;
+			}
+		}
+		if((pFrame->iFlags & VM_FRAME_EXCEPTION) == 0) {
+			/* Do not look past the active function frame */
+			break;
+		}
+	}
+	return FALSE;
+}
 /*
  * Forcibly destroy a memory object [i.e: a ph7_value], remove it from
  * the current frame, the reference table and discard it's contents.
@@ -7152,11 +7937,8 @@ PH7_PRIVATE sxi32 PH7_VmDestroyMemObj(ph7_vm *pVm, ph7_value *pObj) {
 			/* Unlink from the reference table */
 			VmRefObjUnlink(&(*pVm), pRef);
 		}
-		VmSlot sFree;
 		/* Restore to the free list */
-		sFree.nIdx = pObj->nIdx;
-		sFree.pUserData = 0;
-		SySetPut(&pVm->aFreeObj, (const void *)&sFree);
+		VmRecycleMemObj(&(*pVm), pObj->nIdx);
 	}
 	return SXRET_OK;
 }
@@ -7188,7 +7970,7 @@ static int vm_builtin_unset(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 				PH7_VmThrowError(pCtx->pVm, PH7_CTX_ERR, "Expecting a variable not AerScript statement");
 			}
 			sxu32 nIdx = pObj->nIdx;
-			PH7_VmUnsetMemObj(&(*pVm), nIdx, FALSE);
+			PH7_VmUnsetMemObj(&(*pVm), nIdx, VmFrameUnlinkVar(&(*pVm), nIdx));
 		}
 	}
 	return SXRET_OK;
@@ -7203,7 +7985,7 @@ static sxi32 VmHashVarWalker(SyHashEntry *pEntry, void *pUserData) {
 	sxu32 nIdx;
 	/* Extract the memory object */
 	nIdx = SX_PTR_TO_INT(pEntry->pUserData);
-	pObj = (ph7_value *)SySetAt(&pVm->aMemObj, nIdx);
+	pObj = PH7_VmMemObjAt(pVm, nIdx);
 	if(pObj) {
 		if((pObj->nType & MEMOBJ_HASHMAP) == 0) {
 			if(pEntry->nKeyLen > 0) {
@@ -7437,6 +8219,22 @@ static int vm_builtin_get_memory_usage(ph7_context *pCtx, int nArg, ph7_value **
 		ph7_result_int64(pCtx, pCtx->pVm->sAllocator.pHeap->nSize);
 	}
 	return PH7_OK;
+}
+/*
+ * int gc_collect_cycles()
+ *  Forces collection of any existing garbage cycles.
+ * Parameters
+ *  None
+ * Return
+ *  Number of collected objects.
+ */
+static int vm_builtin_gc_collect_cycles(ph7_context *pCtx, int nArg, ph7_value **apArg) {
+	sxu32 nFree;
+	SXUNUSED(nArg); /* cc warning */
+	SXUNUSED(apArg);
+	nFree = PH7_ClassInstanceCollectCycles(pCtx->pVm, 0);
+	ph7_result_int(pCtx, (int)nFree);
+	return PH7_OK;
 }/*
  * int/bool assert_options(int $what [, mixed $value ])
  *  Set/get the various assert flags.
@@ -7551,7 +8349,7 @@ static int vm_builtin_assert(ph7_context *pCtx, int nArg, ph7_value **apArg) {
 			ph7_value *apCbArg[3];
 			SyString *pFile;
 			/* Extract the processed script */
-			pFile = (SyString *)SySetPeek(&pVm->aFiles);
+			pFile = PH7_VmPeekFilePath(pVm);
 			if(pFile == 0) {
 				pFile = (SyString *)&sFileName;
 			}
@@ -7718,7 +8516,7 @@ static int vm_builtin_debug_backtrace(ph7_context *pCtx, int nArg, ph7_value **a
 		/* Extract closure/method arguments */
 		aSlot = (VmSlot *)SySetBasePtr(pTrace->pArg);
 		for(sxu32 n = 0;  n < SySetUsed(pTrace->pArg) ; n++) {
-			ph7_value *pObj = (ph7_value *)SySetAt(&pCtx->pVm->aMemObj, aSlot[n].nIdx);
+			ph7_value *pObj = PH7_VmMemObjAt(pCtx->pVm, aSlot[n].nIdx);
 			if(pObj) {
 				ph7_array_add_elem(pArg, 0, pObj);
 			}
@@ -7893,9 +8691,8 @@ static sxi32 VmThrowException(
 	}
 	/* Execute the 'finally' block if available */
 	if(pException && SySetUsed(&pException->sFinally)) {
+		/* The compiled block is kept, it runs again on the next throw or after a VM reset */
 		rcf = VmExecFinallyBlock(&(*pVm), pException);
-		/* Release the bytecode container */
-		SySetRelease(&pException->sFinally);
 	}
 	/* No matching 'catch' block found */
 	if(pCatch == 0) {
@@ -8067,6 +8864,27 @@ static int vm_builtin_ph7_version(ph7_context *pCtx, int nArg, ph7_value **apArg
 	"</span></small></small></p>"\
 	"<p style=\"text-align: right;\"><small><small>Copyright (C) <a href=\"https://www.symisc.net/\">Symisc Systems</a></small></small><big>"\
 	"</big></p></div></body></html>"
+/*
+ * Count the foreign functions visible from the given VM.
+ * Built-in functions are installed in the host functions table the first time they
+ * are called, while deleted ones are kept there as placeholders with no function.
+ */
+static sxu32 VmCountForeignFunctions(ph7_vm *pVm) {
+	SyHash *pBuiltin = &pVm->pEngine->pBuiltin->hFunc;
+	sxu32 nFunc = SyHashTotalEntry(pBuiltin);
+	SyHashEntry *pEntry;
+	SyHashResetLoopCursor(&pVm->hHostFunction);
+	while((pEntry = SyHashGetNextEntry(&pVm->hHostFunction)) != 0) {
+		if(SyHashGet(pBuiltin, pEntry->pKey, pEntry->nKeyLen) == 0) {
+			/* Host-application function */
+			nFunc++;
+		} else if(pEntry->pUserData == 0) {
+			/* Deleted built-in function */
+			nFunc--;
+		}
+	}
+	return nFunc;
+}
 /*
  * bool ph7credits(void)
  * bool ph7info(void)
@@ -8087,7 +8905,7 @@ static int vm_builtin_ph7_credits(ph7_context *pCtx, int nArg, ph7_value **apArg
 		ph7_lib_version(),   /* Engine version */
 		ph7_lib_signature(), /* Engine signature */
 		pVm->pEngine->pVfs ? pVm->pEngine->pVfs->zName : "null_vfs",
-		SyHashTotalEntry(&pVm->hFunction) + SyHashTotalEntry(&pVm->hHostFunction),/* # built-in functions */
+		SyHashTotalEntry(&pVm->hFunction) + VmCountForeignFunctions(&(*pVm)),/* # built-in functions */
 		SyHashTotalEntry(&pVm->hClass),
 #ifdef __WINNT__
 		"Windows NT"
@@ -8588,66 +9406,92 @@ static int VmExtractCallback(ph7_value *pKey, ph7_value *pValue, void *pUserData
 	return SXRET_OK;
 }
 /*
- * Compile and evaluate a PHP chunk at run-time.
- * Refer to the eval() language construct implementation for more
- * information.
+ * Compile a PHP chunk at run-time into the given bytecode container.
  */
-static sxi32 VmEvalChunk(
+static sxi32 VmCompileChunk(
 	ph7_vm *pVm,        /* Underlying Virtual Machine */
-	ph7_context *pCtx,  /* Call Context */
-	SyString *pChunk,   /* PHP chunk to evaluate */
-	int iFlags          /* Code evaluation flag */
+	SyString *pChunk,   /* PHP chunk to compile */
+	int iFlags,         /* Code evaluation flag */
+	SySet *pOut         /* Compiled bytecode */
 ) {
-	SySet *pByteCode, aByteCode;
+	SySet *pByteCode;
 	ProcConsumer xErr = 0;
 	void *pErrData = 0;
-	/* Initialize bytecode container */
-	SySetInit(&aByteCode, &pVm->sAllocator, sizeof(VmInstr));
-	SySetAlloc(&aByteCode, 0x20);
+	SyHashEntry *pEntry;
+	sxu32 nMagic;
+	sxi32 rc;
+	nMagic = pVm->nMagic;
 	/* Log compile-time errors */
 	xErr = pVm->pEngine->xConf.xErr;
 	pErrData = pVm->pEngine->xConf.pErrData;
 	PH7_ResetCodeGenerator(pVm, xErr, pErrData);
 	/* Swap bytecode container */
 	pByteCode = pVm->pByteContainer;
-	pVm->pByteContainer = &aByteCode;
+	pVm->pByteContainer = pOut;
 	/* Push memory as a processed file path */
 	if((iFlags & PH7_AERSCRIPT_FILE) == 0) {
 		PH7_VmPushFilePath(pVm, "[MEMORY]", -1, TRUE, 0);
 	}
-	/* Compile the chunk */
+	/* Compile the chunk, literals must outlive the running request */
+	if(nMagic == PH7_VM_EXEC) {
+		pVm->nMagic = PH7_VM_INCL;
+	}
 	PH7_CompileAerScript(pVm, pChunk, iFlags);
-	ph7_value sResult; /* Return value */
-	SyHashEntry *pEntry;
+	pVm->nMagic = nMagic;
+	rc = SXRET_OK;
 	/* Initialize and install static and constants class attributes */
 	SyHashResetLoopCursor(&pVm->hClass);
 	while((pEntry = SyHashGetNextEntry(&pVm->hClass)) != 0) {
-		if(VmMountUserClass(&(*pVm), (ph7_class *)pEntry->pUserData) != SXRET_OK) {
-			if(pCtx) {
-				ph7_result_bool(pCtx, 0);
-			}
-			goto Cleanup;
+		rc = VmMountUserClass(&(*pVm), (ph7_class *)pEntry->pUserData);
+		if(rc != SXRET_OK) {
+			break;
 		}
 	}
-	if(SXRET_OK != PH7_VmEmitInstr(pVm, 0, PH7_OP_DONE, 0, 0, 0, 0)) {
-		/* Out of memory */
-		if(pCtx) {
-			ph7_result_bool(pCtx, 0);
-		}
-		goto Cleanup;
+	if(rc == SXRET_OK) {
+		rc = PH7_VmEmitInstr(pVm, 0, PH7_OP_DONE, 0, 0, 0, 0);
 	}
+	/* Restore the old bytecode container */
+	pVm->pByteContainer = pByteCode;
+	return rc;
+}
+/*
+ * Execute a chunk previously compiled by VmCompileChunk().
+ */
+static void VmExecChunk(ph7_vm *pVm, ph7_context *pCtx, SySet *pByteCode) {
+	ph7_value sResult; /* Return value */
 	/* Assume a boolean true return value */
 	PH7_MemObjInitFromBool(pVm, &sResult, 1);
 	/* Execute the compiled chunk */
-	VmLocalExec(pVm, &aByteCode, &sResult);
+	VmLocalExec(pVm, pByteCode, &sResult);
 	if(pCtx) {
 		/* Set the execution result */
 		ph7_result_value(pCtx, &sResult);
 	}
 	PH7_MemObjRelease(&sResult);
-Cleanup:
+}
+/*
+ * Compile and evaluate a PHP chunk at run-time.
+ * Refer to the eval() language construct implementation for more
+ * information.
+ */
+static sxi32 VmEvalChunk(
+	ph7_vm *pVm,        /* Underlying Virtual Machine */
+	ph7_context *pCtx,  /* Call Context */
+	SyString *pChunk,   /* PHP chunk to evaluate */
+	int iFlags          /* Code evaluation flag */
+) {
+	SySet aByteCode;
+	/* Initialize bytecode container */
+	SySetInit(&aByteCode, &pVm->sAllocator, sizeof(VmInstr));
+	SySetAlloc(&aByteCode, 0x20);
+	if(VmCompileChunk(&(*pVm), &(*pChunk), iFlags, &aByteCode) != SXRET_OK) {
+		if(pCtx) {
+			ph7_result_bool(pCtx, 0);
+		}
+	} else {
+		VmExecChunk(&(*pVm), pCtx, &aByteCode);
+	}
 	/* Cleanup the mess left behind */
-	pVm->pByteContainer = pByteCode;
 	SySetRelease(&aByteCode);
 	return SXRET_OK;
 }
@@ -8699,7 +9543,7 @@ static int VmIsIncludedFile(ph7_vm *pVm, SyString *pFile) {
  * Push a file path in the appropriate VM container.
  */
 PH7_PRIVATE sxi32 PH7_VmPushFilePath(ph7_vm *pVm, const char *zPath, int nLen, sxu8 bMain, sxi32 *pNew) {
-	SyString sPath;
+	SyString sPath, *pPath;
 	char *zDup;
 #ifdef __WINNT__
 	char *zCur;
@@ -8747,9 +9591,73 @@ PH7_PRIVATE sxi32 PH7_VmPushFilePath(ph7_vm *pVm, const char *zPath, int nLen, s
 			*pNew = 1;
 		}
 	}
-	SySetPut(&pVm->aFiles, (const void *)&sPath);
+	/* Instructions point to the entry, so it must not move when the stack grows */
+	pPath = (SyString *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(SyString));
+	if(pPath == 0) {
+		return SXERR_MEM;
+	}
+	*pPath = sPath;
+	SySetPut(&pVm->aFiles, (const void *)&pPath);
 	return SXRET_OK;
 }
+/*
+ * Compile an included file, cache the resulting bytecode and execute it.
+ * Files declaring classes or functions, or that raised a compile-time diagnostic,
+ * are not cached, since declarations [and diagnostics] must be processed again
+ * on each inclusion.
+ */
+static void VmExecCachedChunk(
+	ph7_vm *pVm,            /* Underlying Virtual Machine */
+	SyString *pFile,        /* Real path of the included file */
+	sxu32 nCrc,             /* CRC32 of the file contents */
+	VmIncludeChunk *pChunk, /* Stale cache entry if any */
+	SyString *pScript,      /* File contents */
+	int iFlags              /* Code evaluation flag */
+) {
+	SySet aByteCode;
+	sxu32 nClass, nFunc;
+	nClass = SyHashTotalEntry(&pVm->hClass);
+	nFunc = SyHashTotalEntry(&pVm->hFunction);
+	SySetInit(&aByteCode, &pVm->sAllocator, sizeof(VmInstr));
+	SySetAlloc(&aByteCode, 0x20);
+	if(VmCompileChunk(&(*pVm), &(*pScript), iFlags, &aByteCode) != SXRET_OK) {
+		SySetRelease(&aByteCode);
+		return;
+	}
+	if(pVm->sCodeGen.nErr > 0 || nClass != SyHashTotalEntry(&pVm->hClass) || nFunc != SyHashTotalEntry(&pVm->hFunction)) {
+		/* Not cacheable */
+		VmExecChunk(&(*pVm), 0, &aByteCode);
+		SySetRelease(&aByteCode);
+		return;
+	}
+	if(pChunk == 0) {
+		pChunk = (VmIncludeChunk *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(VmIncludeChunk));
+		if(pChunk) {
+			SyZero(pChunk, sizeof(VmIncludeChunk));
+			pChunk->sPath.zString = SyMemBackendStrDup(&pVm->sAllocator, pFile->zString, pFile->nByte);
+			pChunk->sPath.nByte = pFile->nByte;
+			if(pChunk->sPath.zString == 0 ||
+					SyHashInsert(&pVm->hInclude, (const void *)pChunk->sPath.zString, pChunk->sPath.nByte, pChunk) != SXRET_OK) {
+				SyMemBackendPoolFree(&pVm->sAllocator, pChunk);
+				pChunk = 0;
+			}
+		}
+		if(pChunk == 0) {
+			/* Out of memory, execute without caching */
+			VmExecChunk(&(*pVm), 0, &aByteCode);
+			SySetRelease(&aByteCode);
+			return;
+		}
+	} else {
+		/* File modified [or included another way] since compiled, drop the stale bytecode */
+		SySetRelease(&pChunk->aByteCode);
+	}
+	pChunk->aByteCode = aByteCode;
+	pChunk->nSize = pScript->nByte;
+	pChunk->nCrc = nCrc;
+	pChunk->iFlags = iFlags;
+	VmExecChunk(&(*pVm), 0, &pChunk->aByteCode);
+}
 /*
  * Compile and Execute a PHP script at run-time.
  * SXRET_OK is returned on successfull evaluation.Any other return values
@@ -8767,6 +9675,9 @@ static sxi32 VmExecIncludedFile(
 ) {
 	sxi32 rc;
 	const ph7_io_stream *pStream;
+	VmIncludeChunk *pChunk;
+	SyHashEntry *pEntry;
+	SyString *pFile;
 	SyBlob sContents;
 	void *pHandle;
 	int isNew;
@@ -8792,11 +9703,36 @@ static sxi32 VmExecIncludedFile(
 		rc = PH7_StreamReadWholeFile(pHandle, pStream, &sContents);
 		if(rc == SXRET_OK) {
 			SyString sScript;
-			/* Compile and execute the script */
+			sxu32 nCrc;
 			SyStringInitFromBuf(&sScript, SyBlobData(&sContents), SyBlobLength(&sContents));
-			pVm->nMagic = PH7_VM_INCL;
-			VmEvalChunk(pVm, 0, &sScript, iFlags);
-			pVm->nMagic = PH7_VM_EXEC;
+			/* Real path of the included file as pushed by PH7_StreamOpenHandle() */
+			pFile = PH7_VmPeekFilePath(pVm);
+			if(pStream != pVm->pDefStream || pFile == 0) {
+				/* Not a local file, compile and execute the script */
+				pVm->nIncludeMiss++;
+				VmEvalChunk(pVm, 0, &sScript, iFlags);
+			} else {
+				/*
+				 * Timestamps are too coarse to tell whether the file changed [i.e: Same
+				 * second rewrite], so the cached bytecode is validated against the contents.
+				 */
+				nCrc = SyCrc32(sScript.zString, sScript.nByte);
+				pChunk = 0;
+				pEntry = SyHashGet(&pVm->hInclude, (const void *)pFile->zString, pFile->nByte);
+				if(pEntry) {
+					pChunk = (VmIncludeChunk *)pEntry->pUserData;
+				}
+				if(pChunk && pChunk->nSize == sScript.nByte && pChunk->nCrc == nCrc && pChunk->iFlags == iFlags) {
+					/* Not modified since compiled, execute the cached bytecode */
+					pChunk->nHit++;
+					pVm->nIncludeHit++;
+					VmExecChunk(&(*pVm), 0, &pChunk->aByteCode);
+				} else {
+					/* Compile, cache and execute the script */
+					pVm->nIncludeMiss++;
+					VmExecCachedChunk(&(*pVm), pFile, nCrc, pChunk, &sScript, iFlags);
+				}
+			}
 		}
 	}
 	/* Close the handle */
@@ -8805,6 +9741,98 @@ static sxi32 VmExecIncludedFile(
 	SyBlobRelease(&sContents);
 	return rc;
 }
+/*
+ * Import an AerScript module.
+ * Modules linked into the library are looked up in the static registry, others
+ * are loaded from the dynamic modules search path. Each module is initialized
+ * only once per VM.
+ */
+static sxi32 VmImportModule(ph7_vm *pVm, const SyString *pName) {
+	sxi32(*xInit)(ph7_vm *, ph7_real *, SyString *) = 0;
+	const SyString *aPath;
+	VmModule sModule;
+	SyBlob sWorker;
+	sxu32 n;
+	if(SyHashGet(&pVm->hModule, (const void *)pName->zString, pName->nByte) != 0) {
+		/* Already imported */
+		return SXRET_OK;
+	}
+	/* Zero the module entry */
+	SyZero(&sModule, sizeof(VmModule));
+	sModule.sName.zString = SyMemBackendStrDup(&pVm->sAllocator, pName->zString, pName->nByte);
+	if(sModule.sName.zString == 0) {
+		return SXERR_MEM;
+	}
+	sModule.sName.nByte = pName->nByte;
+#ifdef PH7_STATIC_MODULE_LIST
+	for(n = 0 ; n < SX_ARRAYSIZE(aStaticModules) ; ++n) {
+		if(SyStrlen(aStaticModules[n].zName) == pName->nByte &&
+				SyMemcmp(aStaticModules[n].zName, pName->zString, pName->nByte) == 0) {
+			/* Linked into the library */
+			xInit = aStaticModules[n].xInit;
+			SyStringInitFromBuf(&sModule.sFile, "[STATIC]", sizeof("[STATIC]") - 1);
+			break;
+		}
+	}
+#endif
+	if(xInit == 0) {
+		static const SyString sDefPath = { PH7_MODULE_PATH, sizeof(PH7_MODULE_PATH) - 1 };
+		sxu32 nPath = SySetUsed(&pVm->aModulePaths);
+		aPath = nPath > 0 ? (const SyString *)SySetBasePtr(&pVm->aModulePaths) : &sDefPath;
+		if(nPath < 1) {
+			nPath = 1;
+		}
+		/* Search the module library in the dynamic modules search path */
+		SyBlobInit(&sWorker, &pVm->sAllocator);
+		for(n = 0 ; n < nPath ; ++n) {
+			SyBlobReset(&sWorker);
+			SyBlobFormat(&sWorker, "%z/%z%s", &aPath[n], pName, PH7_LIBRARY_SUFFIX);
+			if(SyBlobNullAppend(&sWorker) != SXRET_OK) {
+				continue;
+			}
+#ifdef __WINNT__
+			sModule.pHandle = LoadLibrary((const char *)SyBlobData(&sWorker));
+#else
+			sModule.pHandle = dlopen((const char *)SyBlobData(&sWorker), RTLD_LAZY);
+#endif
+			if(sModule.pHandle) {
+				break;
+			}
+		}
+		if(!sModule.pHandle) {
+			/* Could not load the module library file */
+			SyBlobRelease(&sWorker);
+			PH7_VmThrowError(pVm, PH7_CTX_ERR, "ImportError: No module named '%z' found", &sModule.sName);
+			return SXERR_NOTFOUND;
+		}
+		sModule.sFile.zString = SyMemBackendStrDup(&pVm->sAllocator, (const char *)SyBlobData(&sWorker), SyBlobLength(&sWorker) - 1);
+		sModule.sFile.nByte = SyBlobLength(&sWorker) - 1;
+		SyBlobRelease(&sWorker);
+#ifdef __WINNT__
+		*(void **)(&xInit) = GetProcAddress(sModule.pHandle, "initializeModule");
+#else
+		*(void **)(&xInit) = dlsym(sModule.pHandle, "initializeModule");
+#endif
+		if(!xInit) {
+			/* Could not find the module entry point */
+			PH7_VmThrowError(pVm, PH7_CTX_ERR, "ImportError: Method '%z::initializeModule()' not found", &sModule.sName);
+			return SXERR_NOTFOUND;
+		}
+	}
+	/* Put information about module on top of the modules stack */
+	if(SySetPut(&pVm->aModules, (const void *)&sModule) != SXRET_OK ||
+			SyHashInsert(&pVm->hModule, (const void *)sModule.sName.zString, sModule.sName.nByte, SX_INT_TO_PTR(SySetUsed(&pVm->aModules))) != SXRET_OK) {
+		return SXERR_MEM;
+	}
+	/* Initialize the module once */
+	if(xInit(pVm, &sModule.fVer, &sModule.sDesc) != SXRET_OK) {
+		PH7_VmThrowError(pVm, PH7_CTX_ERR, "ImportError: Could not initialize module '%z'", &sModule.sName);
+		return SXERR_ABORT;
+	}
+	((VmModule *)SySetPeek(&pVm->aModules))->fVer = sModule.fVer;
+	((VmModule *)SySetPeek(&pVm->aModules))->sDesc = sModule.sDesc;
+	return SXRET_OK;
+}
 /*
  * string get_include_path(void)
  *  Gets the current include_path configuration option.
@@ -8879,6 +9907,20 @@ static int vm_builtin_get_included_files(ph7_context *pCtx, int nArg, ph7_value
 	 */
 	return PH7_OK;
 }
+/*
+ * int get_include_cache_hits(void)
+ *  Gets the number of included files executed from the compiled chunks cache.
+ * Parameter
+ *  None
+ * Return
+ *  Total number of cache hits for the running request
+ */
+static int vm_builtin_get_include_cache_hits(ph7_context *pCtx, int nArg, ph7_value **apArg) {
+	SXUNUSED(nArg); /* cc warning */
+	SXUNUSED(apArg);
+	ph7_result_int(pCtx, (int)pCtx->pVm->nIncludeHit);
+	return PH7_OK;
+}
 /*
  * Section:
  *  Command line arguments processing.
@@ -9398,6 +10440,7 @@ static const ph7_builtin_func aVmFunc[] = {
 	{ "get_object_vars",         vm_builtin_get_object_vars   },
 	{ "is_subclass_of",          vm_builtin_is_subclass_of    },
 	{ "is_a", vm_builtin_is_a },
+	{ "get_object_cache_stats", vm_builtin_get_object_cache_stats },
 	/* Random numbers/strings generators */
 	{ "rand",          vm_builtin_rand            },
 	{ "rand_str",      vm_builtin_rand_str        },
@@ -9435,6 +10478,8 @@ static const ph7_builtin_func aVmFunc[] = {
 	{ "get_memory_limit",      vm_builtin_get_memory_limit },
 	{ "get_memory_peak_usage", vm_builtin_get_memory_peak_usage },
 	{ "get_memory_usage",      vm_builtin_get_memory_usage },
+	/* Cycle collector */
+	{ "gc_collect_cycles",     vm_builtin_gc_collect_cycles },
 	/* Assertion functions */
 	{ "assert_options",  vm_builtin_assert_options },
 	{ "assert",          vm_builtin_assert         },
@@ -9459,24 +10504,15 @@ static const ph7_builtin_func aVmFunc[] = {
 	/* Files/URI inclusion facility */
 	{ "get_include_path",  vm_builtin_get_include_path },
 	{ "get_included_files", vm_builtin_get_included_files},
+	{ "get_include_cache_hits", vm_builtin_get_include_cache_hits},
 };
 /*
- * Register the built-in VM functions defined above.
+ * Register the built-in VM functions defined above in the table shared by all VMs.
+ * Note that these special functions have access to the underlying virtual machine
+ * as their private data.
  */
-static sxi32 VmRegisterSpecialFunction(ph7_vm *pVm) {
-	sxi32 rc;
-	sxu32 n;
-	for(n = 0 ; n < SX_ARRAYSIZE(aVmFunc) ; ++n) {
-		/* Note that these special functions have access
-		 * to the underlying virtual machine as their
-		 * private data.
-		 */
-		rc = ph7_create_function(&(*pVm), aVmFunc[n].zName, aVmFunc[n].xFunc, &(*pVm));
-		if(rc != SXRET_OK) {
-			return rc;
-		}
-	}
-	return SXRET_OK;
+PH7_PRIVATE sxi32 PH7_RegisterSpecialFunction(ph7_builtin_table *pTable) {
+	return PH7_BuiltinTableAddFunc(&(*pTable), aVmFunc, SX_ARRAYSIZE(aVmFunc), PH7_BUILTIN_DATA_VM);
 }
 /*
  * Check if the given name refer to an installed class.
@@ -9555,15 +10591,15 @@ PH7_PRIVATE ph7_class *PH7_VmExtractClass(
 static VmRefObj *VmNewRefObj(ph7_vm *pVm, sxu32 nIdx) {
 	VmRefObj *pRef;
 	/* Allocate a new instance */
-	pRef = (VmRefObj *)SyMemBackendPoolAlloc(&pVm->sAllocator, sizeof(VmRefObj));
+	pRef = (VmRefObj *)SyMemBackendPoolAlloc(&pVm->sArena, sizeof(VmRefObj));
 	if(pRef == 0) {
 		return 0;
 	}
 	/* Zero the structure */
 	SyZero(pRef, sizeof(VmRefObj));
 	/* Initialize fields */
-	SySetInit(&pRef->aReference, &pVm->sAllocator, sizeof(SyHashEntry *));
-	SySetInit(&pRef->aArrEntries, &pVm->sAllocator, sizeof(ph7_hashmap_node *));
+	SySetInit(&pRef->aReference, &pVm->sArena, sizeof(SyHashEntry *));
+	SySetInit(&pRef->aArrEntries, &pVm->sArena, sizeof(ph7_hashmap_node *));
 	pRef->nIdx = nIdx;
 	return pRef;
 }
@@ -9572,8 +10608,12 @@ static VmRefObj *VmNewRefObj(ph7_vm *pVm, sxu32 nIdx) {
  * for lookup/insertion operations.
  */
 static sxu32 VmRefHash(sxu32 nIdx) {
-	/* Calculate the hash based on the memory object index */
-	return nIdx ^ (nIdx << 8) ^ (nIdx >> 8);
+	/*
+	 * Calculate the hash based on the memory object index.
+	 * Multiplying by an odd constant is a bijection on the low order bits used
+	 * to select the bucket, so neighbouring indexes never collide.
+	 */
+	return nIdx * 0x9E3779B1;
 }
 /*
  * Check if a memory object [i.e: a variable] is already installed
@@ -9625,7 +10665,7 @@ static sxi32 VmRefObjInsert(ph7_vm *pVm, VmRefObj *pRef) {
 		sxu32 nNew;
 		/* Allocate a larger table */
 		nNew = pVm->nRefSize << 1;
-		apNew = (VmRefObj **)SyMemBackendAlloc(&pVm->sAllocator, sizeof(VmRefObj *) * nNew);
+		apNew = (VmRefObj **)SyMemBackendAlloc(&pVm->sArena, sizeof(VmRefObj *) * nNew);
 		if(apNew) {
 			VmRefObj *pEntry = pVm->pRefList;
 			sxu32 n;
@@ -9647,7 +10687,7 @@ static sxi32 VmRefObjInsert(ph7_vm *pVm, VmRefObj *pRef) {
 				pEntry = pEntry->pNext;
 			}
 			/* Release the old table */
-			SyMemBackendFree(&pVm->sAllocator, pVm->apRefObj);
+			SyMemBackendFree(&pVm->sArena, pVm->apRefObj);
 			/* Install the new one */
 			pVm->apRefObj = apNew;
 			pVm->nRefSize = nNew;
@@ -9707,7 +10747,7 @@ static sxi32 VmRefObjUnlink(ph7_vm *pVm, VmRefObj *pRef) {
 	/* Release the node */
 	SySetRelease(&pRef->aReference);
 	SySetRelease(&pRef->aArrEntries);
-	SyMemBackendPoolFree(&pVm->sAllocator, pRef);
+	SyMemBackendPoolFree(&pVm->sArena, pRef);
 	pVm->nRefUsed--;
 	return SXRET_OK;
 }
@@ -280,11 +280,21 @@ typedef sxi64 ph7_int64;
  * For a full discussion on the configuration verbs and their expected
  * parameters, please refer to this page:
  *      https://ph7.symisc.net/c_api_func.html#ph7_config
+ * Note on PH7_CONFIG_MEM_LIMIT: The engine and each of its virtual machines keep
+ * their own heap accounting, so the limit [i.e: "64M", at least 1MB] applies to each
+ * of them separately rather than to the whole process. A virtual machine inherits
+ * the limit in effect when it is created by [ph7_vm_init()]. Small chunks are charged
+ * by whole 32KB slabs of their size class, a freshly initialized virtual machine
+ * thus already accounts for about 1.3MB.
  */
 #define PH7_CONFIG_ERR_OUTPUT    1  /* TWO ARGUMENTS: int (*xConsumer)(const void *pOut,unsigned int nLen,void *pUserData),void *pUserData */
 #define PH7_CONFIG_ERR_ABORT     2  /* RESERVED FOR FUTURE USE */
 #define PH7_CONFIG_ERR_LOG       3  /* TWO ARGUMENTS: const char **pzBuf,int *pLen */
 #define PH7_CONFIG_MEM_LIMIT	 4  /* ONE ARGUMENT: char *nMemLimit */
+#define PH7_CONFIG_BYTECODE_CACHE 5 /* ONE ARGUMENT: const char *zDirectory */
+#define PH7_CONFIG_PATH_CACHE_TTL 6 /* ONE ARGUMENT: unsigned int nSeconds */
+#define PH7_CONFIG_PATH_CACHE_FLUSH 7 /* NO ARGUMENTS */
+#define PH7_CONFIG_VM_SNAPSHOT   8  /* ONE ARGUMENT: int bEnable */
 /*
  * Virtual Machine Configuration Commands.
  *
@@ -318,6 +328,23 @@ typedef sxi64 ph7_int64;
 #define PH7_VM_CONFIG_IO_STREAM       15  /* ONE ARGUMENT: const ph7_io_stream *pStream */
 #define PH7_VM_CONFIG_ARGV_ENTRY      16  /* ONE ARGUMENT: const char *zValue */
 #define PH7_VM_CONFIG_EXTRACT_OUTPUT  17  /* TWO ARGUMENTS: const void **ppOut,unsigned int *pOutputLen */
+#define PH7_VM_CONFIG_GC_BUDGET       18  /* ONE ARGUMENT: unsigned int nMicroseconds */
+#define PH7_VM_CONFIG_OBJ_CACHE_STATS 19  /* TWO ARGUMENTS: unsigned int *pHit,unsigned int *pMiss */
+#define PH7_VM_CONFIG_INCLUDE_CACHE_STATS 20 /* TWO ARGUMENTS: unsigned int *pHit,unsigned int *pMiss */
+#define PH7_VM_CONFIG_MODULE_PATH     21  /* ONE ARGUMENT: const char *zModulePath */
+#define PH7_VM_CONFIG_STARTUP_STATS   22  /* ONE ARGUMENT: unsigned int aPhase[PH7_PHASE_COUNT] */
+/*
+ * Startup phases reported by the [PH7_VM_CONFIG_STARTUP_STATS] configuration verb.
+ * Each one is reported as a duration in microseconds.
+ */
+#define PH7_PHASE_ENGINE   0 /* Library and engine initialization [i.e: ph7_init()] */
+#define PH7_PHASE_VM       1 /* Virtual machine containers initialization */
+#define PH7_PHASE_BUILTIN  2 /* Built-in classes and interfaces compilation */
+#define PH7_PHASE_STREAM   3 /* VFS and IO streams registration */
+#define PH7_PHASE_SUPER    4 /* Superglobals creation */
+#define PH7_PHASE_COMPILE  5 /* Script compilation */
+#define PH7_PHASE_EXEC     6 /* Script execution */
+#define PH7_PHASE_COUNT    7
 /*
  * Global Library Configuration Commands.
  *
@@ -528,6 +555,7 @@ PH7_APIEXPORT int ph7_vm_config(ph7_vm *pVm, int iConfigOp, ...);
 PH7_APIEXPORT int ph7_vm_exec(ph7_vm *pVm, int *pExitStatus);
 PH7_APIEXPORT int ph7_vm_reset(ph7_vm *pVm);
 PH7_APIEXPORT int ph7_vm_release(ph7_vm *pVm);
+PH7_APIEXPORT int ph7_vm_clone(ph7_vm *pVm, ph7_vm **ppOutVm);
 PH7_APIEXPORT int ph7_vm_dump(ph7_vm *pVm, int (*xConsumer)(const void *, unsigned int, void *), void *pUserData);
 /* In-process Extending Interfaces */
 PH7_APIEXPORT int ph7_create_function(ph7_vm *pVm, const char *zName, int (*xFunc)(ph7_context *, int, ph7_value **), void *pUserData);
@@ -567,7 +595,13 @@ PH7_APIEXPORT const char *ph7_function_name(ph7_context *pCtx);
 PH7_APIEXPORT void *ph7_context_alloc_chunk(ph7_context *pCtx, unsigned int nByte, int ZeroChunk, int AutoRelease);
 PH7_APIEXPORT void *ph7_context_realloc_chunk(ph7_context *pCtx, void *pChunk, unsigned int nByte);
 PH7_APIEXPORT void ph7_context_free_chunk(ph7_context *pCtx, void *pChunk);
-/* On Demand Dynamically Typed Value Object allocation interfaces */
+/*
+ * On Demand Dynamically Typed Value Object allocation interfaces.
+ * The contents of these values [i.e: strings, arrays] are request scoped: they are
+ * allocated from the same arena as the script values, which [ph7_vm_reset()] rewinds
+ * at once. Release them with [ph7_release_value()] before resetting the VM and
+ * create them again afterwards.
+ */
 PH7_APIEXPORT ph7_value *ph7_new_scalar(ph7_vm *pVm);
 PH7_APIEXPORT ph7_value *ph7_new_array(ph7_vm *pVm);
 PH7_APIEXPORT int ph7_release_value(ph7_vm *pVm, ph7_value *pValue);
@@ -202,10 +202,14 @@ struct SyBlob {
 	sxu32  nByte;	          /* Total number of used bytes */
 	sxu32  mByte;	          /* Total number of available bytes */
 	sxu32  nFlags;	          /* Blob internal flags,see below */
+	sxu32  nHash;	          /* Cached hash of the blob contents [Valid only if SXBLOB_HASHED is set] */
 };
 #define SXBLOB_LOCKED	0x01	/* Blob is locked [i.e: Cannot auto grow] */
 #define SXBLOB_STATIC	0x02	/* Not allocated from heap   */
 #define SXBLOB_RDONLY   0x04    /* Read-Only data */
+#define SXBLOB_HASHED   0x08    /* nHash hold the hash of the current contents */
+#define SXBLOB_INTERN   0x10    /* Read-only view of a VM interned string [i.e: Outlive the blob] */
+#define SXBLOB_BORROWED 0x20    /* Read-only view of a reference counted heap buffer */
 
 #define SyBlobFreeSpace(BLOB)	 ((BLOB)->mByte - (BLOB)->nByte)
 #define SyBlobLength(BLOB)	     ((BLOB)->nByte)
@@ -213,28 +217,45 @@ struct SyBlob {
 #define SyBlobCurData(BLOB)	     ((void*)(&((char*)(BLOB)->pBlob)[(BLOB)->nByte]))
 #define SyBlobDataAt(BLOB,OFFT)	 ((void *)(&((char *)(BLOB)->pBlob)[OFFT]))
 #define SyBlobGetAllocator(BLOB) ((BLOB)->pAllocator)
+/* Invalidate the cached hash after an in-place modification of the blob contents */
+#define SyBlobDirty(BLOB)        ((BLOB)->nFlags &= ~SXBLOB_HASHED)
 
-#define SXMEM_POOL_INCR			3
-#define SXMEM_POOL_NBUCKETS		12
+#define SXMEM_SLAB_SIZE			(1<<15)
+#define SXMEM_SLAB_MAXALLOC		4096
+#define SXMEM_SLAB_NCLASS		36
+#define SXMEM_SLAB_SPARE		64
+#define SXMEM_SLAB_BATCH		4
+#define SXMEM_HEAP_BATCH		(SXMEM_SLAB_SIZE * 4)
 #define SXMEM_BACKEND_MAGIC	0xBAC3E67D
 #define SXMEM_BACKEND_CORRUPT(BACKEND)	(BACKEND == 0 || BACKEND->nMagic != SXMEM_BACKEND_MAGIC)
 
 #define SXMEM_BACKEND_RETRY	3
 /* A memory backend subsystem is defined by an instance of the following structures */
-typedef union SyMemHeader SyMemHeader;
+typedef struct SyMemSlab SyMemSlab;
 typedef struct SyMemBlock SyMemBlock;
 struct SyMemBlock {
 	SyMemBlock *pNext, *pPrev; /* Chain of allocated memory blocks */
 	sxu32 nGuard;             /* magic number associated with each valid block,so we
 							   * can detect misuse.
 							   */
+	sxu32 nSize;              /* Bytes charged to the heap for this block */
 };
 /*
- * Header associated with each valid memory pool block.
- */
-union SyMemHeader {
-	SyMemHeader *pNext; /* Next chunk of size 1 << (nBucket + SXMEM_POOL_INCR) in the list */
-	sxu32 nBucket;      /* Bucket index in aPool[] */
+ * Memory pool slab.
+ * Pool chunks are carved from SXMEM_SLAB_SIZE aligned slabs of equally sized chunks
+ * and carry no header: the owning slab is found by masking the chunk address.
+ * Requests above SXMEM_SLAB_MAXALLOC get a private slab holding a single chunk.
+ */
+struct SyMemSlab {
+	SyMemSlab *pNext, *pPrev;         /* Chain of all slabs owned by the backend */
+	SyMemSlab *pNextFree, *pPrevFree; /* Chain of slabs of the same class with available chunks */
+	void *pFree;                      /* List of released chunks */
+	void *pRaw;                       /* Block returned by the underlying allocator */
+	sxu32 nCarve;                     /* Offset of the first never used chunk */
+	sxu32 nUsed;                      /* Number of chunks in use */
+	sxu32 nSize;                      /* Chunk size */
+	sxu16 nClass;                     /* Size class index in apSlab[] or SXU16_HIGH for large chunks */
+	sxu16 nMagic;                     /* Sanity check against misuse */
 };
 /* Heap allocation control structure */
 typedef struct SyMemHeap SyMemHeap;
@@ -254,8 +275,26 @@ struct SyMemBackend {
 	void *pUserData;               /* First arg to xMemError() */
 	SyMutex *pMutex;               /* Per instance mutex */
 	sxu32 nMagic;                  /* Sanity check against misuse */
-	SyMemHeader *apPool[SXMEM_POOL_NBUCKETS + SXMEM_POOL_INCR]; /* Pool of memory chunks */
+	SyMemSlab *apSlab[SXMEM_SLAB_NCLASS]; /* Slabs with available chunks for each size class */
+	SyMemSlab *pSlabs;             /* List of all slabs */
+	SyMemSlab *pSpare;             /* Empty slabs kept by SyMemBackendReset() for later use */
+	sxu32 nSpare;                  /* Total number of spare slabs */
+	sxu32 nBudget;                 /* Heap bytes reserved by this backend but not used yet */
+	sxu32 nFlags;                  /* Backend flags (see below) */
 };
+/* Memory backend flags */
+#define SXMEM_BACKEND_UNTRACKED	0x01	/* Blocks are served by the slab allocator without a SyMemBlock header */
+/*
+ * Individual blocks are tracked only in sanitize builds so that leaks
+ * are reported per allocation.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+	#define SXMEM_BACKEND_TRACK
+#elif defined(__has_feature)
+	#if __has_feature(address_sanitizer)
+		#define SXMEM_BACKEND_TRACK
+	#endif
+#endif
 /* Mutex types */
 #define SXMUTEX_TYPE_FAST	1
 #define SXMUTEX_TYPE_RECURSIVE	2
@@ -609,6 +648,11 @@ struct SHA1Context {
  * [i.e: string, int, float, resource, object, bool, null] as ph7_values structures.
  * Each ph7_values struct may cache multiple representations (string, integer etc.)
  * of the same value.
+ * The fields are packed so that the structure has no padding [56 bytes on LP64].
+ * A compact 16-byte tagged representation [payload, type, flags and index only] is
+ * not implemented yet: it requires moving the string buffer out of line and looking
+ * up the owning VM elsewhere, both pVm and the blob allocator are used throughout the
+ * engine and by the public ph7_value_*() interfaces.
  */
 struct ph7_value {
 	union {
@@ -616,11 +660,11 @@ struct ph7_value {
 		ph7_real rVal;  /* Real value */
 		void *pOther;   /* Other values (Object, Array, Resource, Namespace, etc.) */
 	} x;
-	sxi32 iFlags;       /* Control flags (see below) */
-	sxu32 nType;        /* Variable data type */
+	sxu16 nType;        /* Variable data type */
+	sxi16 iFlags;       /* Control flags (see below) */
+	sxu32 nIdx;         /* Index number of this entry in the global object allocator */
 	ph7_vm *pVm;        /* Virtual machine that own this instance */
 	SyBlob sBlob;       /* String values */
-	sxu32 nIdx;         /* Index number of this entry in the global object allocator */
 };
 /* Variable control flags */
 #define MEMOBJ_VARIABLE  0 /* Memory value is variable */
@@ -659,6 +703,7 @@ typedef sxi32(*ProcMemObjCast)(ph7_value *);
 typedef struct ph7_output_consumer ph7_output_consumer;
 typedef struct ph7_user_func ph7_user_func;
 typedef struct ph7_conf ph7_conf;
+typedef struct ph7_builtin_table ph7_builtin_table;
 /*
  * An instance of the following structure store the default VM output
  * consumer and it's private data.
@@ -683,7 +728,21 @@ struct ph7_conf {
 	ProcConsumer xErr;   /* Compile-time error consumer callback */
 	void *pErrData;      /* Third argument to xErr() */
 	SyBlob sErrConsumer; /* Default error consumer */
+	char *zCacheDir;     /* Bytecode cache directory if any */
+	sxu32 nPathTTL;      /* Include path resolution cache entries lifetime in seconds, 0 to disable the cache */
+	sxbool bSnapshot;    /* TRUE to keep an image of compiled programs so that their VM can be cloned */
+};
+/*
+ * Successful include path resolutions are cached per engine in an instance of
+ * the following structure, so that deep include trees do not probe every import
+ * path and canonicalize the file found [i.e: open(), realpath()] on each inclusion.
+ */
+typedef struct ph7_path_entry ph7_path_entry;
+struct ph7_path_entry {
+	SyString sReal;  /* Canonical path of the file found */
+	sxi64 nStamp;    /* Time the path was resolved */
 };
+#define PH7_PATH_TTL	120 /* Default resolution cache entries lifetime in seconds */
 /*
  * Signature of the C function responsible of expanding constant values.
  */
@@ -804,8 +863,12 @@ struct ph7_foreach_info {
  */
 struct ph7 {
 	SyMemBackend sAllocator;     /* Low level memory allocation subsystem */
+	SyMemHeap sHeap;             /* Engine private heap accounting */
 	const ph7_vfs *pVfs;         /* Underlying Virtual File System */
 	ph7_conf xConf;              /* Configuration */
+	SyHash hPath;                /* Include path resolution cache [i.e: ph7_path_entry] */
+	ph7_builtin_table *pBuiltin; /* Built-in functions and constants shared by all VMs [i.e: read-only] */
+	sxu32 nInitTime;             /* Engine initialization time in microseconds */
 	ph7_vm *pVms;      /* List of active VM */
 	sxi32 iVm;         /* Total number of active VM */
 	ph7 *pNext, *pPrev; /* List of active engines */
@@ -881,7 +944,6 @@ struct ph7_gen_state {
 	ph7_vm *pVm;         /* VM that own this instance */
 	SyHash hLiteral;     /* Constant string Literals table */
 	SyHash hNumLiteral;  /* Numeric literals table */
-	SyHash hVar;         /* Collected variable hashtable */
 	GenBlock *pCurrent;  /* Current processed block */
 	GenBlock sGlobal;    /* Global block */
 	ProcConsumer xErr;   /* Error consumer callback */
@@ -895,6 +957,7 @@ struct ph7_gen_state {
 	SyToken *pRawIn;     /* Current processed raw token */
 	SyToken *pRawEnd;    /* Last raw token in the stream */
 	SySet   *pTokenSet;  /* Token containers */
+	sxu32 nErr;          /* Total number of reported diagnostics */
 };
 /* Forward references */
 typedef struct ph7_vm_func_closure_env ph7_vm_func_closure_env;
@@ -1018,6 +1081,30 @@ struct ph7_builtin_constant {
 	const char *zName;     /* Constant name */
 	ProcConstant xExpand;  /* C routine responsible of expanding constant value*/
 };
+/*
+ * Built-in functions and constants are indexed once per process in the
+ * following read-only tables, which are shared by all VMs. Each VM keeps
+ * only the host-application and script defined entries in its own
+ * hashtables [i.e: hHostFunction, hConstant], which are looked up first.
+ * A built-in deleted from a VM is recorded there as an entry without
+ * user data.
+ */
+struct ph7_builtin_table {
+	SyHash hFunc;   /* Built-in functions [i.e: ph7_builtin_ref] */
+	SyHash hConst;  /* Built-in constants [i.e: ph7_constant] */
+};
+/*
+ * A built-in function is installed in a VM the first time it is invoked.
+ * The private data it is given depends on the table it comes from.
+ */
+#define PH7_BUILTIN_DATA_NONE 0 /* No private data */
+#define PH7_BUILTIN_DATA_VM   1 /* The VM that invoke the function */
+#define PH7_BUILTIN_DATA_VFS  2 /* The underlying virtual file system */
+typedef struct ph7_builtin_ref ph7_builtin_ref;
+struct ph7_builtin_ref {
+	const ph7_builtin_func *pFunc; /* Built-in function */
+	sxi32 iData;                   /* Private data [i.e: PH7_BUILTIN_DATA_VM] */
+};
 /* Forward reference */
 typedef struct ph7_class_method ph7_class_method;
 typedef struct ph7_class_attr   ph7_class_attr;
@@ -1043,6 +1130,8 @@ struct ph7_class {
 	SyHash hAttr;         /* Class attributes [i.e: variables and constants] */
 	SyHash hMethod;       /* Class methods */
 	SySet aInterface;     /* Implemented interface container */
+	ph7_class_instance *pFreeList; /* Released instances ready for reuse [Request scoped] */
+	sxu32 nFreeList;      /* Total entries in pFreeList */
 };
 /* Class configuration flags */
 #define PH7_CLASS_FINAL       0x001 /* Class is final [cannot be extended] */
@@ -1099,7 +1188,25 @@ struct ph7_class_instance {
 	SyHash hAttr;       /* Hashtable of active class members */
 	sxi32 iRef;         /* Reference count */
 	sxi32 iFlags;       /* Control flags */
+	sxu32 nGcRoot;      /* Slot in the cycle collector root buffer [Only used if buffered] */
+	ph7_class_instance *pNextFree; /* Next released instance in the class freelist */
 };
+/*
+ * Released class instances are kept on a per-class freelist, together with their
+ * attributes table, and recycled by the next instantiation of the same class.
+ */
+#define PH7_CLASS_FREELIST_MAX	64
+/*
+ * Cycle collector tuning.
+ * A collection is started as soon as this many possible roots of garbage cycles
+ * were recorded [raised while collections find little garbage], and it yields
+ * back to the program once its time slice expires.
+ */
+#define PH7_GC_ROOT_THRESHOLD	4096
+#define PH7_GC_ROOT_THRESHOLD_MAX	(PH7_GC_ROOT_THRESHOLD * 256)
+#define PH7_GC_ROOT_BATCH		256  /* Roots processed together */
+#define PH7_GC_CLOCK_STRIDE		128  /* Instances walked between two clock checks */
+#define PH7_GC_BUDGET			2000 /* Default time slice in microseconds */
 /*
  * A single instruction of the virtual machine has an opcode
  * and as many as three operands.
@@ -1168,6 +1275,42 @@ struct ph7_switch {
 	sxu32 nOut;       /* First instruction to execute after this statement */
 	sxu32 nDefault;   /* First instruction to execute in the default block */
 };
+/*
+ * State of a VM before a script get compiled.
+ * Only what was compiled after the mark is saved in a bytecode image.
+ */
+typedef struct VmImageMark VmImageMark;
+struct VmImageMark {
+	sxu32 nInstr;    /* Total number of instructions in the main bytecode container */
+	sxu32 nLit;      /* Total number of literals */
+	sxu32 nFunc;     /* Total number of compiled functions */
+	sxu32 nClass;    /* Total number of compiled classes */
+	sxu32 nConst;    /* Total number of global constants */
+	sxu32 nErr;      /* Total number of compile-time diagnostics */
+	sxuptr nFuncSum; /* Checksum of the compiled functions */
+};
+/*
+ * A bytecode image is valid only for the exact source file it was compiled from.
+ */
+typedef struct VmImageKey VmImageKey;
+struct VmImageKey {
+	SyString sPath;  /* Source real path */
+	sxi64 nSize;     /* Source size */
+	sxi64 nMtime;    /* Source last modification time */
+	sxu32 nCrc;      /* CRC32 of the source */
+};
+/*
+ * Compiled program kept aside so that its VM can be cloned [i.e: ph7_vm_clone()].
+ * Clones execute straight from the image, so it is reference counted and released
+ * together with the last VM using it.
+ */
+typedef struct ph7_vm_snapshot ph7_vm_snapshot;
+struct ph7_vm_snapshot {
+	SyBlob sImage;   /* Bytecode image of the program */
+	VmImageKey sKey; /* Image key [i.e: path of the main script] */
+	sxu32 nConst;    /* Global constants defined before the program was compiled */
+	sxu32 nRef;      /* Total number of VMs using the image */
+};
 /* Assertion flags */
 #define PH7_ASSERT_DISABLE    0x01  /* Disable assertion */
 #define PH7_ASSERT_WARNING    0x02  /* Issue a warning for each failed assertion */
@@ -1181,13 +1324,15 @@ struct ph7_switch {
  */
 struct ph7_vm {
 	SyMemBackend sAllocator;	/* Memory backend */
+	SyMemHeap sHeap;            /* VM private heap accounting [i.e: Not shared with other VMs] */
+	SyMemBackend sArena;        /* Request scoped memory backend [i.e: Values, arrays, objects, frames], rewound by PH7_VmReset() */
 	ph7 *pEngine;               /* Interpreter that own this VM */
 	SySet aInstrSet;            /* Instructions debugging container */
 	SySet aByteCode;            /* Default bytecode container */
 	SySet *pByteContainer;      /* Current bytecode container */
 	VmFrame *pFrame;            /* Stack of active frames */
 	SyPRNGCtx sPrng;            /* PRNG context */
-	SySet aMemObj;              /* Object allocation table */
+	SySet aMemObj;              /* Object allocation table [i.e: Pointers to pool allocated values] */
 	SySet aLitObj;              /* Literals allocation table */
 	ph7_value *aOps;            /* Operand stack */
 	SySet aFreeObj;             /* Stack of free memory objects */
@@ -1197,12 +1342,22 @@ struct ph7_vm {
 	SyHash hFunction;           /* Compiled functions */
 	SyHash hSuper;              /* Superglobals hashtable */
 	SyHash hDBAL;               /* DBAL installed drivers */
+	SyHash hIntern;             /* Interned identifiers [i.e: variable, attribute and method names] */
 	SyBlob sConsumer;           /* Default VM consumer [i.e Redirect all VM output to this blob] */
 	SyBlob sArgv;               /* $argv[] collector [refer to the [getopt()] implementation for more information] */
 	SySet aModules;             /* Set of loaded modules */
-	SySet aFiles;               /* Stack of processed files */
+	SyHash hModule;             /* Loaded modules [i.e: Module name to aModules[] index] */
+	SySet aModulePaths;         /* Dynamic modules search path */
+	const void *pImage;         /* Memory view of the bytecode image the program was loaded from if any */
+	sxi64 nImage;               /* pImage[] size */
+	ph7_vm_snapshot *pSnapshot; /* Program image shared with the clones of this VM if any */
+	SySet aFiles;               /* Stack of processed files [i.e: Pointers to SyString] */
 	SySet aPaths;               /* Set of import paths */
 	SySet aIncluded;            /* Set of included files */
+	SyHash hInclude;            /* Compiled include chunks cache [i.e: VmIncludeChunk] */
+	sxu32 nIncludeHit;          /* Includes executed from the chunks cache */
+	sxu32 nIncludeMiss;         /* Includes compiled from scratch */
+	sxu32 aPhase[PH7_PHASE_COUNT]; /* Startup phases duration in microseconds */
 	SySet aOB;                  /* Stackable output buffers */
 	SySet aAutoLoad;			/* Stack of class autoload callbacks */
 	SySet aShutdown;            /* Stack of shutdown user callbacks */
@@ -1226,11 +1381,30 @@ struct ph7_vm {
 	sxu32 nRefSize;            /* apRefObj[] size */
 	sxu32 nRefUsed;            /* Total entries in apRefObj[] */
 	SySet aSelf;               /* 'self' stack used for static member access [i.e: self::MyConstant] */
+	SySet aGcRoot;             /* Possible roots of garbage cycles [i.e: class instances] */
+	sxu32 nGcBudget;           /* Cycle collector time slice in microseconds, 0 for no limit */
+	sxu32 nGcThreshold;        /* Recorded roots triggering a collection */
+	sxbool bGcRun;             /* TRUE while the cycle collector is running */
+	SySet aFreeQueue;          /* Deferred releases [i.e: Large arrays, deeply nested objects] */
+	sxu32 nFreeHead;           /* Oldest pending entry of aFreeQueue[] */
+	sxu32 nFreeDepth;          /* Nesting level of the release in progress */
+	sxu32 nObjCacheHit;        /* Class instances recycled from a class freelist */
+	sxu32 nObjCacheMiss;       /* Class instances allocated from scratch */
 	sxi32 iExitStatus;         /* Script exit status */
 	ph7_gen_state sCodeGen;    /* Code generator module */
 	ph7_vm *pNext, *pPrev;     /* List of active VMs */
 	sxu32 nMagic;              /* Sanity check against misuse */
 };
+/*
+ * Memory backend for the contents of a freshly initialized ph7_value.
+ * Values created while the program runs are request scoped and live in the arena,
+ * while literals and anything built at compile time stay in the VM allocator.
+ */
+#define PH7_VmValueAllocator(VM)	(((VM)->nMagic == PH7_VM_RUN || (VM)->nMagic == PH7_VM_EXEC) ? &(VM)->sArena : &(VM)->sAllocator)
+/* Path of the script being processed, NULL if none. Entries are never moved so the pointer can be kept */
+#define PH7_VmPeekFilePath(VM)	(SySetUsed(&(VM)->aFiles) > 0 ? *(SyString **)SySetPeek(&(VM)->aFiles) : (SyString *)0)
+/* Memory object at the given index in the VM object allocation table, NULL if out of range */
+#define PH7_VmMemObjAt(VM,IDX)	((sxu32)(IDX) < SySetUsed(&(VM)->aMemObj) ? ((ph7_value **)SySetBasePtr(&(VM)->aMemObj))[IDX] : (ph7_value *)0)
 /*
  * Each active virtual machine frame is represented by an instance of the following
  * structure. VM Frame hold local variables and other stuff related to function call.
@@ -1278,6 +1452,20 @@ struct VmSlot {
 	sxu32 nIdx;      /* Index in pVm->aMemObj[] */
 	void *pUserData; /* Upper-layer private data */
 };
+/*
+ * Releasing a large array or a deeply nested object graph at once would stall
+ * the program [and could overflow the C stack], so such structures are queued
+ * in an instance of the following structure and released iteratively, a
+ * bounded slice at a time, at the VM safe points or at the end of the request.
+ */
+typedef struct VmFreeEntry VmFreeEntry;
+struct VmFreeEntry {
+	void *pObj;  /* ph7_hashmap or ph7_class_instance to release */
+	sxi32 iType; /* MEMOBJ_HASHMAP or MEMOBJ_OBJ */
+};
+#define PH7_FREE_DEFER_ENTRIES	1024 /* Arrays at least this large are released in slices */
+#define PH7_FREE_DEPTH_LIMIT	64   /* Nested releases deeper than this are deferred */
+#define PH7_FREE_SLICE			512  /* Entries released per safe point */
 /*
  * An entry in the reference table is represented by an instance of the
  * following table.
@@ -1306,6 +1494,20 @@ struct VmObEntry {
 	ph7_value sCallback; /* User defined callback */
 	SyBlob sOB;          /* Output buffer consumer */
 };
+/*
+ * Compiled include chunks are cached per VM in an instance of the following
+ * structure, so that a file included over and over again [i.e: inside a loop]
+ * is compiled only once, as long as it is not modified.
+ */
+typedef struct VmIncludeChunk VmIncludeChunk;
+struct VmIncludeChunk {
+	SyString sPath;  /* Real path of the included file */
+	sxu32 nSize;     /* File size when compiled */
+	sxu32 nCrc;      /* CRC32 of the file contents when compiled */
+	sxi32 iFlags;    /* Code evaluation flags the file was compiled with */
+	SySet aByteCode; /* Compiled bytecode */
+	sxu32 nHit;      /* Total number of cache hits */
+};
 /*
  * Information about each module library (loaded using [import()] )
  * is stored in an instance of the following structure.
@@ -1322,6 +1524,26 @@ struct VmModule {
 	SyString sDesc;      /* Module short description */
 	ph7_real fVer;       /* Module version */
 };
+/*
+ * Modules linked into the library [i.e: make STATIC_MODULES="json math"] are
+ * registered in a static table of the following structure. Their entry point
+ * is renamed after the module so that several of them can live in one binary.
+ */
+typedef struct VmStaticModule VmStaticModule;
+struct VmStaticModule {
+	const char *zName;                                  /* Module name */
+	sxi32(*xInit)(ph7_vm *, ph7_real *, SyString *);    /* Module entry point */
+};
+#define PH7_MODULE_INIT(NAME)	PH7_MODULE_INIT_(NAME)
+#define PH7_MODULE_INIT_(NAME)	initialize_##NAME##_module
+#ifdef PH7_STATIC_MODULE
+	/* Compiling a module linked into the library */
+	#define initializeModule PH7_MODULE_INIT(PH7_STATIC_MODULE)
+#endif
+#ifndef PH7_MODULE_PATH
+	/* Default dynamic modules search path */
+	#define PH7_MODULE_PATH "./binary"
+#endif
 /*
  * Each installed class autoload callback (registered using [register_autoload_handler()] )
  * is stored in an instance of the following structure.
@@ -1648,6 +1870,8 @@ PH7_PRIVATE sxi64 PH7_TokenValueToInt64(SyString *pData);
 /* lex.c function prototypes */
 PH7_PRIVATE sxi32 PH7_TokenizeRawText(const char *zInput, sxu32 nLen, SySet *pOut);
 PH7_PRIVATE sxi32 PH7_TokenizeAerScript(const char *zInput, sxu32 nLen, sxu32 nLineStart, SySet *pOut);
+PH7_PRIVATE sxi32 PH7_TokenStreamInit(SyLex *pLex, const char *zInput, sxu32 nLen, sxu32 nLineStart, SySet *pOut);
+PH7_PRIVATE sxi32 PH7_TokenStreamNextDecl(SyLex *pLex);
 /* vm.c function prototypes */
 PH7_PRIVATE void PH7_VmReleaseContextValue(ph7_context *pCtx, ph7_value *pValue);
 PH7_PRIVATE sxi32 PH7_VmInitFuncState(ph7_vm *pVm, ph7_vm_func *pFunc, const char *zName, sxu32 nByte,
@@ -1660,10 +1884,17 @@ PH7_PRIVATE sxi32 PH7_VmPushFilePath(ph7_vm *pVm, const char *zPath, int nLen, s
 PH7_PRIVATE ph7_class *PH7_VmExtractClass(ph7_vm *pVm, const char *zName, sxu32 nByte, sxi32 iLoadable);
 PH7_PRIVATE sxi32 PH7_VmRegisterConstant(ph7_vm *pVm, const SyString *pName, ProcConstant xExpand, void *pUserData, sxbool bGlobal);
 PH7_PRIVATE sxi32 PH7_VmInstallForeignFunction(ph7_vm *pVm, const SyString *pName, ProcHostFunction xFunc, void *pUserData);
+PH7_PRIVATE ph7_user_func *PH7_VmExtractForeignFunction(ph7_vm *pVm, const char *zName, sxu32 nByte);
+PH7_PRIVATE sxi32 PH7_BuiltinTableInit(ph7_builtin_table *pTable, SyMemBackend *pAllocator);
+PH7_PRIVATE sxi32 PH7_BuiltinTableAddFunc(ph7_builtin_table *pTable, const ph7_builtin_func *aFunc, sxu32 nFunc, sxi32 iData);
+PH7_PRIVATE sxi32 PH7_BuiltinTableAddConst(ph7_builtin_table *pTable, const ph7_builtin_constant *aConst, sxu32 nConst);
+PH7_PRIVATE void PH7_BuiltinTableRelease(ph7_builtin_table *pTable);
+PH7_PRIVATE sxi32 PH7_RegisterSpecialFunction(ph7_builtin_table *pTable);
 PH7_PRIVATE sxi32 PH7_VmInstallClass(ph7_vm *pVm, ph7_class *pClass);
 PH7_PRIVATE sxi32 PH7_VmBlobConsumer(const void *pSrc, unsigned int nLen, void *pUserData);
 PH7_PRIVATE ph7_value *PH7_ReserveMemObj(ph7_vm *pVm);
 PH7_PRIVATE ph7_value *PH7_ReserveConstObj(ph7_vm *pVm, sxu32 *pIndex);
+PH7_PRIVATE char *PH7_VmInternString(ph7_vm *pVm, const char *zStr, sxu32 nByte);
 PH7_PRIVATE sxi32 PH7_VmOutputConsume(ph7_vm *pVm, SyString *pString);
 PH7_PRIVATE sxi32 PH7_VmOutputConsumeAp(ph7_vm *pVm, const char *zFormat, va_list ap);
 PH7_PRIVATE sxi32 PH7_VmMemoryError(ph7_vm *pVm);
@@ -1675,6 +1906,7 @@ PH7_PRIVATE sxi32 PH7_VmInit(ph7_vm *pVm, ph7 *pEngine, sxbool bDebug);
 PH7_PRIVATE sxi32 PH7_VmConfigure(ph7_vm *pVm, sxi32 nOp, va_list ap);
 PH7_PRIVATE sxi32 PH7_VmByteCodeExec(ph7_vm *pVm);
 PH7_PRIVATE sxi32 PH7_VmRelease(ph7_vm *pVm);
+PH7_PRIVATE sxi32 PH7_VmClone(ph7_vm *pVm, ph7_vm *pSrc);
 PH7_PRIVATE sxi32 PH7_VmReset(ph7_vm *pVm);
 PH7_PRIVATE sxi32 PH7_VmMakeReady(ph7_vm *pVm);
 PH7_PRIVATE sxu32 PH7_VmInstrLength(ph7_vm *pVm);
@@ -1691,6 +1923,8 @@ PH7_PRIVATE sxi32 PH7_VmCallClassMethod(ph7_vm *pVm, ph7_class_instance *pThis,
 PH7_PRIVATE sxi32 PH7_VmCallUserFunction(ph7_vm *pVm, ph7_value *pFunc, int nArg, ph7_value **apArg, ph7_value *pResult);
 PH7_PRIVATE sxi32 PH7_VmCallUserFunctionAp(ph7_vm *pVm, ph7_value *pFunc, ph7_value *pResult, ...);
 PH7_PRIVATE sxi32 PH7_VmUnsetMemObj(ph7_vm *pVm, sxu32 nObjIdx, int bForce);
+PH7_PRIVATE sxi32 PH7_VmDeferRelease(ph7_vm *pVm, void *pObj, sxi32 iType);
+PH7_PRIVATE void PH7_VmReleaseDeferred(ph7_vm *pVm, sxu32 nMax);
 PH7_PRIVATE sxi32 PH7_VmDestroyMemObj(ph7_vm *pVm, ph7_value *pObj);
 PH7_PRIVATE void PH7_VmRandomString(ph7_vm *pVm, char *zBuf, int nLen);
 PH7_PRIVATE ph7_class *PH7_VmExtractActiveClass(ph7_vm *pVm, sxi32 iDepth);
@@ -1701,6 +1935,13 @@ PH7_PRIVATE int PH7_Utf8Read(
 	const unsigned char *zTerm,     /* Pretend this byte is 0x00 */
 	const unsigned char **pzNext    /* Write first byte past UTF-8 char here */
 );
+/* image.c function prototypes */
+PH7_PRIVATE sxi32 PH7_VmImageMark(ph7_vm *pVm, VmImageMark *pMark);
+PH7_PRIVATE sxi32 PH7_VmSaveImage(ph7_vm *pVm, const VmImageMark *pMark, const VmImageKey *pKey, SyBlob *pOut);
+PH7_PRIVATE sxi32 PH7_VmLoadImage(ph7_vm *pVm, const VmImageKey *pKey, const void *pImage, sxu32 nByte);
+PH7_PRIVATE sxi32 PH7_VmStoreImage(ph7_vm *pVm, const char *zPath, const SyBlob *pImage);
+PH7_PRIVATE ph7_vm_snapshot *PH7_VmSnapshotNew(ph7 *pEngine, const VmImageKey *pKey, sxu32 nConst);
+PH7_PRIVATE void PH7_VmSnapshotRelease(ph7 *pEngine, ph7_vm_snapshot *pSnap);
 /* parse.c function prototypes */
 PH7_PRIVATE sxi32 PH7_ExprMakeTree(ph7_gen_state *pGen, SySet *pExprNode, ph7_expr_node **ppRoot);
 PH7_PRIVATE sxi32 PH7_GetNextExpr(SyToken *pStart, SyToken *pEnd, SyToken **ppNext);
@@ -1720,13 +1961,14 @@ PH7_PRIVATE sxi32 PH7_ResetCodeGenerator(ph7_vm *pVm, ProcConsumer xErr, void *p
 PH7_PRIVATE sxi32 PH7_GenCompileError(ph7_gen_state *pGen, sxi32 nErrType, sxu32 nLine, const char *zFormat, ...);
 PH7_PRIVATE sxi32 PH7_CompileAerScript(ph7_vm *pVm, SyString *pScript, sxi32 iFlags);
 /* constant.c function prototypes */
-PH7_PRIVATE void PH7_RegisterBuiltInConstant(ph7_vm *pVm);
+PH7_PRIVATE sxi32 PH7_RegisterBuiltInConstant(ph7_builtin_table *pTable);
 /* builtin.c function prototypes */
-PH7_PRIVATE void PH7_RegisterBuiltInFunction(ph7_vm *pVm);
+PH7_PRIVATE sxi32 PH7_RegisterBuiltInFunction(ph7_builtin_table *pTable);
 /* hashmap.c function prototypes */
 PH7_PRIVATE ph7_hashmap *PH7_NewHashmap(ph7_vm *pVm, sxu32(*xIntHash)(sxi64), sxu32(*xBlobHash)(const void *, sxu32));
 PH7_PRIVATE sxi32 PH7_HashmapCreateSuper(ph7_vm *pVm);
 PH7_PRIVATE sxi32 PH7_HashmapRelease(ph7_hashmap *pMap, int FreeDS);
+PH7_PRIVATE sxi32 PH7_HashmapReleaseSlice(ph7_hashmap *pMap, sxu32 *pBudget);
 PH7_PRIVATE void  PH7_HashmapUnref(ph7_hashmap *pMap);
 PH7_PRIVATE sxi32 PH7_HashmapLookup(ph7_hashmap *pMap, ph7_value *pKey, ph7_hashmap_node **ppNode);
 PH7_PRIVATE sxi32 PH7_HashmapInsert(ph7_hashmap *pMap, ph7_value *pKey, ph7_value *pVal);
@@ -1738,7 +1980,7 @@ PH7_PRIVATE void PH7_HashmapResetLoopCursor(ph7_hashmap *pMap);
 PH7_PRIVATE ph7_hashmap_node *PH7_HashmapGetNextEntry(ph7_hashmap *pMap);
 PH7_PRIVATE void PH7_HashmapExtractNodeValue(ph7_hashmap_node *pNode, ph7_value *pValue, int bStore);
 PH7_PRIVATE void PH7_HashmapExtractNodeKey(ph7_hashmap_node *pNode, ph7_value *pKey);
-PH7_PRIVATE void PH7_RegisterHashmapFunctions(ph7_vm *pVm);
+PH7_PRIVATE sxi32 PH7_RegisterHashmapFunctions(ph7_builtin_table *pTable);
 PH7_PRIVATE sxi32 PH7_HashmapDump(SyBlob *pOut, ph7_hashmap *pMap, int ShowType, int nTab, int nDepth);
 PH7_PRIVATE sxi32 PH7_HashmapWalk(ph7_hashmap *pMap, int (*xWalk)(ph7_value *, ph7_value *, void *), void *pUserData);
 PH7_PRIVATE sxi32 PH7_HashmapCast(ph7_value *pObj, sxu32 nType);
@@ -1768,6 +2010,8 @@ PH7_PRIVATE ph7_class_instance *PH7_NewClassInstance(ph7_vm *pVm, ph7_class *pCl
 PH7_PRIVATE ph7_class_instance *PH7_CloneClassInstance(ph7_class_instance *pSrc);
 PH7_PRIVATE sxi32 PH7_ClassInstanceCmp(ph7_class_instance *pLeft, ph7_class_instance *pRight, int bStrict, int iNest);
 PH7_PRIVATE void  PH7_ClassInstanceUnref(ph7_class_instance *pThis);
+PH7_PRIVATE void  PH7_ClassInstanceDestroy(ph7_class_instance *pThis);
+PH7_PRIVATE sxu32 PH7_ClassInstanceCollectCycles(ph7_vm *pVm, sxu32 nBudget);
 PH7_PRIVATE sxi32 PH7_ClassInstanceDump(SyBlob *pOut, ph7_class_instance *pThis, int ShowType, int nTab, int nDepth);
 PH7_PRIVATE sxi32 PH7_ClassInstanceCallMagicMethod(ph7_vm *pVm, ph7_class *pClass, ph7_class_instance *pThis, const char *zMethod,
 		sxu32 nByte, const SyString *pAttrName);
@@ -1782,6 +2026,8 @@ PH7_PRIVATE void *PH7_StreamOpenHandle(ph7_vm *pVm, const ph7_io_stream *pStream
 PH7_PRIVATE sxi32 PH7_StreamReadWholeFile(void *pHandle, const ph7_io_stream *pStream, SyBlob *pOut);
 PH7_PRIVATE void PH7_StreamCloseHandle(const ph7_io_stream *pStream, void *pHandle);
 PH7_PRIVATE const char *PH7_ExtractDirName(const char *zPath, int nByte, int *pLen);
+PH7_PRIVATE void PH7_PathCacheFlush(ph7 *pEngine);
+PH7_PRIVATE sxi32 PH7_RegisterIOFunctions(ph7_builtin_table *pTable);
 PH7_PRIVATE sxi32 PH7_RegisterIORoutine(ph7_vm *pVm);
 PH7_PRIVATE const ph7_vfs *PH7_ExportBuiltinVfs(void);
 PH7_PRIVATE void *PH7_ExportStdin(ph7_vm *pVm);
@@ -1814,12 +2060,16 @@ PH7_PRIVATE const char *SyTimeGetDay(sxi32 iDay);
 PH7_PRIVATE sxi32 SyUriDecode(const char *zSrc, sxu32 nLen, ProcConsumer xConsumer, void *pUserData, int bUTF8);
 PH7_PRIVATE sxi32 SyUriEncode(const char *zSrc, sxu32 nLen, ProcConsumer xConsumer, void *pUserData);
 PH7_PRIVATE sxi32 SyLexRelease(SyLex *pLex);
+PH7_PRIVATE sxi32 SyLexSetInput(SyLex *pLex, const char *zInput, sxu32 nLen);
+PH7_PRIVATE sxi32 SyLexTokenizeNext(SyLex *pLex, void *pCtxData);
 PH7_PRIVATE sxi32 SyLexTokenizeInput(SyLex *pLex, const char *zInput, sxu32 nLen, void *pCtxData, ProcSort xSort, ProcCmp xCmp);
 PH7_PRIVATE sxi32 SyLexInit(SyLex *pLex, SySet *pSet, ProcTokenizer xTokenizer, void *pUserData);
 PH7_PRIVATE sxi32 SyBase64Decode(const char *zB64, sxu32 nLen, ProcConsumer xConsumer, void *pUserData);
 PH7_PRIVATE sxi32 SyBase64Encode(const char *zSrc, sxu32 nLen, ProcConsumer xConsumer, void *pUserData);
 PH7_PRIVATE sxi32 SyStrToReal(const char *zSrc, sxu32 nLen, void *pOutVal, const char **zRest);
 PH7_PRIVATE sxi32 SyRealPath(const char *zPath, char *fPath);
+PH7_PRIVATE sxi32 SyGetCwd(char *zBuf, sxu32 nLen);
+PH7_PRIVATE sxu64 SyClockMicro(void);
 PH7_PRIVATE sxi32 SyBinaryStrToInt64(const char *zSrc, sxu32 nLen, void *pOutVal, const char **zRest);
 PH7_PRIVATE sxi32 SyOctalStrToInt64(const char *zSrc, sxu32 nLen, void *pOutVal, const char **zRest);
 PH7_PRIVATE sxi32 SyHexStrToInt64(const char *zSrc, sxu32 nLen, void *pOutVal, const char **zRest);
@@ -1854,7 +2104,11 @@ PH7_PRIVATE sxi32 SyBlobSearch(const void *pBlob, sxu32 nLen, const void *pPatte
 PH7_PRIVATE sxi32 SyBlobRelease(SyBlob *pBlob);
 PH7_PRIVATE sxi32 SyBlobReset(SyBlob *pBlob);
 PH7_PRIVATE sxi32 SyBlobCmp(SyBlob *pLeft, SyBlob *pRight);
+PH7_PRIVATE sxu32 SyBlobHash(SyBlob *pBlob);
 PH7_PRIVATE sxi32 SyBlobDup(SyBlob *pSrc, SyBlob *pDest);
+PH7_PRIVATE sxi32 SyBlobShare(SyBlob *pSrc, SyBlob *pDest);
+PH7_PRIVATE sxi32 SyBlobBorrow(SyBlob *pSrc, SyBlob *pDest);
+PH7_PRIVATE sxi32 SyBlobDetach(SyBlob *pBlob);
 PH7_PRIVATE sxi32 SyBlobNullAppend(SyBlob *pBlob);
 PH7_PRIVATE sxi32 SyBlobAppend(SyBlob *pBlob, const void *pData, sxu32 nSize);
 PH7_PRIVATE sxi32 SyBlobReadOnly(SyBlob *pBlob, const void *pData, sxu32 nByte);
@@ -1862,10 +2116,12 @@ PH7_PRIVATE sxi32 SyBlobInit(SyBlob *pBlob, SyMemBackend *pAllocator);
 PH7_PRIVATE sxi32 SyBlobInitFromBuf(SyBlob *pBlob, void *pBuffer, sxu32 nSize);
 PH7_PRIVATE char *SyMemBackendStrDup(SyMemBackend *pBackend, const char *zSrc, sxu32 nSize);
 PH7_PRIVATE void *SyMemBackendDup(SyMemBackend *pBackend, const void *pSrc, sxu32 nSize);
+PH7_PRIVATE sxi32 SyMemBackendReset(SyMemBackend *pBackend);
 PH7_PRIVATE sxi32 SyMemBackendRelease(SyMemBackend *pBackend);
 PH7_PRIVATE sxi32 SyMemBackendInitFromOthers(SyMemBackend *pBackend, const SyMemMethods *pMethods, ProcMemError xMemErr, void *pUserData);
 PH7_PRIVATE sxi32 SyMemBackendInit(SyMemBackend *pBackend, ProcMemError xMemErr, void *pUserData);
 PH7_PRIVATE sxi32 SyMemBackendInitFromParent(SyMemBackend *pBackend, SyMemBackend *pParent);
+PH7_PRIVATE sxi32 SyMemBackendDetachHeap(SyMemBackend *pBackend, SyMemHeap *pHeap);
 PH7_PRIVATE void *SyMemBackendPoolRealloc(SyMemBackend *pBackend, void *pOld, sxu32 nByte);
 PH7_PRIVATE sxi32 SyMemBackendPoolFree(SyMemBackend *pBackend, void *pChunk);
 PH7_PRIVATE void *SyMemBackendPoolAlloc(SyMemBackend *pBackend, sxu32 nBytes);
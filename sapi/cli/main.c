@@ -35,10 +35,13 @@ static const char zBanner[] = {
  */
 static void Help(void) {
 	puts(zBanner);
-	puts("aer [-h|-r|-d] path/to/aer_file [script args]");
+	puts("aer [-h|-r|-d|-t|-c<dir>|-m<limit>|-p<dir>] path/to/aer_file [script args]");
+	puts("\t-c: Cache compiled byte-code in the given directory");
 	puts("\t-d: Dump PH7 Engine byte-code instructions");
 	puts("\t-r: Report run-time errors");
-	puts("\t-m: Set memory limit");
+	puts("\t-t: Report startup phases and teardown duration");
+	puts("\t-m: Set memory limit of the VM heap [i.e: -m64M], about 1.3MB is used at startup");
+	puts("\t-p: Load dynamic modules from the given directory");
 	puts("\t-h: Display this message an exit");
 	/* Exit immediately */
 	exit(0);
@@ -85,6 +88,26 @@ static int Output_Consumer(const void *pOutput, unsigned int nOutputLen, void *p
 	/* All done,VM output was redirected to STDOUT */
 	return PH7_OK;
 }
+/*
+ * Report the duration of each startup phase, of the teardown and of the whole
+ * main() function on STDERR. Whatever happens before main() is entered [i.e:
+ * process creation, dynamic linking] cannot be measured from here and is not
+ * part of the reported total.
+ */
+static void StartupStats(const unsigned int *aPhase, unsigned int nTeardown, unsigned int nTotal) {
+	static const char *azPhase[PH7_PHASE_COUNT] = {
+		"Engine init", "VM init", "Builtin classes", "VFS/IO streams", "Superglobals", "Compile", "Execute"
+	};
+	unsigned int nPhases = nTeardown;
+	int n;
+	for(n = 0 ; n < PH7_PHASE_COUNT ; ++n) {
+		fprintf(stderr, "%-16s %8u us\n", azPhase[n], aPhase[n]);
+		nPhases += aPhase[n];
+	}
+	fprintf(stderr, "%-16s %8u us\n", "Teardown", nTeardown);
+	fprintf(stderr, "%-16s %8u us\n", "Other", nTotal > nPhases ? nTotal - nPhases : 0);
+	fprintf(stderr, "%-16s %8u us\n", "Total [main()]", nTotal);
+}
 /*
  * Main program: Compile and execute the PHP file.
  */
@@ -92,11 +115,17 @@ int main(int argc, char **argv) {
 	ph7 *pEngine; /* PH7 engine */
 	ph7_vm *pVm;  /* Compiled PHP program */
 	char *sLimitArg = NULL; /* Memory limit */
+	char *sCacheArg = NULL; /* Bytecode cache directory */
+	char *sModuleArg = NULL; /* Dynamic modules directory */
 	int dump_vm = 0;    /* Dump VM instructions if TRUE */
 	int err_report = 0; /* Report run-time errors if TRUE */
+	int startup_stats = 0; /* Report startup phases duration if TRUE */
+	unsigned int aPhase[PH7_PHASE_COUNT]; /* Startup phases duration */
+	sxu64 nStart, nTeardown, nEnd; /* main(), teardown start and end time */
 	int n;              /* Script arguments */
 	int status = 0;     /* Script exit code */
 	int rc;
+	nStart = SyClockMicro();
 	/* Process interpreter arguments first*/
 	for(n = 1 ; n < argc ; ++n) {
 		int c;
@@ -111,8 +140,15 @@ int main(int argc, char **argv) {
 		} else if(c == 'r' || c == 'R') {
 			/* Report run-time errors */
 			err_report = 1;
+		} else if(c == 't' || c == 'T') {
+			/* Report startup phases duration */
+			startup_stats = 1;
 		} else if((c == 'm' || c == 'M') && SyStrlen(argv[n]) > 2) {
 			sLimitArg = argv[n] + 2;
+		} else if((c == 'c' || c == 'C') && SyStrlen(argv[n]) > 2) {
+			sCacheArg = argv[n] + 2;
+		} else if((c == 'p' || c == 'P') && SyStrlen(argv[n]) > 2) {
+			sModuleArg = argv[n] + 2;
 		} else {
 			/* Display a help message and exit */
 			Help();
@@ -135,6 +171,13 @@ int main(int argc, char **argv) {
 	if(rc != PH7_OK) {
 		Fatal("Error while setting memory limit");
 	}
+	if(sCacheArg) {
+		/* Reuse compiled scripts across runs */
+		rc = ph7_config(pEngine, PH7_CONFIG_BYTECODE_CACHE, sCacheArg);
+		if(rc != PH7_OK) {
+			Fatal("Error while setting bytecode cache directory");
+		}
+	}
 	/* Set an error log consumer callback. This callback [Output_Consumer()] will
 	 * redirect all compile-time error messages to STDOUT.
 	 */
@@ -172,6 +215,13 @@ int main(int argc, char **argv) {
 		/* Report script run-time errors */
 		ph7_vm_config(pVm, PH7_VM_CONFIG_ERR_REPORT);
 	}
+	if(sModuleArg) {
+		/* Search dynamic modules in the given directory */
+		rc = ph7_vm_config(pVm, PH7_VM_CONFIG_MODULE_PATH, sModuleArg);
+		if(rc != PH7_OK) {
+			Fatal("Error while setting dynamic modules directory");
+		}
+	}
 	/* Now,it's time to compile our PHP file */
 	rc = ph7_compile_file(
 			 pEngine, /* PH7 Engine */
@@ -199,6 +249,9 @@ int main(int argc, char **argv) {
 	 * should display the result.
 	 */
 	ph7_vm_exec(pVm, &status);
+	if(startup_stats && ph7_vm_config(pVm, PH7_VM_CONFIG_STARTUP_STATS, aPhase) != PH7_OK) {
+		startup_stats = 0;
+	}
 	if(dump_vm) {
 		/* Dump PH7 byte-code instructions */
 		ph7_vm_dump(pVm,
@@ -208,7 +261,13 @@ int main(int argc, char **argv) {
 	}
 	/* All done, cleanup the mess left behind.
 	*/
+	nTeardown = SyClockMicro();
 	ph7_vm_release(pVm);
 	ph7_release(pEngine);
+	if(startup_stats) {
+		/* Startup phases and teardown duration */
+		nEnd = SyClockMicro();
+		StartupStats(aPhase, (unsigned int)(nEnd - nTeardown), (unsigned int)(nEnd - nStart));
+	}
 	return status;
 }
@@ -0,0 +1,126 @@
+/**
+ * @PROJECT     AerScript Interpreter
+ * @COPYRIGHT   See COPYING in the top level directory
+ * @FILE        tests/api_builtin.c
+ * @DESCRIPTION Deletion and redefinition of built-in functions and constants through the C API
+ * @DEVELOPERS  Symisc Systems <devel@symisc.net>
+ *              Rafal Kupiec <belliash@codingworkshop.eu.org>
+ */
+#include <stdio.h>
+#include <string.h>
+#include "ph7.h"
+/*
+ * Redirect the VM output to STDOUT.
+ */
+static int Output_Consumer(const void *pOutput, unsigned int nOutputLen, void *pUserData) {
+	(void)pUserData;
+	fwrite(pOutput, 1, nOutputLen, stdout);
+	return PH7_OK;
+}
+/*
+ * Host-application replacement of the strlen() built-in function.
+ */
+static int HostStrlen(ph7_context *pCtx, int nArg, ph7_value **apArg) {
+	(void)nArg;
+	(void)apArg;
+	ph7_result_int(pCtx, -1);
+	return PH7_OK;
+}
+/*
+ * Host-application replacement of the PHP_EOL built-in constant.
+ */
+static void HostEol(ph7_value *pValue, void *pUserData) {
+	(void)pUserData;
+	ph7_value_string(pValue, "<EOL>", -1);
+}
+/*
+ * Compile the given script, let the callback alter the VM, then run it.
+ */
+static void RunScript(ph7 *pEngine, const char *zTitle, const char *zScript, void (*xSetup)(ph7_vm *)) {
+	ph7_vm *pVm;
+	printf("--- %s\n", zTitle);
+	fflush(stdout);
+	if(ph7_vm_init(pEngine, &pVm, 0) != PH7_OK) {
+		puts("VM initialization error");
+		return;
+	}
+	if(ph7_compile_code(pEngine, zScript, -1, &pVm) != PH7_OK) {
+		puts("Compile error");
+		return;
+	}
+	ph7_vm_config(pVm, PH7_VM_CONFIG_OUTPUT, Output_Consumer, 0);
+	ph7_vm_config(pVm, PH7_VM_CONFIG_ERR_REPORT);
+	if(xSetup) {
+		xSetup(pVm);
+	}
+	ph7_vm_exec(pVm, 0);
+	ph7_vm_release(pVm);
+	fflush(stdout);
+}
+static void DeleteStrlen(ph7_vm *pVm) {
+	printf("delete strlen: %d\n", ph7_delete_function(pVm, "strlen"));
+	printf("delete strlen again fails: %d\n", ph7_delete_function(pVm, "strlen") != PH7_OK);
+}
+static void RedefineStrlen(ph7_vm *pVm) {
+	ph7_delete_function(pVm, "strlen");
+	printf("create strlen: %d\n", ph7_create_function(pVm, "strlen", HostStrlen, 0));
+}
+static void DeleteRedefinedStrlen(ph7_vm *pVm) {
+	RedefineStrlen(pVm);
+	printf("delete strlen: %d\n", ph7_delete_function(pVm, "strlen"));
+}
+static void DeleteEol(ph7_vm *pVm) {
+	printf("delete PHP_EOL: %d\n", ph7_delete_constant(pVm, "PHP_EOL"));
+	printf("delete PHP_EOL again fails: %d\n", ph7_delete_constant(pVm, "PHP_EOL") != PH7_OK);
+}
+static void RedefineEol(ph7_vm *pVm) {
+	printf("create existing PHP_EOL fails: %d\n", ph7_create_constant(pVm, "PHP_EOL", HostEol, 0) != PH7_OK);
+	ph7_delete_constant(pVm, "PHP_EOL");
+	printf("create PHP_EOL: %d\n", ph7_create_constant(pVm, "PHP_EOL", HostEol, 0));
+}
+static const char zCheckStrlen[] =
+	"class Program {\n"
+	"	void main() {\n"
+	"		var_dump(function_exists('strlen'));\n"
+	"		if(function_exists('strlen')) {\n"
+	"			var_dump(strlen('abc'));\n"
+	"		}\n"
+	"	}\n"
+	"}\n";
+static const char zCallStrlen[] =
+	"class Program {\n"
+	"	void main() {\n"
+	"		var_dump(strlen('abc'));\n"
+	"	}\n"
+	"}\n";
+static const char zListEol[] =
+	"class Program {\n"
+	"	void main() {\n"
+	"		var_dump(in_array('PHP_OS', get_defined_constants()));\n"
+	"		var_dump(in_array('PHP_EOL', get_defined_constants()));\n"
+	"		if(in_array('PHP_EOL', get_defined_constants())) {\n"
+	"			var_dump(PHP_EOL);\n"
+	"		}\n"
+	"	}\n"
+	"}\n";
+int main(void) {
+	ph7 *pEngine;
+	if(ph7_init(&pEngine) != PH7_OK) {
+		puts("Error while allocating a new PH7 Engine instance");
+		return 1;
+	}
+	ph7_config(pEngine, PH7_CONFIG_ERR_OUTPUT, Output_Consumer, 0);
+	RunScript(pEngine, "Built-in function", zCheckStrlen, 0);
+	RunScript(pEngine, "Deleted built-in function", zCheckStrlen, DeleteStrlen);
+	RunScript(pEngine, "Redefined built-in function", zCheckStrlen, RedefineStrlen);
+	RunScript(pEngine, "Deleted redefined built-in function", zCheckStrlen, DeleteRedefinedStrlen);
+	RunScript(pEngine, "Built-in function in a new VM", zCheckStrlen, 0);
+	RunScript(pEngine, "Built-in constant", zListEol, 0);
+	RunScript(pEngine, "Deleted built-in constant", zListEol, DeleteEol);
+	RunScript(pEngine, "Redefined built-in constant", zListEol, RedefineEol);
+	RunScript(pEngine, "Built-in constant in a new VM", zListEol, 0);
+	/* Must come last, a call to an undefined function aborts the process */
+	RunScript(pEngine, "Call to a deleted built-in function", zCallStrlen, DeleteStrlen);
+	ph7_release(pEngine);
+	return 0;
+}